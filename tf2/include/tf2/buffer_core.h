@@ -33,21 +33,32 @@
 #define TF2__BUFFER_CORE_H_
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "LinearMath/Transform.h"
 #include "geometry_msgs/msg/transform_stamped.hpp"
+#include "geometry_msgs/msg/twist_stamped.hpp"
 #include "tf2/buffer_core_interface.h"
+#include "tf2/buffer_core_statistics.h"
 #include "tf2/exceptions.h"
+#include "tf2/time_cache.h"
 #include "tf2/transform_storage.h"
 #include "tf2/visibility_control.h"
 
@@ -57,6 +68,18 @@ namespace tf2
 typedef std::pair<TimePoint, CompactFrameID> P_TimeAndFrameID;
 typedef uint64_t TransformableRequestHandle;
 
+/** \brief Convert a transform found by a lookup to a message
+ * \param transform The transform from source_frame to target_frame
+ * \param time The time the transform was evaluated at
+ * \param target_frame The frame the message is expressed in
+ * \param source_frame The child frame of the message
+ * \return The stamped transform, as the throwing lookupTransform overloads return it
+ */
+TF2_PUBLIC
+geometry_msgs::msg::TransformStamped transformToMsg(
+  const tf2::Transform & transform, TimePoint time,
+  const std::string & target_frame, const std::string & source_frame);
+
 class TimeCacheInterface;
 using TimeCacheInterfacePtr = std::shared_ptr<TimeCacheInterface>;
 
@@ -69,6 +92,17 @@ enum TransformableResult
 //!< The default amount of time to cache data in seconds
 static constexpr Duration BUFFER_CORE_DEFAULT_CACHE_TIME = std::chrono::seconds(10);
 
+/** \brief Transforms in bulk, with every frame name stored once.
+ *
+ * The frame_id_ and child_frame_id_ of each stored transform are indices into frame_ids,
+ * not CompactFrameIDs of any particular BufferCore.
+ */
+struct TransformHistory
+{
+  std::vector<std::string> frame_ids;
+  std::vector<TransformStorage> transforms;
+};
+
 /** \brief A Class which provides coordinate transforms between any two frames in a system.
  *
  * This class provides a simple interface to allow recording and lookup of
@@ -98,10 +132,13 @@ public:
   /** Constructor
    * \param interpolating Whether to interpolate, if this is false the closest value will be returned
    * \param cache_time How long to keep a history of transforms in nanoseconds
-   *
+   * \param storage_precision How to store the history, Single takes about 60% of the memory
+   * and rounds transforms to float, lookups still compose them in double precision
    */
   TF2_PUBLIC
-  explicit BufferCore(tf2::Duration cache_time_ = BUFFER_CORE_DEFAULT_CACHE_TIME);
+  explicit BufferCore(
+    tf2::Duration cache_time_ = BUFFER_CORE_DEFAULT_CACHE_TIME,
+    StoragePrecision storage_precision = StoragePrecision::Double);
 
   TF2_PUBLIC
   virtual ~BufferCore(void);
@@ -110,6 +147,15 @@ public:
   TF2_PUBLIC
   void clear() override;
 
+  /** \brief Discard all transforms stamped after the given time.
+   *
+   * Meant for jumps back in time: history up to the jump target and static transforms are kept,
+   * so lookups into the past keep working while new data arrives.
+   * \param time The latest time to keep data for
+   */
+  TF2_PUBLIC
+  void rollbackTo(TimePoint time);
+
   /** \brief Add transform information to the tf data structure
    * \param transform The transform to store
    * \param authority The source of the information for this transform
@@ -121,6 +167,150 @@ public:
     const geometry_msgs::msg::TransformStamped & transform,
     const std::string & authority, bool is_static = false);
 
+  /** \brief Add transform information for one of several trees kept in this buffer.
+   *
+   * Lets a single buffer track many robots that publish the same frame names, each in their own
+   * namespace. Both frames are stored as namespacedFrameId(tf_namespace, frame), so a lookup
+   * from "robot1/base_link" to "robot2/base_link" goes through the shared frames they have in
+   * common. Static transforms that are identical in several namespaces, such as the sensor
+   * mounts of identical robots, are stored once and shared.
+   * \param transform The transform to store, with frame names relative to the namespace
+   * \param authority The source of the information for this transform
+   * \param is_static Record this transform as a static transform
+   * \param tf_namespace The namespace of the tree, an empty namespace is the plain setTransform
+   * \return True unless an error occured
+   */
+  TF2_PUBLIC
+  bool setTransform(
+    const geometry_msgs::msg::TransformStamped & transform,
+    const std::string & authority, bool is_static, const std::string & tf_namespace);
+
+  /** \brief Keep a frame out of every namespace, for frames that several trees share.
+   * Only affects transforms set after the call.
+   * \param frame_id The frame, for example "world" or "map"
+   */
+  TF2_PUBLIC
+  void addSharedFrame(const std::string & frame_id);
+
+  /** \brief Get the name a frame is stored under by the namespaced setTransform.
+   * \param tf_namespace The namespace, leading and trailing slashes are ignored
+   * \param frame_id The frame, relative to the namespace
+   * \return "tf_namespace/frame_id", or frame_id if it is shared or the namespace is empty
+   */
+  TF2_PUBLIC
+  std::string namespacedFrameId(
+    const std::string & tf_namespace, const std::string & frame_id) const;
+
+  /** \brief Add many non-static transforms at once, for example history received from a peer.
+   *
+   * The frame mutex is taken once, and every frame name is resolved once. Transforms for frames
+   * that are static in this buffer, or with invalid frame indices, are skipped. Others are
+   * checked and logged like those of setTransform().
+   * \param history The transforms to store
+   * \param authority The source of the information for these transforms
+   * \return The number of transforms stored
+   */
+  TF2_PUBLIC
+  size_t setTransformHistory(const TransformHistory & history, const std::string & authority);
+
+  /** \brief Get all non-static transforms stamped at or after a time.
+   * Transforms of each frame are ordered oldest first, which is the cheapest order to insert.
+   * \param since The oldest time to include
+   */
+  TF2_PUBLIC
+  TransformHistory getTransformHistory(TimePoint since) const;
+
+  /** \brief Resolve frame names to the CompactFrameIDs of this buffer, adding unknown frames.
+   *
+   * Together with setCompactTransforms this lets a reader of interned frame IDs resolve every
+   * name once, instead of once per transform. Names that are empty after stripping a leading
+   * slash resolve to 0, which setCompactTransforms skips.
+   * \param frame_ids The names to resolve
+   * \param[out] frame_numbers The CompactFrameID of each name
+   */
+  TF2_PUBLIC
+  void resolveFrameNumbers(
+    const std::vector<std::string> & frame_ids, std::vector<CompactFrameID> & frame_numbers);
+
+  /** \brief Add many non-static transforms between frames already resolved to CompactFrameIDs.
+   *
+   * The frame_id_ and child_frame_id_ of each transform are CompactFrameIDs of this buffer, as
+   * returned by resolveFrameNumbers. Transforms with unknown frames, or for frames that are static
+   * in this buffer, are skipped. Others are checked and logged like those of setTransform().
+   * \param transforms The transforms to store
+   * \param authority The source of the information for these transforms
+   * \return The number of transforms stored
+   */
+  TF2_PUBLIC
+  size_t setCompactTransforms(
+    const std::vector<TransformStorage> & transforms, const std::string & authority);
+
+  /** \brief Reserve storage up front, for use from real-time code.
+   *
+   * Cache entries are allocated from a pool, which this fills with enough entries for
+   * max_frames frames of max_entries_per_frame entries each. Once every frame exists, and each
+   * real-time thread has made one lookup, inserts and the non-throwing lookupTransform no
+   * longer allocate while the tree stays within these bounds.
+   *
+   * The exception is lookups made while the latest parents of the frames form a loop. These need
+   * per thread scratch space. This reserves it for the calling thread only, so every real-time
+   * thread that may look up transforms through such a loop should call reserve() itself.
+   * \param max_frames The number of frames to reserve space for
+   * \param max_entries_per_frame The number of cache entries to reserve for each frame
+   *
+   * Each shard (see addShard()) has its own pool, filled for max_frames frames.
+   */
+  TF2_PUBLIC
+  void reserve(size_t max_frames, size_t max_entries_per_frame);
+
+  /** \brief Lock a subtree separately from the rest of the tree.
+   *
+   * The frames of a shard are locked independently of the frames of other shards, so inserts
+   * into one shard never wait for lookups that only walk other shards, and the other way around.
+   * For example, with a shard for the arm, a 1 kHz joint state publisher does not hold up
+   * lookups between the cameras and the base. Lookups across shards lock all of the shards they
+   * walk. Shards are always locked in the same order, so they cannot deadlock.
+   *
+   * A frame is in the shard of its parent when it gets its first transform, unless it is the
+   * root of a shard. Frames that already have transforms stay where they are. Every buffer
+   * starts with one shard, which holds everything outside of the shards added here.
+   * \param subtree_root The frame at the top of the subtree
+   * \throws InvalidArgumentException if subtree_root is empty, or there are already 64 shards
+   */
+  TF2_PUBLIC
+  void addShard(const std::string & subtree_root);
+
+  /** \brief Let lookups extrapolate a frame up to horizon past its latest transform.
+   *
+   * Instead of failing, or waiting, for a transform that has not arrived yet, the link from
+   * frame_id to its parent is predicted from the velocity between its two latest transforms.
+   * Applies to the frame whether or not it has been received yet, zero disables prediction.
+   * \param frame_id The child frame of the link to predict
+   * \param horizon How far past the latest transform lookups may be predicted
+   */
+  TF2_PUBLIC
+  void setPredictionHorizon(const std::string & frame_id, tf2::Duration horizon);
+
+  /** \brief Choose how rotations are interpolated between transforms, for every frame.
+   * \param policy Slerp, the default, or the cheaper Nlerp, see InterpolationPolicy for its error
+   * \param nlerp_max_angle With Nlerp, the largest rotation in radians between two transforms
+   * to use it for, Slerp is used above it
+   */
+  TF2_PUBLIC
+  void setInterpolationPolicy(
+    InterpolationPolicy policy, double nlerp_max_angle = DEFAULT_NLERP_MAX_ANGLE);
+
+  /** \brief Stage transforms that arrive behind the latest one of their frame, for every frame.
+   *
+   * With several publishers or multi-hop transports, transforms often arrive out of order.
+   * Each cache then keeps up to window late transforms aside, where lookups find them in
+   * logarithmic time, and merges them into its history together rather than one at a time.
+   * See the late_inserts statistics for how often and how late they arrive.
+   * \param window How many late transforms a frame stages before merging, zero disables staging
+   */
+  TF2_PUBLIC
+  void setReorderWindow(size_t window);
+
   /*********** Accessors *************/
 
   /** \brief Get the transform between two frames by frame ID.
@@ -138,6 +328,22 @@ public:
     const std::string & target_frame, const std::string & source_frame,
     const TimePoint & time) const override;
 
+  /** \brief Get the transform between two frames by frame ID, telling whether it was predicted.
+   * \param target_frame The frame to which data should be transformed
+   * \param source_frame The frame where the data originated
+   * \param time The time at which the value of the transform is desired. (0 will get the latest)
+   * \param[out] predicted Whether any link was extrapolated, see setPredictionHorizon()
+   * \return The transform between the frames
+   *
+   * Possible exceptions tf2::LookupException, tf2::ConnectivityException,
+   * tf2::ExtrapolationException, tf2::InvalidArgumentException
+   */
+  TF2_PUBLIC
+  geometry_msgs::msg::TransformStamped
+  lookupTransform(
+    const std::string & target_frame, const std::string & source_frame,
+    const TimePoint & time, bool & predicted) const;
+
   /** \brief Get the transform between two frames by frame ID assuming fixed frame.
    * \param target_frame The frame to which data should be transformed
    * \param target_time The time to which the data should be transformed. (0 will get the latest)
@@ -157,6 +363,47 @@ public:
     const std::string & source_frame, const TimePoint & source_time,
     const std::string & fixed_frame) const override;
 
+  /** \brief Get the velocity of one frame relative to another, averaged over an interval.
+   *
+   * The velocity is differenced from the transform at both ends of the interval, which is
+   * centered on time and shifted back if it would extend past the latest common time of the
+   * frames. Both ends are gathered in a single walk of the tree.
+   * \param tracking_frame The frame whose motion is tracked
+   * \param observation_frame The frame the motion is observed from
+   * \param time The time at which to get the velocity (0 will get the latest)
+   * \param averaging_interval The length of the interval to average over, must be positive
+   * \return The linear velocity of the origin of tracking_frame and its angular velocity, both
+   * expressed in observation_frame, stamped at the center of the interval
+   *
+   * Possible exceptions tf2::LookupException, tf2::ConnectivityException,
+   * tf2::ExtrapolationException, tf2::InvalidArgumentException
+   */
+  TF2_PUBLIC
+  geometry_msgs::msg::TwistStamped
+  lookupVelocity(
+    const std::string & tracking_frame, const std::string & observation_frame,
+    const TimePoint & time, const tf2::Duration & averaging_interval) const;
+
+  /** \brief Get the transform between two frames by frame ID, without throwing.
+   *
+   * Meant for real-time loops: no error messages are built, and nothing is allocated once
+   * storage has been reserved (see reserve()). With blocking set to false the lookup fails with
+   * TF2_TIMEOUT_ERROR instead of waiting for another thread to release the buffer.
+   * \param target_frame The frame to which data should be transformed
+   * \param source_frame The frame where the data originated
+   * \param time The time at which the value of the transform is desired. (0 will get the latest)
+   * \param[out] transform The transform between the frames
+   * \param[out] time_out The time the transform was evaluated at
+   * \param blocking Whether to wait for the locks it needs, or give up if an insert holds them
+   * \return TF2_NO_ERROR on success, otherwise the reason of the failure
+   */
+  TF2_PUBLIC
+  TF2Error
+  lookupTransform(
+    const std::string & target_frame, const std::string & source_frame,
+    const TimePoint & time, tf2::Transform & transform, TimePoint & time_out,
+    bool blocking = true) const noexcept;
+
   /** \brief Test if a transform is possible
    * \param target_frame The frame into which to transform
    * \param source_frame The frame from which to transform
@@ -184,6 +431,22 @@ public:
     const std::string & source_frame, const TimePoint & source_time,
     const std::string & fixed_frame, std::string * error_msg = nullptr) const override;
 
+  /** \brief Test if a frame can be transformed into each of several frames, at each of several
+   * times. All of the transforms are tested against the same state of the buffer, under one lock.
+   * \param target_frames The frames into which to transform
+   * \param source_frame The frame from which to transform
+   * \param times The times at which every transform is needed, an array of time_count times
+   * \param time_count The number of times
+   * \param error_msg A pointer to a string which will be filled with why the first failing
+   * transform failed, if not nullptr
+   * \return True if all of the transforms are possible, false otherwise
+   */
+  TF2_PUBLIC
+  bool canTransformAll(
+    const std::vector<std::string> & target_frames, const std::string & source_frame,
+    const TimePoint * times, size_t time_count,
+    std::string * error_msg = nullptr) const override;
+
   /** \brief Get all frames that exist in the system.
    */
   TF2_PUBLIC
@@ -211,6 +474,13 @@ public:
     const std::string & source_frame,
     TimePoint time, TransformableResult result)>;
 
+  /** Receives the transform of a request, as found by the walk that proved it available.
+   * On TransformFailure only the frames and the requested time of the transform are set.
+   */
+  using TransformableTransformCallback = std::function<
+    void (TransformableRequestHandle request_handle,
+    const geometry_msgs::msg::TransformStamped & transform, TransformableResult result)>;
+
   /// \brief Internal use only
   TF2_PUBLIC
   TransformableRequestHandle addTransformableRequest(
@@ -218,10 +488,38 @@ public:
     const std::string & target_frame,
     const std::string & source_frame,
     TimePoint time);
-  /// \brief Internal use only
+  /** \brief Internal use only
+   * Like the other overload, but hands the transform to the callback so that it does not have to
+   * be looked up again. If 0 is returned, the request was satisfied immediately and the transform
+   * is stored in immediate_transform instead.
+   */
+  TF2_PUBLIC
+  TransformableRequestHandle addTransformableRequest(
+    const TransformableTransformCallback & cb,
+    const std::string & target_frame,
+    const std::string & source_frame,
+    TimePoint time,
+    geometry_msgs::msg::TransformStamped & immediate_transform);
+  /** \brief Internal use only
+   * Once this returns, the callback of the request does not run anymore, and is not running on
+   * another thread either.
+   */
   TF2_PUBLIC
   void cancelTransformableRequest(TransformableRequestHandle handle);
 
+  /// Runs a task, now or later and on any thread
+  using TransformableCallbackExecutor = std::function<void (std::function<void()> task)>;
+
+  /** \brief Set where the callbacks of satisfied transformable requests run
+   * Callbacks are always run after the buffer released its locks. Without an executor they run
+   * on the thread whose insert satisfied them, before that insert returns; an executor that hands
+   * them to another thread keeps slow callbacks from delaying inserts. Tasks that run after their
+   * request was cancelled, or after the buffer was destroyed, do nothing.
+   * \param executor The executor, or an empty function to run callbacks on the inserting thread
+   */
+  TF2_PUBLIC
+  void setTransformableCallbackExecutor(TransformableCallbackExecutor executor);
+
 
   // Tell the buffer that there are multiple threads servicing it.
   // This is useful for derived classes to know if they can block or not.
@@ -231,6 +529,33 @@ public:
   TF2_PUBLIC
   bool isUsingDedicatedThread() const {return using_dedicated_thread_;}
 
+  /** \brief Enable or disable collection of lookup, insert and lock statistics.
+   * Statistics are disabled by default. While disabled they cost one relaxed atomic load per call.
+   */
+  TF2_PUBLIC
+  void setStatisticsEnabled(bool enabled)
+  {
+    statistics_enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  TF2_PUBLIC
+  bool isStatisticsEnabled() const {return statistics_enabled_.load(std::memory_order_relaxed);}
+
+  /** \brief Get a copy of the statistics collected since construction or the last reset. */
+  TF2_PUBLIC
+  BufferCoreStatistics getStatistics() const;
+
+  /** \brief Reset all collected statistics to zero. */
+  TF2_PUBLIC
+  void resetStatistics();
+
+  /** \brief Get the statistics collected since construction or the last reset, and reset them.
+   * Unlike getStatistics() followed by resetStatistics(), nothing recorded in between is lost,
+   * so consecutive calls cover consecutive windows.
+   */
+  TF2_PUBLIC
+  BufferCoreStatistics takeStatistics();
+
 
   /* Backwards compatability section for tf::Transformer you should not use these
    */
@@ -268,7 +593,7 @@ public:
     CompactFrameID target_frame, CompactFrameID source_frame,
     TimePoint & time, std::string * error_string) const
   {
-    std::unique_lock<std::mutex> lock(frame_mutex_);
+    std::unique_lock<std::shared_mutex> lock(frame_mutex_);
     return getLatestCommonTime(target_frame, source_frame, time, error_string);
   }
 
@@ -308,27 +633,112 @@ private:
   /** \brief The pointers to potential frames that the tree can be made of.
    * The frames will be dynamically allocated at run time when set the first time. */
   typedef std::vector<TimeCacheInterfacePtr> V_TimeCacheInterface;
+
+  /** \brief A set of frames whose caches are locked together, see addShard(). */
+  struct Shard
+  {
+    /// Protects the caches of the frames of the shard, while frame_mutex_ is held shared.
+    /// Lookups hold it shared and inserts exclusively.
+    std::shared_mutex mutex;
+    /// The pool cache entries are allocated from, which recycles the entries of pruned data.
+    /// Only used under mutex, or with frame_mutex_ held exclusively.
+    std::pmr::unsynchronized_pool_resource resource;
+  };
+  static constexpr size_t MAX_SHARDS = 64;
+
+  /** \brief Locks frame_mutex_ shared and shards in ascending order, defined in the source. */
+  class ShardLock;
+
+  /** \brief The shards, declared before frames_ so that they outlive the caches allocating from
+   * them. Shard 0 holds every frame outside of the subtrees given to addShard(). */
+  std::vector<std::unique_ptr<Shard>> shards_;
+  /** \brief Whether addShard() was called. Until then inserts hold frame_mutex_ exclusively and
+   * lookups hold it shared, without locking shard 0. */
+  std::atomic<bool> sharded_{false};
+
   V_TimeCacheInterface frames_;
 
-  /** \brief A mutex to protect testing and allocating new frames on the above vector. */
-  mutable std::mutex frame_mutex_;
+  /** \brief Protects the frames and everything else about them.
+   * Held exclusively to add frames or change all of them. Inserts and lookups hold it shared,
+   * together with the shards of the frames they touch. */
+  mutable std::shared_mutex frame_mutex_;
 
-  /** \brief A map from string frame ids to CompactFrameID */
-  typedef std::unordered_map<std::string, CompactFrameID> M_StringToCompactFrameID;
-  M_StringToCompactFrameID frameIDs_;
-  /** \brief A map from CompactFrameID frame_id_numbers to string for debugging and output */
-  std::vector<std::string> frameIDs_reverse_;
-  /** \brief A map to lookup the most recent authority for a given frame */
-  std::map<CompactFrameID, std::string> frame_authority_;
+  /** \brief The shard of each frame */
+  std::vector<uint8_t> frame_shard_;
 
+  /** \brief Where the latest transform of a frame puts it in the tree */
+  struct FrameLinks
+  {
+    /// The parent of the latest transform, or 0
+    CompactFrameID parent = 0;
+    /// The frame at the top of the chain of latest parents
+    CompactFrameID root = 0;
+    /// The number of links between the frame and root
+    uint32_t depth = 0;
+    /// Whether the frame had a transform with another parent since the last clear()
+    bool reparented = false;
+    /// Whether the frame or one of its latest ancestors was reparented
+    bool chain_reparented = false;
+    /// The frames whose latest parent is this one
+    std::vector<CompactFrameID> children;
+  };
+  /** \brief The links of each frame, maintained as the latest parents change.
+   * Only changed with frame_mutex_ held exclusively, so inserts that hold it shared never change
+   * the parent of their frame. */
+  std::vector<FrameLinks> frame_links_;
+  /** \brief Whether the latest parents form a loop, which leaves root and depth unset */
+  bool latest_parents_loop_ = false;
+  /** \brief Scratch space to walk subtrees of frame_links_ */
+  std::vector<CompactFrameID> subtree_scratch_;
+  /** \brief The shard of each frame given to addShard() */
+  std::unordered_map<std::string, uint8_t> shard_roots_;
+
+  /** \brief A map from string frame ids to CompactFrameID
+   * The keys view the names in frameIDs_reverse_, so lookups never copy the name. */
+  typedef std::unordered_map<std::string_view, CompactFrameID> M_StringToCompactFrameID;
+  M_StringToCompactFrameID frameIDs_;
+  /** \brief A map from CompactFrameID frame_id_numbers to string for debugging and output
+   * A deque, so that names do not move as frames are added. */
+  std::deque<std::string> frameIDs_reverse_;
+  /** \brief The most recent authority of each frame, as an index into authorities_ */
+  std::vector<uint32_t> frame_authority_;
+  /** \brief The prediction horizon of each frame, see setPredictionHorizon() */
+  std::vector<tf2::Duration> frame_prediction_horizon_;
+  /** \brief Every authority seen, interned so that inserts do not copy them */
+  std::deque<std::string> authorities_;
+  std::unordered_map<std::string_view, uint32_t> authority_ids_;
+  /** \brief Frames that are not namespaced, see addSharedFrame() */
+  std::unordered_set<std::string> shared_frames_;
+  /** \brief Static transforms stored by the namespaced setTransform, to share between identical
+   * links. Keyed by the link as it is named in its namespace and by its value. */
+  std::unordered_map<std::string, std::weak_ptr<const TransformStorage>> shared_static_transforms_;
+  /** \brief The size at which the expired entries of shared_static_transforms_ are erased */
+  size_t shared_static_sweep_size_ = 32;
 
   /// How long to cache transform history
   tf2::Duration cache_time_;
 
+  /// How the caches store transforms
+  StoragePrecision storage_precision_;
+
+  /// How the caches interpolate rotations, see setInterpolationPolicy()
+  InterpolationPolicy interpolation_policy_ = InterpolationPolicy::Slerp;
+  double nlerp_max_angle_ = DEFAULT_NLERP_MAX_ANGLE;
+
+  /// How many late transforms the caches stage, see setReorderWindow()
+  size_t reorder_window_ = 0;
+
   typedef uint32_t TransformableCallbackHandle;
 
+  /// One of the callbacks is set, depending on the overload the request was added with
+  struct TransformableCallbacks
+  {
+    TransformableCallback cb;
+    TransformableTransformCallback transform_cb;
+  };
+
   typedef std::unordered_map<TransformableCallbackHandle,
-      TransformableCallback> M_TransformableCallback;
+      TransformableCallbacks> M_TransformableCallback;
   M_TransformableCallback transformable_callbacks_;
   uint32_t transformable_callbacks_counter_;
   std::mutex transformable_callbacks_mutex_;
@@ -342,14 +752,45 @@ private:
     CompactFrameID source_id;
     std::string target_string;
     std::string source_string;
+    bool wants_transform = false;
   };
   typedef std::vector<TransformableRequest> V_TransformableRequest;
   V_TransformableRequest transformable_requests_;
   std::mutex transformable_requests_mutex_;
   uint64_t transformable_requests_counter_;
 
+  /** Tracks the callbacks of satisfied requests from their collection until they returned.
+   * Tasks handed to an executor share it, so that they do nothing once the buffer is gone.
+   */
+  struct TransformableDispatch
+  {
+    /// Runs the callback of a request, unless it was cancelled since it was collected
+    void run(TransformableRequestHandle handle, const std::function<void()> & callback);
+    /// Drops the callback of a request, and waits for it if it runs on another thread
+    void cancel(TransformableRequestHandle handle);
+    /// Drops all callbacks that did not start yet, and waits for the running ones
+    void close();
+
+    std::mutex mutex;
+    std::condition_variable done;
+    std::unordered_set<TransformableRequestHandle> pending;
+    std::unordered_map<TransformableRequestHandle, std::thread::id> running;
+  };
+  std::shared_ptr<TransformableDispatch> transformable_dispatch_;
+  /// Guarded by transformable_callbacks_mutex_
+  TransformableCallbackExecutor transformable_callback_executor_;
+
   bool using_dedicated_thread_;
 
+  std::atomic<bool> statistics_enabled_;
+  mutable BufferCoreStatisticsCollector statistics_;
+
+  /// The statistics to record into, or nullptr if statistics are disabled
+  BufferCoreStatisticsCollector * activeStatistics() const
+  {
+    return statistics_enabled_.load(std::memory_order_relaxed) ? &statistics_ : nullptr;
+  }
+
   /************************* Internal Functions ****************************/
 
   /** \brief A way to see what frames have been cached
@@ -357,10 +798,15 @@ private:
    */
   std::string allFramesAsStringNoLock() const;
 
+  /** \brief Store a transform.
+   * \param static_share_key If not empty, a static transform is shared with every other one
+   * stored with the same key, see shared_static_transforms_
+   */
   bool setTransformImpl(
-    const tf2::Transform & transform_in, const std::string frame_id,
-    const std::string child_frame_id, const TimePoint stamp,
-    const std::string & authority, bool is_static);
+    const tf2::Transform & transform_in, const std::string & frame_id,
+    const std::string & child_frame_id, const TimePoint stamp,
+    const std::string & authority, bool is_static,
+    const std::string & static_share_key = std::string());
   void lookupTransformImpl(
     const std::string & target_frame, const std::string & source_frame,
     const TimePoint & time_in, tf2::Transform & transform, TimePoint & time_out) const;
@@ -375,7 +821,115 @@ private:
    */
   TimeCacheInterfacePtr getFrame(CompactFrameID c_frame_id) const;
 
-  TimeCacheInterfacePtr allocateFrame(CompactFrameID cfid, bool is_static);
+  /** \brief getFrame() for walks that hold a ShardLock.
+   * Returns null and flags a miss if the shard of the frame is not held.
+   */
+  TimeCacheInterfacePtr getFrame(CompactFrameID c_frame_id, ShardLock * shards) const;
+
+  /** \brief Replace the cache of a frame with a new one.
+   * A frame that had no cache yet joins its shard, or the shard of parent.
+   * \param shared_static Whether a static frame can share its transform, see SharedStaticCache
+   */
+  TimeCacheInterfacePtr allocateFrame(
+    CompactFrameID cfid, bool is_static, CompactFrameID parent, bool shared_static = false);
+
+  /** \brief Update frame_links_ after inserting a transform with parent into the cache of cfid.
+   * Changes of the latest parent that close a loop are reported here, once.
+   */
+  void updateFrameLinks(
+    CompactFrameID cfid, const TimeCacheInterfacePtr & cache, CompactFrameID parent);
+
+  /** \brief Recompute frame_links_ from the caches, after changes to many of them. */
+  void rebuildFrameLinks();
+
+  /** \brief Recompute the links of cfid and the frames below it from their parents. */
+  void updateSubtreeLinks(CompactFrameID cfid);
+
+  /** \brief Recompute root, depth and chain_reparented of cfid from its parent. */
+  void inheritLinks(CompactFrameID cfid);
+
+  /** \brief The frame where the chains of latest parents of two frames meet.
+   * \return 0 if they do not meet, or one of the frames below the meeting point had another
+   * parent in the past, so that walks at other times might not meet there
+   */
+  CompactFrameID chainsMeet(CompactFrameID target_id, CompactFrameID source_id) const;
+
+  /** \brief Whether no transform connects two frames, at any time.
+   * Holds when their chains of latest parents end at different roots and no frame on either
+   * chain ever had another parent, so that lookups between them can fail without a walk.
+   */
+  bool neverConnected(CompactFrameID target_id, CompactFrameID source_id) const
+  {
+    const FrameLinks & target = frame_links_[target_id];
+    const FrameLinks & source = frame_links_[source_id];
+    return !latest_parents_loop_ && target.root != source.root &&
+           !target.chain_reparented && !source.chain_reparented;
+  }
+
+  /** \brief The bit of the shard of a frame */
+  uint64_t shardBit(CompactFrameID cfid) const
+  {
+    return uint64_t(1) << frame_shard_[cfid];
+  }
+
+  /** \brief The bits of every shard */
+  uint64_t allShards() const
+  {
+    return shards_.size() == MAX_SHARDS ? ~uint64_t(0) : (uint64_t(1) << shards_.size()) - 1;
+  }
+
+  /** \brief The shards of the caches on the way from a frame to its root, by parent hints.
+   * Expects the caller to hold frame_mutex_.
+   */
+  uint64_t pathShards(CompactFrameID cfid) const;
+
+  /** \brief Call walk with the shards of the chains of both frames held, and of fixed_id if set.
+   * If walk needs other shards, for example because a parent changed over time, it is called
+   * again with all of the shards held, so it must reset anything it accumulates.
+   * \return The result of walk, or TF2_TIMEOUT_ERROR if shards is not blocking and they are held
+   */
+  template<typename Walk>
+  tf2::TF2Error withChainShards(
+    ShardLock & shards, CompactFrameID target_id, CompactFrameID source_id, Walk && walk,
+    CompactFrameID fixed_id = 0) const;
+
+  /** \brief withChainShards() for walks over any number of chains, whose shards are in needed
+   */
+  template<typename Walk>
+  tf2::TF2Error withShards(ShardLock & shards, uint64_t needed, Walk && walk) const;
+
+  template<typename CacheT>
+  TimeCacheInterfacePtr makeTimeCache(CompactFrameID cfid) const;
+
+  /** \brief Check a transform, store it with insert, and report the outcome.
+   * Rejects and logs what setTransform() does not store: equal or empty frames, NaN values and
+   * unnormalized rotations. insert stores the transform, sets its argument to the latest stamp of
+   * the frame before it, and returns whether it stored it. Either way the statistics and the
+   * set_transform tracepoint are recorded, and old data is logged as TF_OLD_DATA.
+   * \param frame_id The parent frame, null terminated
+   * \param child_frame_id The child frame, null terminated
+   * \return Whether the transform was stored
+   */
+  template<typename Insert>
+  bool checkAndInsert(
+    const tf2::Quaternion & rotation, const tf2::Vector3 & origin,
+    std::string_view frame_id, std::string_view child_frame_id, TimePoint stamp,
+    const std::string & authority, bool is_static, Insert && insert);
+
+  /** \brief Store a non-static transform whose frames are CompactFrameIDs, if they are valid.
+   * Checked like setTransform() does, see checkAndInsert(). Expects the caller to hold
+   * frame_mutex_ exclusively.
+   */
+  bool insertCompactData(const TransformStorage & storage, uint32_t authority_id);
+
+  /** \brief Get the index of an authority in authorities_, adding it if it is new.
+   * Expects the caller to hold frame_mutex_.
+   */
+  uint32_t internAuthority(std::string_view authority);
+
+  /** \brief namespacedFrameId(), expects the caller to hold frame_mutex_ */
+  std::string namespacedFrameIdNoLock(
+    std::string_view tf_namespace, std::string_view frame_id) const;
 
   /** \brief Validate a frame ID format and look up its CompactFrameID.
     *   For invalid cases, produce an message.
@@ -405,10 +959,10 @@ private:
     const std::string & frame_id) const;
 
   /// String to number for frame lookup. Returns 0 if the frame was not found.
-  CompactFrameID lookupFrameNumber(const std::string & frameid_str) const;
+  CompactFrameID lookupFrameNumber(std::string_view frameid_str) const;
 
   /// String to number for frame lookup with dynamic allocation of new frames
-  CompactFrameID lookupOrInsertFrameNumber(const std::string & frameid_str);
+  CompactFrameID lookupOrInsertFrameNumber(std::string_view frameid_str);
 
   /// Number to string frame lookup may throw LookupException if number invalid
   const std::string & lookupFrameString(CompactFrameID frame_id_num) const;
@@ -421,15 +975,16 @@ private:
    * zero if fails to cross */
   tf2::TF2Error getLatestCommonTime(
     CompactFrameID target_frame, CompactFrameID source_frame,
-    TimePoint & time, std::string * error_string) const;
+    TimePoint & time, std::string * error_string, ShardLock * shards = nullptr) const;
 
   /**@brief Traverse the transform tree. If frame_chain is not nullptr, store the traversed frame tree in vector frame_chain.
+   * Without shards the caller must hold frame_mutex_ exclusively.
    * */
   template<typename F>
   tf2::TF2Error walkToTopParent(
     F & f, TimePoint time, CompactFrameID target_id,
     CompactFrameID source_id, std::string * error_string,
-    std::vector<CompactFrameID> * frame_chain) const;
+    std::vector<CompactFrameID> * frame_chain, ShardLock * shards = nullptr) const;
 
   void testTransformableRequests();
 
@@ -437,6 +992,22 @@ private:
   bool canTransformInternal(
     CompactFrameID target_id, CompactFrameID source_id,
     const TimePoint & time, std::string * error_msg) const;
+
+  // canTransformInternal() that also returns the transform it found
+  bool lookupTransformInternal(
+    CompactFrameID target_id, CompactFrameID source_id, const TimePoint & time,
+    tf2::Transform & transform, TimePoint & time_out) const;
+
+  // The walk shared by canTransformInternal() and lookupTransformInternal()
+  template<typename F>
+  tf2::TF2Error walkChain(
+    F & accum, CompactFrameID target_id, CompactFrameID source_id,
+    const TimePoint & time, std::string * error_msg) const;
+
+  // Registers a request that was not satisfied immediately, with transformable_requests_mutex_ held
+  TransformableRequestHandle queueTransformableRequest(
+    TransformableRequest & req, TransformableCallbacks callbacks,
+    const std::string & target_frame, const std::string & source_frame, TimePoint time);
 };
 }  // namespace tf2
 
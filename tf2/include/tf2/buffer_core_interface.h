@@ -130,6 +130,37 @@ public:
     const std::string & fixed_frame,
     std::string * error_msg) const = 0;
 
+  /**
+   * \brief Test if a frame can be transformed into each of several frames, at each of several
+   * times. Implementations may test all of them against the same state of the buffer.
+   * \param target_frames The frames into which to transform.
+   * \param source_frame The frame from which to transform.
+   * \param times The times at which every transform is needed, an array of time_count times,
+   *   so that callers may keep them on the stack.
+   * \param time_count The number of times.
+   * \param error_msg A pointer to a string which will be filled with why the first failing
+   *   transform failed. Ignored if nullptr.
+   * \return true if all of the transforms are possible, false otherwise.
+   */
+  TF2_PUBLIC
+  virtual bool
+  canTransformAll(
+    const std::vector<std::string> & target_frames,
+    const std::string & source_frame,
+    const tf2::TimePoint * times,
+    size_t time_count,
+    std::string * error_msg) const
+  {
+    for (const std::string & target_frame : target_frames) {
+      for (size_t i = 0; i < time_count; ++i) {
+        if (!canTransform(target_frame, source_frame, times[i], error_msg)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
   /**
    * \brief Get all frames that exist in the system.
    * \return all frame names in a vector.
@@ -0,0 +1,171 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TF2__BUFFER_CORE_STATISTICS_H_
+#define TF2__BUFFER_CORE_STATISTICS_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tf2/visibility_control.h"
+
+namespace tf2
+{
+
+/** \brief A point-in-time copy of a Histogram. */
+struct HistogramSnapshot
+{
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  uint64_t max = 0;
+  std::vector<uint64_t> buckets;
+
+  /** \brief The mean of all recorded values, 0 if there are none. */
+  TF2_PUBLIC
+  double mean() const;
+
+  /** \brief An upper bound on the given percentile, with p in [0, 1].
+   * The bound is within 12.5% of the true value, and never above max.
+   */
+  TF2_PUBLIC
+  uint64_t percentile(double p) const;
+};
+
+/** \brief A lock-free log-linear histogram of unsigned values, in the style of HdrHistogram.
+ *
+ * Values below 8 have their own bucket. Every power of two above that is split into 8 linear
+ * sub-buckets, giving a constant relative precision of 12.5%. Values above 2^40 are clamped
+ * into the last bucket. Recording is a handful of relaxed atomic operations and never allocates.
+ */
+class Histogram
+{
+public:
+  static constexpr unsigned int SUB_BUCKET_BITS = 3;
+  static constexpr unsigned int SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+  static constexpr unsigned int MAX_EXPONENT = 40;
+  static constexpr size_t BUCKET_COUNT = SUB_BUCKETS * (MAX_EXPONENT - SUB_BUCKET_BITS + 2);
+
+  TF2_PUBLIC
+  Histogram();
+
+  TF2_PUBLIC
+  void record(uint64_t value);
+
+  TF2_PUBLIC
+  HistogramSnapshot snapshot() const;
+
+  TF2_PUBLIC
+  void reset();
+
+  /** \brief Take a snapshot and reset to zero in one step.
+   * Every value recorded concurrently ends up in exactly one snapshot, which a snapshot()
+   * followed by a reset() does not guarantee.
+   */
+  TF2_PUBLIC
+  HistogramSnapshot take();
+
+  /** \brief The index of the bucket a value is recorded in. */
+  TF2_PUBLIC
+  static size_t bucketIndex(uint64_t value);
+
+  /** \brief The largest value recorded in a given bucket. */
+  TF2_PUBLIC
+  static uint64_t bucketUpperBound(size_t index);
+
+private:
+  std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+};
+
+/** \brief Statistics collected by a BufferCore while statistics are enabled.
+ *
+ * Durations are in nanoseconds. The query histograms cover lookupTransform and canTransform,
+ * the insert histograms cover setTransform.
+ */
+struct BufferCoreStatistics
+{
+  /// Number of lookupTransform and canTransform calls that walked the tree.
+  uint64_t queries = 0;
+  /// Number of transforms stored by setTransform.
+  uint64_t inserts = 0;
+  /// Number of transforms rejected because they were older than the cache.
+  uint64_t old_data_rejections = 0;
+  /// Number of transforms stored behind the latest transform of their frame.
+  uint64_t late_inserts = 0;
+  /// Number of queries failed because a frame does not exist or the tree has a loop.
+  uint64_t lookup_failures = 0;
+  /// Number of queries failed because the frames are not connected.
+  uint64_t connectivity_failures = 0;
+  /// Number of queries failed because they would require extrapolation.
+  uint64_t extrapolation_failures = 0;
+
+  /// Time spent waiting for the frame mutex before a query.
+  HistogramSnapshot query_lock_wait_ns;
+  /// Time the frame mutex was held by a query.
+  HistogramSnapshot query_lock_hold_ns;
+  /// Time spent waiting for the frame mutex before an insert.
+  HistogramSnapshot insert_lock_wait_ns;
+  /// Time the frame mutex was held by an insert.
+  HistogramSnapshot insert_lock_hold_ns;
+  /// Number of frames visited per query.
+  HistogramSnapshot chain_depth;
+  /// Number of cache entries stepped over per query to find the bracketing samples.
+  HistogramSnapshot cache_search_steps;
+  /// Time spent testing pending transformable requests after an insert.
+  HistogramSnapshot transformable_requests_ns;
+  /// Number of pending transformable requests when they are tested.
+  HistogramSnapshot transformable_request_queue_length;
+  /// How far behind the latest transform of their frame late transforms were stamped.
+  HistogramSnapshot insert_lateness_ns;
+};
+
+/** \brief The mutable counterpart of BufferCoreStatistics that BufferCore records into. */
+struct BufferCoreStatisticsCollector
+{
+  std::atomic<uint64_t> queries{0};
+  std::atomic<uint64_t> inserts{0};
+  std::atomic<uint64_t> old_data_rejections{0};
+  std::atomic<uint64_t> late_inserts{0};
+  std::atomic<uint64_t> lookup_failures{0};
+  std::atomic<uint64_t> connectivity_failures{0};
+  std::atomic<uint64_t> extrapolation_failures{0};
+
+  Histogram query_lock_wait_ns;
+  Histogram query_lock_hold_ns;
+  Histogram insert_lock_wait_ns;
+  Histogram insert_lock_hold_ns;
+  Histogram chain_depth;
+  Histogram cache_search_steps;
+  Histogram transformable_requests_ns;
+  Histogram transformable_request_queue_length;
+  Histogram insert_lateness_ns;
+
+  TF2_PUBLIC
+  BufferCoreStatistics snapshot() const;
+
+  TF2_PUBLIC
+  void reset();
+
+  /** \brief Take a snapshot and reset to zero in one step, see Histogram::take(). */
+  TF2_PUBLIC
+  BufferCoreStatistics take();
+};
+
+}  // namespace tf2
+
+#endif  // TF2__BUFFER_CORE_STATISTICS_H_
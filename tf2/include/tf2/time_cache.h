@@ -31,11 +31,15 @@
 #define TF2__TIME_CACHE_H_
 
 #include <chrono>
+#include <cstdint>
 #include <memory>
+#include <memory_resource>
 #include <list>
+#include <set>
 #include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "tf2/visibility_control.h"
 #include "tf2/transform_storage.h"
@@ -67,6 +71,15 @@ public:
   TF2_PUBLIC
   virtual void clearList() = 0;
 
+  /** @brief Remove all values stamped after the given time
+   * Caches that cannot truncate fall back to clearing all values. */
+  TF2_PUBLIC
+  virtual void truncateAfter(tf2::TimePoint time)
+  {
+    (void)time;
+    clearList();
+  }
+
   /** \brief Retrieve the parent at a specific time */
   TF2_PUBLIC
   virtual CompactFrameID getParent(
@@ -97,11 +110,37 @@ using TimeCacheInterfacePtr = std::shared_ptr<TimeCacheInterface>;
 /// default value of 10 seconds storage
 constexpr tf2::Duration TIMECACHE_DEFAULT_MAX_STORAGE_TIME = std::chrono::seconds(10);
 
+/** \brief How rotations are interpolated between cache entries */
+enum class InterpolationPolicy
+{
+  /// Spherical linear interpolation, exact for a constant angular velocity
+  Slerp,
+  /** Normalized linear interpolation, which avoids the trigonometry of Slerp.
+   * Between entries theta radians apart it is off Slerp by less than theta^3 / 240 radians,
+   * about 4e-9 rad at 0.01 rad. Entries further apart than a threshold fall back on Slerp. */
+  Nlerp,
+};
+
+/// default largest rotation between entries interpolated with Nlerp, at most 5.3e-7 rad off
+constexpr double DEFAULT_NLERP_MAX_ANGLE = 0.05;
+
+/** \brief How a BufferCore stores the transforms it caches */
+enum class StoragePrecision
+{
+  /// Double precision, in TimeCache
+  Double,
+  /// Single precision, in CompactTimeCache, at about two thirds of the memory per entry
+  Single,
+};
+
 /** \brief A class to keep a sorted linked list in time
  * This builds and maintains a list of timestamped
  * data.  And provides lookup functions to get
- * data out as a function of time. */
-class TimeCache : public TimeCacheInterface
+ * data out as a function of time.
+ * \tparam StorageT How entries are stored, TransformStorage or CompactTransformStorage.
+ * Either way they are read back as TransformStorage, and interpolated in double precision. */
+template<typename StorageT>
+class BasicTimeCache : public TimeCacheInterface
 {
 public:
   /// Number of nano-seconds to not interpolate below.
@@ -111,8 +150,14 @@ public:
   /// Maximum length of linked list, to make sure not to be able to use unlimited memory.
   TF2_PUBLIC
   static const unsigned int MAX_LENGTH_LINKED_LIST = 1000000;
+  /** \brief Constructor
+   * \param max_storage_time How long to keep entries
+   * \param resource Where to allocate entries from, for example a pool reserved up front
+   */
   TF2_PUBLIC
-  explicit TimeCache(tf2::Duration max_storage_time = TIMECACHE_DEFAULT_MAX_STORAGE_TIME);
+  explicit BasicTimeCache(
+    tf2::Duration max_storage_time = TIMECACHE_DEFAULT_MAX_STORAGE_TIME,
+    std::pmr::memory_resource * resource = std::pmr::get_default_resource());
 
   /// Virtual methods
 
@@ -125,6 +170,8 @@ public:
   TF2_PUBLIC
   virtual void clearList();
   TF2_PUBLIC
+  virtual void truncateAfter(tf2::TimePoint time);
+  TF2_PUBLIC
   virtual tf2::CompactFrameID getParent(
     tf2::TimePoint time, std::string * error_str = 0, TF2Error * error_code = 0);
   TF2_PUBLIC
@@ -138,17 +185,68 @@ public:
   TF2_PUBLIC
   virtual TimePoint getOldestTimestamp();
 
+  /** @brief Append all entries stamped at or after a time to data_out, oldest first */
+  TF2_PUBLIC
+  void getDataSince(tf2::TimePoint time, std::vector<TransformStorage> & data_out);
+
+  /** @brief Get the number of stored entries stepped over by lookups on the calling thread
+   * This counter only ever grows, callers are expected to take differences. */
+  TF2_PUBLIC
+  static uint64_t getThreadSearchSteps();
+
+  /** @brief Allow lookups up to horizon past the latest entry, extrapolating from the last two.
+   * The velocity between the two latest entries is assumed to hold; with a single entry, or a
+   * parent change between them, the latest entry is held. Zero, the default, disables this. */
+  TF2_PUBLIC
+  void setPredictionHorizon(tf2::Duration horizon);
+
+  /** @brief Get the number of lookups on the calling thread answered by prediction
+   * This counter only ever grows, callers are expected to take differences. */
+  TF2_PUBLIC
+  static uint64_t getThreadPredictions();
+
+  /** @brief Choose how rotations are interpolated between entries
+   * \param policy The interpolation to use
+   * \param nlerp_max_angle With Nlerp, the largest rotation in radians between two entries to
+   * use it for, Slerp is used above it */
+  TF2_PUBLIC
+  void setInterpolationPolicy(
+    InterpolationPolicy policy, double nlerp_max_angle = DEFAULT_NLERP_MAX_ANGLE);
+
+  /** @brief Stage up to window entries that arrive behind the latest one, and merge them into
+   * the history together.
+   * Staged entries are kept ordered, so staging and finding one takes logarithmic time. Merging
+   * takes a single pass over the history, instead of one per late entry. Zero, the default,
+   * merges each late entry as it arrives. */
+  TF2_PUBLIC
+  void setReorderWindow(size_t window);
+
 private:
-  typedef std::list<TransformStorage> L_TransformStorage;
+  typedef std::pmr::list<StorageT> L_TransformStorage;
   L_TransformStorage storage_;
+  /// Orders staged entries newest first, and finds them by stamp
+  struct NewerFirst
+  {
+    using is_transparent = void;
+    bool operator()(const StorageT & a, const StorageT & b) const {return a.stamp_ > b.stamp_;}
+    bool operator()(const StorageT & a, tf2::TimePoint b) const {return a.stamp_ > b;}
+    bool operator()(tf2::TimePoint a, const StorageT & b) const {return a > b.stamp_;}
+  };
+  typedef std::pmr::multiset<StorageT, NewerFirst> S_TransformStorage;
+  /// Entries inserted behind the latest one that are not merged yet, newest first
+  S_TransformStorage reorder_;
+  size_t reorder_window_ = 0;
 
   tf2::Duration max_storage_time_;
+  tf2::Duration prediction_horizon_{0};
+  /// Cosine of half the largest angle interpolated with Nlerp, above 1 when using Slerp
+  double nlerp_min_dot_ = 2.0;
 
 
   // A helper function for getData
   // Assumes storage is already locked for it
   inline uint8_t findClosest(
-    tf2::TransformStorage * & one, TransformStorage * & two,
+    const StorageT * & one, const StorageT * & two,
     tf2::TimePoint target_time, std::string * error_str = 0, TF2Error * error_code = 0);
 
   inline void interpolate(
@@ -156,6 +254,26 @@ private:
     tf2::TimePoint time, tf2::TransformStorage & output);
 
   void pruneList();
+
+  /// Move the staged entries into storage_
+  void mergeReordered();
+};
+
+extern template class TF2_PUBLIC BasicTimeCache<TransformStorage>;
+extern template class TF2_PUBLIC BasicTimeCache<CompactTransformStorage>;
+
+/// A cache of double precision transforms
+class TimeCache : public BasicTimeCache<TransformStorage>
+{
+public:
+  using BasicTimeCache<TransformStorage>::BasicTimeCache;
+};
+
+/// A cache of single precision transforms, see StoragePrecision
+class CompactTimeCache : public BasicTimeCache<CompactTransformStorage>
+{
+public:
+  using BasicTimeCache<CompactTransformStorage>::BasicTimeCache;
 };
 
 class StaticCache : public TimeCacheInterface
@@ -171,6 +289,9 @@ public:
   virtual bool insertData(const TransformStorage & new_data);
   TF2_PUBLIC
   virtual void clearList();
+  /// Static transforms are valid at all times and are never truncated
+  TF2_PUBLIC
+  virtual void truncateAfter(TimePoint time);
   TF2_PUBLIC
   virtual CompactFrameID getParent(
     TimePoint time, std::string * error_str = 0, TF2Error * error_code = 0);
@@ -188,5 +309,57 @@ public:
 private:
   TransformStorage storage_;
 };
+
+/** \brief A static transform that caches of identical links hold once.
+ * BufferCore stores the static transforms of namespaced trees in these, see
+ * BufferCore::setTransform(). Other static transforms are held by a StaticCache.
+ */
+class SharedStaticCache : public TimeCacheInterface
+{
+public:
+  /// Virtual methods
+  TF2_PUBLIC
+  virtual bool getData(
+    TimePoint time, TransformStorage & data_out,
+    std::string * error_str = 0, TF2Error * error_code = 0);
+  TF2_PUBLIC
+  virtual bool insertData(const TransformStorage & new_data);
+  TF2_PUBLIC
+  virtual void clearList();
+  /// Static transforms are valid at all times and are never truncated
+  TF2_PUBLIC
+  virtual void truncateAfter(TimePoint time);
+  TF2_PUBLIC
+  virtual CompactFrameID getParent(
+    TimePoint time, std::string * error_str = 0, TF2Error * error_code = 0);
+  TF2_PUBLIC
+  virtual P_TimeAndFrameID getLatestTimeAndParent();
+
+  /// Debugging information methods
+  TF2_PUBLIC
+  virtual unsigned int getListLength();
+  TF2_PUBLIC
+  virtual TimePoint getLatestTimestamp();
+  TF2_PUBLIC
+  virtual TimePoint getOldestTimestamp();
+
+  /** \brief Store a transform held by another SharedStaticCache, without copying it.
+   * The stamp and frames of data are ignored, frame_id and child_frame_id are used instead.
+   */
+  TF2_PUBLIC
+  void insertSharedData(
+    std::shared_ptr<const TransformStorage> data, CompactFrameID frame_id,
+    CompactFrameID child_frame_id);
+
+  /// The stored transform, for insertSharedData() of another cache, null if there is none
+  TF2_PUBLIC
+  std::shared_ptr<const TransformStorage> getSharedData() const;
+
+private:
+  /// Immutable once stored, so that caches of identical links can share it
+  std::shared_ptr<const TransformStorage> storage_;
+  CompactFrameID frame_id_ = 0;
+  CompactFrameID child_frame_id_ = 0;
+};
 }  // namespace tf2
 #endif  // TF2__TIME_CACHE_H_
@@ -0,0 +1,94 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TF2__TRACING_H_
+#define TF2__TRACING_H_
+
+/** \file
+ * Static tracepoints for the tf2 and tf2_ros hot paths.
+ *
+ * Tracepoints are emitted with TF2_TRACEPOINT(event, args...), where event is one of the functions
+ * declared below. tf2 must be configured with -DTF2_TRACING=ON for them to exist, in which case
+ * they are LTTng-UST events of the "tf2" provider and can be recorded next to the ros2_tracing
+ * events, for example with
+ *
+ *   lttng create && lttng enable-event -u 'tf2:*' && lttng start
+ *
+ * Otherwise TF2_TRACEPOINT expands to nothing and its arguments are never evaluated.
+ */
+
+#ifdef TF2_TRACING_ENABLED
+
+#include <cstdint>
+
+#include "tf2/visibility_control.h"
+
+#define TF2_TRACEPOINT(event, ...) ::tf2::tracing::event(__VA_ARGS__)
+
+namespace tf2
+{
+namespace tracing
+{
+
+/// A transform was offered to a BufferCore, and stored if accepted is true.
+TF2_PUBLIC
+void set_transform(
+  const void * buffer, const char * frame_id, const char * child_frame_id, int64_t stamp_ns,
+  bool is_static, bool accepted);
+
+/// A BufferCore started looking up a transform, before taking its frame mutex.
+TF2_PUBLIC
+void lookup_transform_entry(
+  const void * buffer, const char * target_frame, const char * source_frame, int64_t time_ns);
+
+/// A BufferCore finished looking up a transform, with a tf2::TF2Error code.
+TF2_PUBLIC
+void lookup_transform_exit(const void * buffer, int error);
+
+/// A BufferCore started testing its pending transformable requests after an insert.
+TF2_PUBLIC
+void transformable_requests_entry(const void * buffer, uint64_t queue_length);
+
+/// A BufferCore finished testing its transformable requests, with the number still pending.
+TF2_PUBLIC
+void transformable_requests_exit(const void * buffer, uint64_t queue_length);
+
+/// A TransformListener received a message on /tf or /tf_static.
+TF2_PUBLIC
+void transform_listener_callback_entry(
+  const void * listener, uint64_t transform_count, bool is_static);
+
+/// A TransformListener finished inserting a message into its buffer.
+TF2_PUBLIC
+void transform_listener_callback_exit(const void * listener);
+
+/// A MessageFilter queued a message to wait for its transforms.
+TF2_PUBLIC
+void message_filter_add(const void * filter, const char * frame_id, int64_t stamp_ns);
+
+/// A MessageFilter released a message to its output, or dropped it with a FilterFailureReason.
+TF2_PUBLIC
+void message_filter_release(
+  const void * filter, const char * frame_id, int64_t stamp_ns, bool success, int reason);
+
+}  // namespace tracing
+}  // namespace tf2
+
+#else
+
+#define TF2_TRACEPOINT(event, ...) ((void)0)
+
+#endif  // TF2_TRACING_ENABLED
+
+#endif  // TF2__TRACING_H_
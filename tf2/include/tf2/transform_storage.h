@@ -73,5 +73,41 @@ public:
   CompactFrameID frame_id_;
   CompactFrameID child_frame_id_;
 };
+
+/** \brief Single precision storage for transforms and their parent
+ *
+ * About 60% of the size of TransformStorage, for caches that are bound by memory rather than by
+ * precision. Values are rounded to float when stored, and widened back to TransformStorage when
+ * read.
+ */
+class CompactTransformStorage
+{
+public:
+  CompactTransformStorage() = default;
+
+  explicit CompactTransformStorage(const TransformStorage & rhs)
+  : stamp_(rhs.stamp_),
+    rotation_{static_cast<float>(rhs.rotation_.x()), static_cast<float>(rhs.rotation_.y()),
+      static_cast<float>(rhs.rotation_.z()), static_cast<float>(rhs.rotation_.w())},
+    translation_{static_cast<float>(rhs.translation_.x()),
+      static_cast<float>(rhs.translation_.y()), static_cast<float>(rhs.translation_.z())},
+    frame_id_(rhs.frame_id_),
+    child_frame_id_(rhs.child_frame_id_)
+  {
+  }
+
+  operator TransformStorage() const
+  {
+    return TransformStorage(
+      stamp_, Quaternion(rotation_[0], rotation_[1], rotation_[2], rotation_[3]).normalized(),
+      Vector3(translation_[0], translation_[1], translation_[2]), frame_id_, child_frame_id_);
+  }
+
+  TimePoint stamp_;
+  float rotation_[4];
+  float translation_[3];
+  CompactFrameID frame_id_;
+  CompactFrameID child_frame_id_;
+};
 }  // namespace tf2
 #endif  // TF2__TRANSFORM_STORAGE_H_
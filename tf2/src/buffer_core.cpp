@@ -31,16 +31,28 @@
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <list>
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "tf2/buffer_core.h"
 #include "tf2/time_cache.h"
 #include "tf2/exceptions.h"
+#include "tf2/tracing.h"
 
 #include "console_bridge/console.h"
 #include "tf2/LinearMath/Quaternion.h"
@@ -50,6 +62,7 @@
 #include "builtin_interfaces/msg/time.hpp"
 #include "geometry_msgs/msg/transform.hpp"
 #include "geometry_msgs/msg/transform_stamped.hpp"
+#include "geometry_msgs/msg/twist_stamped.hpp"
 
 namespace tf2
 {
@@ -60,7 +73,7 @@ namespace
 // Tolerance for acceptable quaternion normalization
 constexpr static double QUATERNION_NORMALIZATION_TOLERANCE = 10e-3;
 
-bool startsWithSlash(const std::string & frame_id)
+bool startsWithSlash(std::string_view frame_id)
 {
   if (frame_id.size() > 0) {
     if (frame_id[0] == '/') {
@@ -70,13 +83,21 @@ bool startsWithSlash(const std::string & frame_id)
   return false;
 }
 
-std::string stripSlash(const std::string & in)
+// The result is a suffix of the input, so it stays null terminated if the input was.
+std::string_view stripSlash(std::string_view in)
 {
-  std::string out = in;
   if (startsWithSlash(in)) {
-    out.erase(0, 1);
+    in.remove_prefix(1);
   }
-  return out;
+  return in;
+}
+
+// Scratch space of getLatestCommonTime() for walks through loops of latest parents. It is reused
+// by every lookup of the calling thread, so that lookups do not allocate once it has grown.
+std::vector<P_TimeAndFrameID> & latestCommonTimeScratch()
+{
+  static thread_local std::vector<P_TimeAndFrameID> scratch;
+  return scratch;
 }
 
 void fillOrWarnMessageForInvalidFrame(
@@ -94,8 +115,252 @@ void fillOrWarnMessageForInvalidFrame(
   }
 }
 
+uint64_t elapsedNanoseconds(
+  std::chrono::steady_clock::time_point start,
+  std::chrono::steady_clock::time_point end)
+{
+  return static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+// Calls f with the cache if it keeps a history, whatever its precision
+template<typename F>
+void withTimeCache(TimeCacheInterface * cache, F && f)
+{
+  if (auto time_cache = dynamic_cast<TimeCache *>(cache)) {
+    f(*time_cache);
+  } else if (auto compact_cache = dynamic_cast<CompactTimeCache *>(cache)) {
+    f(*compact_cache);
+  }
+}
+
+enum class LockKind
+{
+  Query,
+  Insert,
+};
+
+/// Holds a mutex exclusively, recording the time to acquire it and the time it was held when
+/// statistics are enabled.
+class InstrumentedLock
+{
+public:
+  InstrumentedLock(
+    std::shared_mutex & mutex, BufferCoreStatisticsCollector * statistics, LockKind kind)
+  : hold_ns_(nullptr)
+  {
+    if (statistics == nullptr) {
+      lock_ = std::unique_lock<std::shared_mutex>(mutex);
+      return;
+    }
+    Histogram * wait_ns = kind == LockKind::Query ?
+      &statistics->query_lock_wait_ns : &statistics->insert_lock_wait_ns;
+    auto start = std::chrono::steady_clock::now();
+    lock_ = std::unique_lock<std::shared_mutex>(mutex);
+    hold_ns_ = kind == LockKind::Query ?
+      &statistics->query_lock_hold_ns : &statistics->insert_lock_hold_ns;
+    acquired_ = std::chrono::steady_clock::now();
+    wait_ns->record(elapsedNanoseconds(start, acquired_));
+  }
+
+  ~InstrumentedLock()
+  {
+    if (hold_ns_ != nullptr) {
+      hold_ns_->record(elapsedNanoseconds(acquired_, std::chrono::steady_clock::now()));
+    }
+  }
+
+private:
+  std::unique_lock<std::shared_mutex> lock_;
+  Histogram * hold_ns_;
+  std::chrono::steady_clock::time_point acquired_;
+};
+
+void recordQueryResult(BufferCoreStatisticsCollector * statistics, tf2::TF2Error error)
+{
+  if (statistics == nullptr) {
+    return;
+  }
+  statistics->queries.fetch_add(1, std::memory_order_relaxed);
+  switch (error) {
+    case tf2::TF2Error::TF2_NO_ERROR:
+      break;
+    case tf2::TF2Error::TF2_CONNECTIVITY_ERROR:
+      statistics->connectivity_failures.fetch_add(1, std::memory_order_relaxed);
+      break;
+    case tf2::TF2Error::TF2_EXTRAPOLATION_ERROR:
+    case tf2::TF2Error::TF2_BACKWARD_EXTRAPOLATION_ERROR:
+    case tf2::TF2Error::TF2_FORWARD_EXTRAPOLATION_ERROR:
+    case tf2::TF2Error::TF2_NO_DATA_FOR_EXTRAPOLATION_ERROR:
+      statistics->extrapolation_failures.fetch_add(1, std::memory_order_relaxed);
+      break;
+    default:
+      statistics->lookup_failures.fetch_add(1, std::memory_order_relaxed);
+      break;
+  }
+}
+
+// Whether a frame holds a static transform, shared or not
+bool isStaticCache(const TimeCacheInterface * cache)
+{
+  return dynamic_cast<const StaticCache *>(cache) != nullptr ||
+         dynamic_cast<const SharedStaticCache *>(cache) != nullptr;
+}
+
 }  // anonymous namespace
 
+/// Holds frame_mutex_ shared and a growing set of shards, recording the time to acquire them and
+/// the time they were held when statistics are enabled. Lookups hold their shards shared, inserts
+/// exclusively. A buffer without added shards only needs frame_mutex_, which inserts then hold
+/// exclusively.
+class BufferCore::ShardLock
+{
+public:
+  /// With blocking set to false nothing is waited for, see owns_lock() and acquire().
+  ShardLock(
+    const BufferCore & buffer, BufferCoreStatisticsCollector * statistics, LockKind kind,
+    bool blocking = true)
+  : buffer_(buffer), statistics_(statistics), kind_(kind), blocking_(blocking)
+  {
+    if (statistics_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+    // Buffers never lose their shards, so a stale answer only makes the insert lock more
+    if (kind_ == LockKind::Insert && !buffer_.sharded_.load(std::memory_order_acquire)) {
+      exclusive_lock_ = std::unique_lock<std::shared_mutex>(buffer_.frame_mutex_);
+      held_ = ~uint64_t(0);
+    } else {
+      frame_lock_ = blocking_ ? std::shared_lock<std::shared_mutex>(buffer_.frame_mutex_) :
+        std::shared_lock<std::shared_mutex>(buffer_.frame_mutex_, std::try_to_lock);
+      unsharded_ = frame_lock_.owns_lock() && kind_ == LockKind::Query &&
+        buffer_.shards_.size() == 1;
+      if (unsharded_) {
+        held_ = ~uint64_t(0);
+      }
+    }
+    if (statistics_) {
+      acquired_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ShardLock(const ShardLock &) = delete;
+  ShardLock & operator=(const ShardLock &) = delete;
+
+  ~ShardLock()
+  {
+    release();
+    if (statistics_ && owns_lock()) {
+      bool query = kind_ == LockKind::Query;
+      (query ? statistics_->query_lock_wait_ns : statistics_->insert_lock_wait_ns).record(
+        elapsedNanoseconds(start_, acquired_));
+      (query ? statistics_->query_lock_hold_ns : statistics_->insert_lock_hold_ns).record(
+        elapsedNanoseconds(acquired_, std::chrono::steady_clock::now()));
+    }
+  }
+
+  bool owns_lock() const
+  {
+    return frame_lock_.owns_lock() || exclusive_lock_.owns_lock();
+  }
+
+  /// Add the shards of mask to the held ones.
+  /// \return false if not blocking and one of them is taken
+  bool acquire(uint64_t mask)
+  {
+    mask &= ~held_;
+    if (mask == 0) {
+      return true;
+    }
+    if ((mask & ((uint64_t(2) << top_) - 1)) != 0 && held_ != 0) {
+      // Shards are only ever locked in ascending order, start over to add lower ones
+      mask |= held_;
+      release();
+    }
+    for (size_t shard = 0; shard < buffer_.shards_.size(); ++shard) {
+      uint64_t bit = uint64_t(1) << shard;
+      if ((mask & bit) == 0) {
+        continue;
+      }
+      std::shared_mutex & mutex = buffer_.shards_[shard]->mutex;
+      if (kind_ == LockKind::Query) {
+        if (blocking_) {
+          mutex.lock_shared();
+        } else if (!mutex.try_lock_shared()) {
+          return false;
+        }
+      } else if (blocking_) {
+        mutex.lock();
+      } else if (!mutex.try_lock()) {
+        return false;
+      }
+      held_ |= bit;
+      top_ = shard;
+    }
+    if (statistics_) {
+      acquired_ = std::chrono::steady_clock::now();
+    }
+    return true;
+  }
+
+  bool covers(CompactFrameID frame) const
+  {
+    return held_ == ~uint64_t(0) || (held_ & buffer_.shardBit(frame)) != 0;
+  }
+
+  bool coversAll() const
+  {
+    return (held_ & buffer_.allShards()) == buffer_.allShards();
+  }
+
+  /// Flag that a walk needed a shard which is not held
+  void miss()
+  {
+    missed_ = true;
+  }
+
+  /// Whether a walk flagged a miss since the last call
+  bool takeMiss()
+  {
+    bool missed = missed_;
+    missed_ = false;
+    return missed;
+  }
+
+private:
+  void release()
+  {
+    if (unsharded_ || exclusive_lock_.owns_lock()) {
+      return;
+    }
+    for (size_t shard = 0; held_ != 0; ++shard) {
+      uint64_t bit = uint64_t(1) << shard;
+      if ((held_ & bit) == 0) {
+        continue;
+      }
+      if (kind_ == LockKind::Query) {
+        buffer_.shards_[shard]->mutex.unlock_shared();
+      } else {
+        buffer_.shards_[shard]->mutex.unlock();
+      }
+      held_ &= ~bit;
+    }
+    top_ = 0;
+  }
+
+  const BufferCore & buffer_;
+  BufferCoreStatisticsCollector * statistics_;
+  LockKind kind_;
+  bool blocking_;
+  std::shared_lock<std::shared_mutex> frame_lock_;
+  std::unique_lock<std::shared_mutex> exclusive_lock_;
+  bool unsharded_ = false;
+  uint64_t held_ = 0;
+  size_t top_ = 0;
+  bool missed_ = false;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point acquired_;
+};
+
 CompactFrameID BufferCore::validateFrameId(
   const char * function_name_arg,
   const std::string & frame_id,
@@ -147,22 +412,35 @@ CompactFrameID BufferCore::validateFrameId(
   return id;
 }
 
-BufferCore::BufferCore(tf2::Duration cache_time)
+BufferCore::BufferCore(tf2::Duration cache_time, StoragePrecision storage_precision)
 : cache_time_(cache_time),
+  storage_precision_(storage_precision),
   transformable_callbacks_counter_(0),
   transformable_requests_counter_(0),
-  using_dedicated_thread_(false)
+  transformable_dispatch_(std::make_shared<TransformableDispatch>()),
+  using_dedicated_thread_(false),
+  statistics_enabled_(false)
 {
-  frameIDs_["NO_PARENT"] = 0;
+  shards_.push_back(std::make_unique<Shard>());
   frames_.push_back(TimeCacheInterfacePtr());
+  frame_shard_.push_back(0);
+  frame_links_.emplace_back();
   frameIDs_reverse_.push_back("NO_PARENT");
+  frameIDs_[frameIDs_reverse_.back()] = 0;
+  frame_authority_.push_back(0);
+  frame_prediction_horizon_.push_back(tf2::Duration::zero());
+  authorities_.push_back("no recorded authority");
+  authority_ids_[authorities_.back()] = 0;
 }
 
-BufferCore::~BufferCore() {}
+BufferCore::~BufferCore()
+{
+  transformable_dispatch_->close();
+}
 
 void BufferCore::clear()
 {
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  std::unique_lock<std::shared_mutex> lock(frame_mutex_);
   if (frames_.size() > 1) {
     for (std::vector<TimeCacheInterfacePtr>::iterator cache_it = frames_.begin() + 1;
       cache_it != frames_.end(); ++cache_it)
@@ -172,11 +450,33 @@ void BufferCore::clear()
       }
     }
   }
+  for (FrameLinks & links : frame_links_) {
+    links.reparented = false;
+  }
+  rebuildFrameLinks();
+}
+
+void BufferCore::rollbackTo(TimePoint time)
+{
+  std::unique_lock<std::shared_mutex> lock(frame_mutex_);
+  for (size_t i = 1; i < frames_.size(); ++i) {
+    if (frames_[i]) {
+      frames_[i]->truncateAfter(time);
+    }
+  }
+  rebuildFrameLinks();
 }
 
 bool BufferCore::setTransform(
   const geometry_msgs::msg::TransformStamped & transform,
   const std::string & authority, bool is_static)
+{
+  return setTransform(transform, authority, is_static, std::string());
+}
+
+bool BufferCore::setTransform(
+  const geometry_msgs::msg::TransformStamped & transform,
+  const std::string & authority, bool is_static, const std::string & tf_namespace)
 {
   tf2::Transform tf2_transform(tf2::Quaternion(
       transform.transform.rotation.x,
@@ -191,72 +491,129 @@ bool BufferCore::setTransform(
     std::chrono::duration_cast<std::chrono::nanoseconds>(
       std::chrono::seconds(
         transform.header.stamp.sec)));
+  if (tf_namespace.empty()) {
+    return setTransformImpl(
+      tf2_transform, transform.header.frame_id, transform.child_frame_id,
+      time_point, authority, is_static);
+  }
+
+  std::string frame_id;
+  std::string child_frame_id;
+  {
+    std::shared_lock<std::shared_mutex> lock(frame_mutex_);
+    frame_id = namespacedFrameIdNoLock(tf_namespace, transform.header.frame_id);
+    child_frame_id = namespacedFrameIdNoLock(tf_namespace, transform.child_frame_id);
+  }
+  std::string static_share_key;
+  if (is_static) {
+    // The link as it is named in its namespace, and its exact value
+    const double values[] = {
+      transform.transform.rotation.x, transform.transform.rotation.y,
+      transform.transform.rotation.z, transform.transform.rotation.w,
+      transform.transform.translation.x, transform.transform.translation.y,
+      transform.transform.translation.z};
+    static_share_key.append(stripSlash(transform.header.frame_id)).push_back('\0');
+    static_share_key.append(stripSlash(transform.child_frame_id)).push_back('\0');
+    static_share_key.append(reinterpret_cast<const char *>(values), sizeof(values));
+  }
   return setTransformImpl(
-    tf2_transform, transform.header.frame_id, transform.child_frame_id,
-    time_point, authority, is_static);
+    tf2_transform, frame_id, child_frame_id, time_point, authority, is_static,
+    static_share_key);
 }
 
-bool BufferCore::setTransformImpl(
-  const tf2::Transform & transform_in, const std::string frame_id,
-  const std::string child_frame_id, const TimePoint stamp,
-  const std::string & authority, bool is_static)
+void BufferCore::addSharedFrame(const std::string & frame_id)
 {
-  std::string stripped_frame_id = stripSlash(frame_id);
-  std::string stripped_child_frame_id = stripSlash(child_frame_id);
+  std::unique_lock<std::shared_mutex> lock(frame_mutex_);
+  shared_frames_.emplace(stripSlash(frame_id));
+}
 
+std::string BufferCore::namespacedFrameId(
+  const std::string & tf_namespace, const std::string & frame_id) const
+{
+  std::shared_lock<std::shared_mutex> lock(frame_mutex_);
+  return namespacedFrameIdNoLock(tf_namespace, frame_id);
+}
+
+// This method expects that the caller is holding frame_mutex_
+std::string BufferCore::namespacedFrameIdNoLock(
+  std::string_view tf_namespace, std::string_view frame_id) const
+{
+  frame_id = stripSlash(frame_id);
+  while (!tf_namespace.empty() && tf_namespace.front() == '/') {
+    tf_namespace.remove_prefix(1);
+  }
+  while (!tf_namespace.empty() && tf_namespace.back() == '/') {
+    tf_namespace.remove_suffix(1);
+  }
+  // Empty frames stay empty, for setTransformImpl to reject
+  if (frame_id.empty() || tf_namespace.empty() ||
+    shared_frames_.find(std::string(frame_id)) != shared_frames_.end())
+  {
+    return std::string(frame_id);
+  }
+  std::string namespaced;
+  namespaced.reserve(tf_namespace.size() + 1 + frame_id.size());
+  namespaced.append(tf_namespace).push_back('/');
+  namespaced.append(frame_id);
+  return namespaced;
+}
+
+template<typename Insert>
+bool BufferCore::checkAndInsert(
+  const tf2::Quaternion & rotation, const tf2::Vector3 & origin,
+  std::string_view frame_id, std::string_view child_frame_id, TimePoint stamp,
+  const std::string & authority, bool is_static, Insert && insert)
+{
+  // Only traced, which may be compiled out
+  (void)is_static;
   bool error_exists = false;
-  if (stripped_child_frame_id == stripped_frame_id) {
+  if (child_frame_id == frame_id) {
     CONSOLE_BRIDGE_logError(
       "TF_SELF_TRANSFORM: Ignoring transform from authority \"%s\" with frame_id and  "
       "child_frame_id \"%s\" because they are the same",
-      authority.c_str(), stripped_child_frame_id.c_str());
+      authority.c_str(), child_frame_id.data());
     error_exists = true;
   }
 
-  if (stripped_child_frame_id.empty()) {
+  if (child_frame_id.empty()) {
     CONSOLE_BRIDGE_logError(
       "TF_NO_CHILD_FRAME_ID: Ignoring transform from authority \"%s\" because child_frame_id not"
       " set ", authority.c_str());
     error_exists = true;
   }
 
-  if (stripped_frame_id.empty()) {
+  if (frame_id.empty()) {
     CONSOLE_BRIDGE_logError(
       "TF_NO_FRAME_ID: Ignoring transform with child_frame_id \"%s\"  from authority \"%s\" "
-      "because frame_id not set", stripped_child_frame_id.c_str(), authority.c_str());
+      "because frame_id not set", child_frame_id.data(), authority.c_str());
     error_exists = true;
   }
 
-  if (std::isnan(transform_in.getOrigin().x()) || std::isnan(transform_in.getOrigin().y()) ||
-    std::isnan(transform_in.getOrigin().z()) ||
-    std::isnan(transform_in.getRotation().x()) || std::isnan(transform_in.getRotation().y()) ||
-    std::isnan(transform_in.getRotation().z()) || std::isnan(transform_in.getRotation().w()))
+  if (std::isnan(origin.x()) || std::isnan(origin.y()) || std::isnan(origin.z()) ||
+    std::isnan(rotation.x()) || std::isnan(rotation.y()) ||
+    std::isnan(rotation.z()) || std::isnan(rotation.w()))
   {
     CONSOLE_BRIDGE_logError(
       "TF_NAN_INPUT: Ignoring transform for child_frame_id \"%s\" from authority \"%s\" because"
       " of a nan value in the transform (%f %f %f) (%f %f %f %f)",
-      stripped_child_frame_id.c_str(), authority.c_str(),
-      transform_in.getOrigin().x(), transform_in.getOrigin().y(), transform_in.getOrigin().z(),
-      transform_in.getRotation().x(), transform_in.getRotation().y(),
-      transform_in.getRotation().z(), transform_in.getRotation().w()
+      child_frame_id.data(), authority.c_str(),
+      origin.x(), origin.y(), origin.z(),
+      rotation.x(), rotation.y(), rotation.z(), rotation.w()
     );
     error_exists = true;
   }
 
   bool valid = std::abs(
-    (transform_in.getRotation().w() * transform_in.getRotation().w() +
-    transform_in.getRotation().x() * transform_in.getRotation().x() +
-    transform_in.getRotation().y() * transform_in.getRotation().y() +
-    transform_in.getRotation().z() * transform_in.getRotation().z()) - 1.0f) <
+    (rotation.w() * rotation.w() + rotation.x() * rotation.x() +
+    rotation.y() * rotation.y() + rotation.z() * rotation.z()) - 1.0f) <
     QUATERNION_NORMALIZATION_TOLERANCE;
 
   if (!valid) {
     CONSOLE_BRIDGE_logError(
       "TF_DENORMALIZED_QUATERNION: Ignoring transform for child_frame_id \"%s\" from authority"
       " \"%s\" because of an invalid quaternion in the transform (%f %f %f %f)",
-      stripped_child_frame_id.c_str(), authority.c_str(),
-      transform_in.getRotation().x(), transform_in.getRotation().y(),
-      transform_in.getRotation().z(), transform_in.getRotation().w());
+      child_frame_id.data(), authority.c_str(),
+      rotation.x(), rotation.y(), rotation.z(), rotation.w());
     error_exists = true;
   }
 
@@ -264,56 +621,581 @@ bool BufferCore::setTransformImpl(
     return false;
   }
 
+  BufferCoreStatisticsCollector * statistics = activeStatistics();
+  // The latest transform of the frame before this one, to tell how late this one is
+  TimePoint latest = TimePointZero;
+  bool inserted = insert(latest);
+
+  if (inserted) {
+    if (statistics) {
+      statistics->inserts.fetch_add(1, std::memory_order_relaxed);
+      if (stamp < latest) {
+        statistics->late_inserts.fetch_add(1, std::memory_order_relaxed);
+        statistics->insert_lateness_ns.record(
+          static_cast<uint64_t>(std::chrono::nanoseconds(latest - stamp).count()));
+      }
+    }
+    TF2_TRACEPOINT(
+      set_transform, this, frame_id.data(), child_frame_id.data(),
+      stamp.time_since_epoch().count(), is_static, true);
+  } else {
+    if (statistics) {
+      statistics->old_data_rejections.fetch_add(1, std::memory_order_relaxed);
+    }
+    TF2_TRACEPOINT(
+      set_transform, this, frame_id.data(), child_frame_id.data(),
+      stamp.time_since_epoch().count(), is_static, false);
+    std::string stamp_str = displayTimePoint(stamp);
+    CONSOLE_BRIDGE_logWarn(
+      "TF_OLD_DATA ignoring data from the past for frame %s at time %s according to authority"
+      " %s\nPossible reasons are listed at http://wiki.ros.org/tf/Errors%%20explained",
+      child_frame_id.data(), stamp_str.c_str(), authority.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool BufferCore::setTransformImpl(
+  const tf2::Transform & transform_in, const std::string & frame_id,
+  const std::string & child_frame_id, const TimePoint stamp,
+  const std::string & authority, bool is_static, const std::string & static_share_key)
+{
+  // Views into the arguments, which stay null terminated and can be logged with data()
+  std::string_view stripped_frame_id = stripSlash(frame_id);
+  std::string_view stripped_child_frame_id = stripSlash(child_frame_id);
+
+  BufferCoreStatisticsCollector * statistics = activeStatistics();
+  bool inserted = checkAndInsert(
+    transform_in.getRotation(), transform_in.getOrigin(), stripped_frame_id,
+    stripped_child_frame_id, stamp, authority, is_static, [&](TimePoint & latest) {
+      bool inserted = false;
+      bool stored = false;
+      if (!is_static) {
+        // Updates of known frames that keep their parent only lock the shard of the child
+        ShardLock shards(*this, statistics, LockKind::Insert);
+        auto child_it = frameIDs_.find(stripped_child_frame_id);
+        auto parent_it = frameIDs_.find(stripped_frame_id);
+        auto authority_it = authority_ids_.find(authority);
+        if (child_it != frameIDs_.end() && parent_it != frameIDs_.end() &&
+          authority_it != authority_ids_.end() &&
+          frame_links_[child_it->second].parent == parent_it->second)
+        {
+          CompactFrameID frame_number = child_it->second;
+          TimeCacheInterfacePtr frame = getFrame(frame_number);
+          if (frame && !isStaticCache(frame.get())) {
+            shards.acquire(shardBit(frame_number));
+            latest = frame->getLatestTimestamp();
+            inserted = frame->insertData(
+              TransformStorage(
+                stamp, transform_in.getRotation(), transform_in.getOrigin(), parent_it->second,
+                frame_number));
+            if (inserted) {
+              frame_authority_[frame_number] = authority_it->second;
+            }
+            stored = true;
+          }
+        }
+      }
+
+      if (!stored) {
+        InstrumentedLock lock(frame_mutex_, statistics, LockKind::Insert);
+        CompactFrameID frame_number = lookupOrInsertFrameNumber(stripped_child_frame_id);
+        CompactFrameID parent_number = lookupOrInsertFrameNumber(stripped_frame_id);
+        const bool shared_static = is_static && !static_share_key.empty();
+        TimeCacheInterfacePtr frame = getFrame(frame_number);
+        if (frame == nullptr) {
+          frame = allocateFrame(frame_number, is_static, parent_number, shared_static);
+        } else {
+          // Overwrite TimeCacheInterface type with a current input
+          const bool frame_is_static = isStaticCache(frame.get());
+          const bool frame_is_shared = dynamic_cast<SharedStaticCache *>(frame.get()) != nullptr;
+          if (frame_is_static != is_static || frame_is_shared != shared_static) {
+            frame = allocateFrame(frame_number, is_static, parent_number, shared_static);
+          }
+        }
+
+        TransformStorage storage(
+          stamp, transform_in.getRotation(), transform_in.getOrigin(), parent_number, frame_number);
+        inserted = true;
+        if (shared_static) {
+          // Share the transform with the identical links of other namespaces
+          SharedStaticCache & static_cache = static_cast<SharedStaticCache &>(*frame);
+          auto shared_it = shared_static_transforms_.try_emplace(static_share_key);
+          std::weak_ptr<const TransformStorage> & shared = shared_it.first->second;
+          std::shared_ptr<const TransformStorage> data = shared.lock();
+          if (data) {
+            static_cache.insertSharedData(
+              std::move(data), storage.frame_id_, storage.child_frame_id_);
+          } else {
+            static_cache.insertData(storage);
+            shared = static_cache.getSharedData();
+          }
+          // An entry expires when the last link holding it is replaced. Erasing the expired ones
+          // each time the map doubles keeps it within twice the transforms still shared.
+          if (shared_it.second && shared_static_transforms_.size() >= shared_static_sweep_size_) {
+            for (auto it = shared_static_transforms_.begin();
+              it != shared_static_transforms_.end(); )
+            {
+              it = it->second.expired() ? shared_static_transforms_.erase(it) : std::next(it);
+            }
+            shared_static_sweep_size_ = std::max<size_t>(2 * shared_static_transforms_.size(), 32);
+          }
+        } else {
+          latest = frame->getLatestTimestamp();
+          inserted = frame->insertData(storage);
+        }
+
+        if (inserted) {
+          frame_authority_[frame_number] = internAuthority(authority);
+          updateFrameLinks(frame_number, frame, parent_number);
+        }
+      }
+      return inserted;
+    });
+  if (!inserted) {
+    return false;
+  }
+
+  testTransformableRequests();
+
+  return true;
+}
+
+size_t BufferCore::setTransformHistory(
+  const TransformHistory & history, const std::string & authority)
+{
+  BufferCoreStatisticsCollector * statistics = activeStatistics();
+  size_t stored = 0;
   {
-    std::unique_lock<std::mutex> lock(frame_mutex_);
-    CompactFrameID frame_number = lookupOrInsertFrameNumber(stripped_child_frame_id);
-    TimeCacheInterfacePtr frame = getFrame(frame_number);
-    if (frame == nullptr) {
-      frame = allocateFrame(frame_number, is_static);
-    } else {
-      // Overwrite TimeCacheInterface type with a current input
-      const TimeCache * time_cache_ptr = dynamic_cast<TimeCache *>(frame.get());
-      const StaticCache * static_cache_ptr = dynamic_cast<StaticCache *>(frame.get());
-      if (time_cache_ptr && is_static) {
-        frame = allocateFrame(frame_number, is_static);
-      } else if (static_cache_ptr && !is_static) {
-        frame = allocateFrame(frame_number, is_static);
+    InstrumentedLock lock(frame_mutex_, statistics, LockKind::Insert);
+
+    // Resolve every frame name once, 0 marks names that cannot be used
+    std::vector<CompactFrameID> frame_numbers(history.frame_ids.size(), 0);
+    for (size_t i = 0; i < history.frame_ids.size(); ++i) {
+      std::string_view stripped = stripSlash(history.frame_ids[i]);
+      if (!stripped.empty()) {
+        frame_numbers[i] = lookupOrInsertFrameNumber(stripped);
       }
     }
 
-    if (frame->insertData(
-        TransformStorage(
-          stamp, transform_in.getRotation(),
-          transform_in.getOrigin(), lookupOrInsertFrameNumber(stripped_frame_id), frame_number)))
-    {
-      frame_authority_[frame_number] = authority;
+    uint32_t authority_id = internAuthority(authority);
+    for (const TransformStorage & transform : history.transforms) {
+      if (transform.frame_id_ >= frame_numbers.size() ||
+        transform.child_frame_id_ >= frame_numbers.size())
+      {
+        continue;
+      }
+      TransformStorage storage(transform);
+      storage.frame_id_ = frame_numbers[transform.frame_id_];
+      storage.child_frame_id_ = frame_numbers[transform.child_frame_id_];
+      if (insertCompactData(storage, authority_id)) {
+        ++stored;
+      }
+    }
+  }
+
+  if (stored > 0) {
+    testTransformableRequests();
+  }
+  return stored;
+}
+
+TransformHistory BufferCore::getTransformHistory(TimePoint since) const
+{
+  TransformHistory history;
+  // Copying every cache only has to exclude writers, like the snapshot of allFramesAsYAML()
+  ShardLock shards(*this, nullptr, LockKind::Query);
+  shards.acquire(allShards());
+  history.frame_ids.assign(frameIDs_reverse_.begin(), frameIDs_reverse_.end());
+  for (size_t i = 1; i < frames_.size(); ++i) {
+    withTimeCache(
+      frames_[i].get(), [&](auto & cache) {
+        cache.getDataSince(since, history.transforms);
+      });
+  }
+  return history;
+}
+
+void BufferCore::resolveFrameNumbers(
+  const std::vector<std::string> & frame_ids, std::vector<CompactFrameID> & frame_numbers)
+{
+  std::unique_lock<std::shared_mutex> lock(frame_mutex_);
+  frame_numbers.resize(frame_ids.size());
+  for (size_t i = 0; i < frame_ids.size(); ++i) {
+    std::string_view stripped = stripSlash(frame_ids[i]);
+    frame_numbers[i] = stripped.empty() ? 0 : lookupOrInsertFrameNumber(stripped);
+  }
+}
+
+size_t BufferCore::setCompactTransforms(
+  const std::vector<TransformStorage> & transforms, const std::string & authority)
+{
+  BufferCoreStatisticsCollector * statistics = activeStatistics();
+  size_t stored = 0;
+  {
+    InstrumentedLock lock(frame_mutex_, statistics, LockKind::Insert);
+    uint32_t authority_id = internAuthority(authority);
+    for (const TransformStorage & storage : transforms) {
+      if (insertCompactData(storage, authority_id)) {
+        ++stored;
+      }
+    }
+  }
+
+  if (stored > 0) {
+    testTransformableRequests();
+  }
+  return stored;
+}
+
+// This method expects that the caller is holding frame_mutex_
+bool BufferCore::insertCompactData(const TransformStorage & storage, uint32_t authority_id)
+{
+  CompactFrameID parent = storage.frame_id_;
+  CompactFrameID child = storage.child_frame_id_;
+  if (parent == 0 || child == 0 || parent >= frames_.size() || child >= frames_.size()) {
+    return false;
+  }
+  TimeCacheInterfacePtr frame = getFrame(child);
+  if (frame != nullptr && isStaticCache(frame.get())) {
+    return false;
+  }
+
+  // Checked, logged and counted like the transforms of setTransform()
+  return checkAndInsert(
+    storage.rotation_, storage.translation_, frameIDs_reverse_[parent], frameIDs_reverse_[child],
+    storage.stamp_, authorities_[authority_id], false, [&](TimePoint & latest) {
+      if (frame == nullptr) {
+        frame = allocateFrame(child, false, parent);
+      }
+      latest = frame->getLatestTimestamp();
+      if (!frame->insertData(storage)) {
+        return false;
+      }
+      frame_authority_[child] = authority_id;
+      updateFrameLinks(child, frame, parent);
+      return true;
+    });
+}
+
+// This method expects that the caller is holding frame_mutex_
+uint32_t BufferCore::internAuthority(std::string_view authority)
+{
+  auto it = authority_ids_.find(authority);
+  if (it != authority_ids_.end()) {
+    return it->second;
+  }
+  uint32_t id = static_cast<uint32_t>(authorities_.size());
+  authorities_.emplace_back(authority);
+  authority_ids_[authorities_.back()] = id;
+  return id;
+}
+
+void BufferCore::reserve(size_t max_frames, size_t max_entries_per_frame)
+{
+  std::unique_lock<std::shared_mutex> lock(frame_mutex_);
+  // Index 0 is reserved for "no parent"
+  frames_.reserve(max_frames + 1);
+  frameIDs_.reserve(max_frames + 1);
+  frame_authority_.reserve(max_frames + 1);
+  frame_prediction_horizon_.reserve(max_frames + 1);
+  frame_shard_.reserve(max_frames + 1);
+  frame_links_.reserve(max_frames + 1);
+  // A walk through a loop of latest parents visits each frame once at most
+  latestCommonTimeScratch().reserve(max_frames + 1);
+
+  // The pools keep the nodes released by these lists, and hand them to the caches later on
+  for (const std::unique_ptr<Shard> & shard : shards_) {
+    if (storage_precision_ == StoragePrecision::Single) {
+      std::pmr::list<CompactTransformStorage> warm_up(&shard->resource);
+      warm_up.resize(max_frames * max_entries_per_frame);
     } else {
-      std::string stamp_str = displayTimePoint(stamp);
-      CONSOLE_BRIDGE_logWarn(
-        "TF_OLD_DATA ignoring data from the past for frame %s at time %s according to authority"
-        " %s\nPossible reasons are listed at http://wiki.ros.org/tf/Errors%%20explained",
-        stripped_child_frame_id.c_str(), stamp_str.c_str(), authority.c_str());
-      return false;
+      std::pmr::list<TransformStorage> warm_up(&shard->resource);
+      warm_up.resize(max_frames * max_entries_per_frame);
     }
   }
+}
 
-  testTransformableRequests();
+void BufferCore::addShard(const std::string & subtree_root)
+{
+  std::string_view stripped = stripSlash(subtree_root);
+  if (stripped.empty()) {
+    throw tf2::InvalidArgumentException("Cannot add a shard for an empty frame id");
+  }
+  std::unique_lock<std::shared_mutex> lock(frame_mutex_);
+  if (shard_roots_.find(std::string(stripped)) != shard_roots_.end()) {
+    return;
+  }
+  if (shards_.size() == MAX_SHARDS) {
+    throw tf2::InvalidArgumentException(
+            "Cannot add a shard for \"" + std::string(stripped) + "\", there are already " +
+            std::to_string(MAX_SHARDS) + " shards");
+  }
+  uint8_t shard = static_cast<uint8_t>(shards_.size());
+  shards_.push_back(std::make_unique<Shard>());
+  sharded_.store(true, std::memory_order_release);
+  shard_roots_.emplace(stripped, shard);
+  // Frames with caches allocate from the pool of their shard, so they stay where they are
+  CompactFrameID cfid = lookupFrameNumber(stripped);
+  if (cfid != 0 && !frames_[cfid]) {
+    frame_shard_[cfid] = shard;
+  }
+}
 
-  return true;
+void BufferCore::setPredictionHorizon(const std::string & frame_id, tf2::Duration horizon)
+{
+  std::string_view stripped = stripSlash(frame_id);
+  if (stripped.empty()) {
+    throw tf2::InvalidArgumentException("Cannot set a prediction horizon for an empty frame id");
+  }
+  std::unique_lock<std::shared_mutex> lock(frame_mutex_);
+  CompactFrameID frame_number = lookupOrInsertFrameNumber(stripped);
+  frame_prediction_horizon_[frame_number] = horizon;
+  // Static frames never extrapolate, they are left alone
+  withTimeCache(
+    frames_[frame_number].get(), [&](auto & cache) {
+      cache.setPredictionHorizon(horizon);
+    });
+}
+
+void BufferCore::setInterpolationPolicy(InterpolationPolicy policy, double nlerp_max_angle)
+{
+  std::unique_lock<std::shared_mutex> lock(frame_mutex_);
+  interpolation_policy_ = policy;
+  nlerp_max_angle_ = nlerp_max_angle;
+  for (size_t i = 1; i < frames_.size(); ++i) {
+    withTimeCache(
+      frames_[i].get(), [&](auto & cache) {
+        cache.setInterpolationPolicy(policy, nlerp_max_angle);
+      });
+  }
+}
+
+void BufferCore::setReorderWindow(size_t window)
+{
+  std::unique_lock<std::shared_mutex> lock(frame_mutex_);
+  reorder_window_ = window;
+  for (size_t i = 1; i < frames_.size(); ++i) {
+    withTimeCache(
+      frames_[i].get(), [&](auto & cache) {
+        cache.setReorderWindow(window);
+      });
+  }
 }
 
 // This method expects that the caller is holding frame_mutex_
-TimeCacheInterfacePtr BufferCore::allocateFrame(CompactFrameID cfid, bool is_static)
+template<typename CacheT>
+TimeCacheInterfacePtr BufferCore::makeTimeCache(CompactFrameID cfid) const
 {
-  if (is_static) {
+  auto cache = std::make_shared<CacheT>(cache_time_, &shards_[frame_shard_[cfid]]->resource);
+  cache->setPredictionHorizon(frame_prediction_horizon_[cfid]);
+  cache->setInterpolationPolicy(interpolation_policy_, nlerp_max_angle_);
+  cache->setReorderWindow(reorder_window_);
+  return cache;
+}
+
+// This method expects that the caller is holding frame_mutex_ exclusively
+TimeCacheInterfacePtr BufferCore::allocateFrame(
+  CompactFrameID cfid, bool is_static, CompactFrameID parent, bool shared_static)
+{
+  if (!frames_[cfid] && shard_roots_.find(frameIDs_reverse_[cfid]) == shard_roots_.end()) {
+    frame_shard_[cfid] = frame_shard_[parent];
+  }
+  if (shared_static) {
+    frames_[cfid] = std::make_shared<SharedStaticCache>();
+  } else if (is_static) {
     frames_[cfid] = std::make_shared<StaticCache>();
+  } else if (storage_precision_ == StoragePrecision::Single) {
+    frames_[cfid] = makeTimeCache<CompactTimeCache>(cfid);
   } else {
-    frames_[cfid] = std::make_shared<TimeCache>(cache_time_);
+    frames_[cfid] = makeTimeCache<TimeCache>(cfid);
   }
 
   return frames_[cfid];
 }
 
+// This method expects that the caller is holding frame_mutex_ exclusively
+void BufferCore::updateFrameLinks(
+  CompactFrameID cfid, const TimeCacheInterfacePtr & cache, CompactFrameID parent)
+{
+  FrameLinks & links = frame_links_[cfid];
+  bool newly_reparented = false;
+  if (links.parent != 0 && parent != links.parent && !links.reparented) {
+    links.reparented = true;
+    newly_reparented = true;
+  }
+  CompactFrameID latest_parent = cache->getLatestTimeAndParent().second;
+  if (latest_parent == links.parent) {
+    if (newly_reparented && !latest_parents_loop_) {
+      // Older data with another parent, the frames below can no longer be told apart in O(1)
+      updateSubtreeLinks(cfid);
+    }
+    return;
+  }
+  if (latest_parents_loop_) {
+    // Only looking at every frame tells whether this breaks the loop
+    rebuildFrameLinks();
+    return;
+  }
+
+  // The new parent closes a loop if the frame is one of its ancestors
+  const FrameLinks & parent_links = frame_links_[latest_parent];
+  if (latest_parent != 0 && parent_links.root == links.root && parent_links.depth >= links.depth) {
+    CompactFrameID ancestor = latest_parent;
+    while (frame_links_[ancestor].depth > links.depth) {
+      ancestor = frame_links_[ancestor].parent;
+    }
+    if (ancestor == cfid) {
+      CONSOLE_BRIDGE_logWarn(
+        "TF_LOOP: The latest transform of frame \"%s\" makes it a child of \"%s\", which is one"
+        " of its own descendants. Lookups through these frames fail until the loop is broken.",
+        frameIDs_reverse_[cfid].c_str(), frameIDs_reverse_[latest_parent].c_str());
+      rebuildFrameLinks();
+      return;
+    }
+  }
+
+  if (links.parent != 0) {
+    std::vector<CompactFrameID> & siblings = frame_links_[links.parent].children;
+    *std::find(siblings.begin(), siblings.end(), cfid) = siblings.back();
+    siblings.pop_back();
+  }
+  links.parent = latest_parent;
+  if (latest_parent != 0) {
+    frame_links_[latest_parent].children.push_back(cfid);
+  }
+
+  // Move the subtree along
+  updateSubtreeLinks(cfid);
+}
+
+// This method expects that the caller is holding frame_mutex_ exclusively
+void BufferCore::updateSubtreeLinks(CompactFrameID cfid)
+{
+  subtree_scratch_.clear();
+  subtree_scratch_.push_back(cfid);
+  while (!subtree_scratch_.empty()) {
+    CompactFrameID frame = subtree_scratch_.back();
+    subtree_scratch_.pop_back();
+    inheritLinks(frame);
+    const std::vector<CompactFrameID> & children = frame_links_[frame].children;
+    subtree_scratch_.insert(subtree_scratch_.end(), children.begin(), children.end());
+  }
+}
+
+// This method expects that the caller is holding frame_mutex_ exclusively
+void BufferCore::inheritLinks(CompactFrameID cfid)
+{
+  FrameLinks & links = frame_links_[cfid];
+  if (links.parent == 0) {
+    links.root = cfid;
+    links.depth = 0;
+    links.chain_reparented = links.reparented;
+  } else {
+    const FrameLinks & parent_links = frame_links_[links.parent];
+    links.root = parent_links.root;
+    links.depth = parent_links.depth + 1;
+    links.chain_reparented = links.reparented || parent_links.chain_reparented;
+  }
+}
+
+// This method expects that the caller is holding frame_mutex_ exclusively
+void BufferCore::rebuildFrameLinks()
+{
+  for (FrameLinks & links : frame_links_) {
+    links.children.clear();
+    links.depth = std::numeric_limits<uint32_t>::max();
+  }
+  subtree_scratch_.clear();
+  for (size_t i = 1; i < frames_.size(); ++i) {
+    CompactFrameID cfid = static_cast<CompactFrameID>(i);
+    FrameLinks & links = frame_links_[cfid];
+    links.parent = frames_[cfid] ? frames_[cfid]->getLatestTimeAndParent().second : 0;
+    if (links.parent == 0) {
+      subtree_scratch_.push_back(cfid);
+    } else {
+      frame_links_[links.parent].children.push_back(cfid);
+    }
+  }
+
+  // Walk down from the roots, the frames that are not reached are on or below a loop
+  size_t reached = 0;
+  while (!subtree_scratch_.empty()) {
+    CompactFrameID frame = subtree_scratch_.back();
+    subtree_scratch_.pop_back();
+    inheritLinks(frame);
+    ++reached;
+    const std::vector<CompactFrameID> & children = frame_links_[frame].children;
+    subtree_scratch_.insert(subtree_scratch_.end(), children.begin(), children.end());
+  }
+  frame_links_[0].root = 0;
+  frame_links_[0].depth = 0;
+  latest_parents_loop_ = reached + 1 != frame_links_.size();
+  if (latest_parents_loop_) {
+    for (FrameLinks & links : frame_links_) {
+      if (links.depth == std::numeric_limits<uint32_t>::max()) {
+        links.root = 0;
+      }
+    }
+  }
+}
+
+// This method expects that the caller is holding frame_mutex_
+CompactFrameID BufferCore::chainsMeet(CompactFrameID target_id, CompactFrameID source_id) const
+{
+  if (latest_parents_loop_ || frame_links_[target_id].root != frame_links_[source_id].root) {
+    return 0;
+  }
+  while (target_id != source_id) {
+    CompactFrameID & deeper =
+      frame_links_[target_id].depth >= frame_links_[source_id].depth ? target_id : source_id;
+    if (frame_links_[deeper].reparented) {
+      return 0;
+    }
+    deeper = frame_links_[deeper].parent;
+  }
+  return target_id;
+}
+
+// This method expects that the caller is holding frame_mutex_
+uint64_t BufferCore::pathShards(CompactFrameID cfid) const
+{
+  uint64_t shards = 0;
+  for (uint32_t depth = 0; cfid != 0 && frames_[cfid] && depth <= MAX_GRAPH_DEPTH; ++depth) {
+    shards |= shardBit(cfid);
+    cfid = frame_links_[cfid].parent;
+  }
+  return shards;
+}
+
+template<typename Walk>
+tf2::TF2Error BufferCore::withChainShards(
+  ShardLock & shards, CompactFrameID target_id, CompactFrameID source_id, Walk && walk,
+  CompactFrameID fixed_id) const
+{
+  uint64_t needed = shards_.size() == 1 ? 1 :
+    pathShards(target_id) | pathShards(source_id) | pathShards(fixed_id);
+  return withShards(shards, needed, std::forward<Walk>(walk));
+}
+
+template<typename Walk>
+tf2::TF2Error BufferCore::withShards(ShardLock & shards, uint64_t needed, Walk && walk) const
+{
+  if (!shards.acquire(needed)) {
+    return tf2::TF2Error::TF2_TIMEOUT_ERROR;
+  }
+  tf2::TF2Error retval = walk();
+  if (shards.takeMiss()) {
+    // The walk left the hinted chains, for instance because a parent changed over time
+    if (!shards.acquire(allShards())) {
+      return tf2::TF2Error::TF2_TIMEOUT_ERROR;
+    }
+    retval = walk();
+  }
+  return retval;
+}
+
 enum WalkEnding
 {
   Identity,
@@ -326,7 +1208,7 @@ template<typename F>
 tf2::TF2Error BufferCore::walkToTopParent(
   F & f, TimePoint time, CompactFrameID target_id,
   CompactFrameID source_id, std::string * error_string, std::vector<CompactFrameID>
-  * frame_chain) const
+  * frame_chain, ShardLock * shards) const
 {
   if (frame_chain) {
     frame_chain->clear();
@@ -338,14 +1220,24 @@ tf2::TF2Error BufferCore::walkToTopParent(
     return tf2::TF2Error::TF2_NO_ERROR;
   }
 
+  // Frames in trees that never touched cannot be connected at any time
+  if (neverConnected(target_id, source_id)) {
+    createConnectivityErrorString(source_id, target_id, error_string);
+    return tf2::TF2Error::TF2_CONNECTIVITY_ERROR;
+  }
+
   // If getting the latest get the latest common time
   if (time == TimePointZero) {
-    tf2::TF2Error retval = getLatestCommonTime(target_id, source_id, time, error_string);
+    tf2::TF2Error retval = getLatestCommonTime(target_id, source_id, time, error_string, shards);
     if (retval != tf2::TF2Error::TF2_NO_ERROR) {
       return retval;
     }
   }
 
+  // Walks can stop where the chains of latest parents meet, unless a frame below that point
+  // changed parent and could lead elsewhere at this time
+  CompactFrameID meet = frame_chain ? 0 : chainsMeet(target_id, source_id);
+
   // Walk the tree to its root from the source frame, accumulating the transform
   CompactFrameID frame = source_id;
   CompactFrameID top_parent = frame;
@@ -353,10 +1245,21 @@ tf2::TF2Error BufferCore::walkToTopParent(
 
   TF2Error error_code = TF2Error::TF2_NO_ERROR;
   std::string extrapolation_error_string;
+  // Only describe errors when asked to, describing them allocates
+  std::string * extrapolation_error = error_string ? &extrapolation_error_string : nullptr;
   bool extrapolation_might_have_occurred = false;
 
   while (frame != 0) {
-    TimeCacheInterfacePtr cache = getFrame(frame);
+    if (frame == meet) {
+      top_parent = frame;
+      if (frame == target_id) {
+        f.finalize(TargetParentOfSource, time);
+        return tf2::TF2Error::TF2_NO_ERROR;
+      }
+      break;
+    }
+
+    TimeCacheInterfacePtr cache = getFrame(frame, shards);
     if (frame_chain) {
       frame_chain->push_back(frame);
     }
@@ -367,7 +1270,7 @@ tf2::TF2Error BufferCore::walkToTopParent(
       break;
     }
 
-    CompactFrameID parent = f.gather(cache, time, &extrapolation_error_string, &error_code);
+    CompactFrameID parent = f.gather(cache, time, extrapolation_error, &error_code);
     if (parent == 0) {
       // Just break out here... there may still be a path from source -> target
       top_parent = frame;
@@ -388,6 +1291,11 @@ tf2::TF2Error BufferCore::walkToTopParent(
 
     ++depth;
     if (depth > MAX_GRAPH_DEPTH) {
+      if (shards && !shards->coversAll()) {
+        // Describing the tree needs every shard
+        shards->miss();
+        return tf2::TF2Error::TF2_LOOKUP_ERROR;
+      }
       if (error_string) {
         std::stringstream ss;
         ss << "The tf tree is invalid because it contains a loop." << std::endl <<
@@ -404,7 +1312,7 @@ tf2::TF2Error BufferCore::walkToTopParent(
   std::vector<CompactFrameID> reverse_frame_chain;
 
   while (frame != top_parent) {
-    TimeCacheInterfacePtr cache = getFrame(frame);
+    TimeCacheInterfacePtr cache = getFrame(frame, shards);
     if (frame_chain) {
       reverse_frame_chain.push_back(frame);
     }
@@ -440,6 +1348,11 @@ tf2::TF2Error BufferCore::walkToTopParent(
 
     ++depth;
     if (depth > MAX_GRAPH_DEPTH) {
+      if (shards && !shards->coversAll()) {
+        // Describing the tree needs every shard
+        shards->miss();
+        return tf2::TF2Error::TF2_LOOKUP_ERROR;
+      }
       if (error_string) {
         std::stringstream ss;
         ss << "The tf tree is invalid because it contains a loop." << std::endl <<
@@ -450,6 +1363,11 @@ tf2::TF2Error BufferCore::walkToTopParent(
     }
   }
 
+  if (frame == meet && frame == source_id) {
+    f.finalize(SourceParentOfTarget, time);
+    return tf2::TF2Error::TF2_NO_ERROR;
+  }
+
   if (frame != top_parent) {
     if (extrapolation_might_have_occurred) {
       if (error_string) {
@@ -509,6 +1427,7 @@ struct TransformAccum
     TimeCacheInterfacePtr cache, TimePoint time,
     std::string * error_string, TF2Error * error_code)
   {
+    ++hops;
     if (!cache->getData(time, st, error_string, error_code)) {
       return 0;
     }
@@ -560,6 +1479,7 @@ struct TransformAccum
 
   TransformStorage st;
   TimePoint time;
+  uint32_t hops = 0;
   tf2::Quaternion source_to_top_quat;
   tf2::Vector3 source_to_top_vec;
   tf2::Quaternion target_to_top_quat;
@@ -569,14 +1489,39 @@ struct TransformAccum
   tf2::Vector3 result_vec;
 };
 
-geometry_msgs::msg::TransformStamped
-BufferCore::lookupTransform(
-  const std::string & target_frame, const std::string & source_frame,
-  const TimePoint & time) const
+namespace
+{
+
+// Throws the exception of a failed walk, if it failed
+void throwLookupError(tf2::TF2Error error, const std::string & error_string)
+{
+  switch (error) {
+    case tf2::TF2Error::TF2_NO_ERROR:
+      return;
+    case tf2::TF2Error::TF2_CONNECTIVITY_ERROR:
+      throw ConnectivityException(error_string);
+    case tf2::TF2Error::TF2_BACKWARD_EXTRAPOLATION_ERROR:
+      throw BackwardExtrapolationException(error_string);
+    case tf2::TF2Error::TF2_FORWARD_EXTRAPOLATION_ERROR:
+      throw ForwardExtrapolationException(error_string);
+    case tf2::TF2Error::TF2_NO_DATA_FOR_EXTRAPOLATION_ERROR:
+      throw NoDataForExtrapolationException(error_string);
+    case tf2::TF2Error::TF2_EXTRAPOLATION_ERROR:
+      throw ExtrapolationException(error_string);
+    case tf2::TF2Error::TF2_LOOKUP_ERROR:
+      throw LookupException(error_string);
+    default:
+      CONSOLE_BRIDGE_logError("Unknown error code: %d", error);
+      assert(0);
+  }
+}
+
+}  // namespace
+
+geometry_msgs::msg::TransformStamped transformToMsg(
+  const tf2::Transform & transform, TimePoint time,
+  const std::string & target_frame, const std::string & source_frame)
 {
-  tf2::Transform transform;
-  TimePoint time_out;
-  lookupTransformImpl(target_frame, source_frame, time, transform, time_out);
   geometry_msgs::msg::TransformStamped msg;
   msg.transform.translation.x = transform.getOrigin().x();
   msg.transform.translation.y = transform.getOrigin().y();
@@ -586,9 +1531,9 @@ BufferCore::lookupTransform(
   msg.transform.rotation.z = transform.getRotation().z();
   msg.transform.rotation.w = transform.getRotation().w();
   std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
-    time_out.time_since_epoch());
+    time.time_since_epoch());
   std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(
-    time_out.time_since_epoch());
+    time.time_since_epoch());
   msg.header.stamp.sec = static_cast<int32_t>(s.count());
   msg.header.stamp.nanosec = static_cast<uint32_t>(ns.count() % 1000000000ull);
   msg.header.frame_id = target_frame;
@@ -597,6 +1542,29 @@ BufferCore::lookupTransform(
   return msg;
 }
 
+geometry_msgs::msg::TransformStamped
+BufferCore::lookupTransform(
+  const std::string & target_frame, const std::string & source_frame,
+  const TimePoint & time) const
+{
+  tf2::Transform transform;
+  TimePoint time_out;
+  lookupTransformImpl(target_frame, source_frame, time, transform, time_out);
+  return transformToMsg(transform, time_out, target_frame, source_frame);
+}
+
+geometry_msgs::msg::TransformStamped
+BufferCore::lookupTransform(
+  const std::string & target_frame, const std::string & source_frame,
+  const TimePoint & time, bool & predicted) const
+{
+  // Every cache lookup runs on this thread, so the thread local counter tells them apart
+  uint64_t predictions = TimeCache::getThreadPredictions();
+  geometry_msgs::msg::TransformStamped msg = lookupTransform(target_frame, source_frame, time);
+  predicted = TimeCache::getThreadPredictions() != predictions;
+  return msg;
+}
+
 geometry_msgs::msg::TransformStamped
 BufferCore::lookupTransform(
   const std::string & target_frame, const TimePoint & target_time,
@@ -608,24 +1576,7 @@ BufferCore::lookupTransform(
   lookupTransformImpl(
     target_frame, target_time, source_frame, source_time,
     fixed_frame, transform, time_out);
-  geometry_msgs::msg::TransformStamped msg;
-  msg.transform.translation.x = transform.getOrigin().x();
-  msg.transform.translation.y = transform.getOrigin().y();
-  msg.transform.translation.z = transform.getOrigin().z();
-  msg.transform.rotation.x = transform.getRotation().x();
-  msg.transform.rotation.y = transform.getRotation().y();
-  msg.transform.rotation.z = transform.getRotation().z();
-  msg.transform.rotation.w = transform.getRotation().w();
-  std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
-    time_out.time_since_epoch());
-  std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(
-    time_out.time_since_epoch());
-  msg.header.stamp.sec = static_cast<int32_t>(s.count());
-  msg.header.stamp.nanosec = static_cast<uint32_t>(ns.count() % 1000000000ull);
-  msg.header.frame_id = target_frame;
-  msg.child_frame_id = source_frame;
-
-  return msg;
+  return transformToMsg(transform, time_out, target_frame, source_frame);
 }
 
 void BufferCore::lookupTransformImpl(
@@ -634,13 +1585,18 @@ void BufferCore::lookupTransformImpl(
   const TimePoint & time, tf2::Transform & transform,
   TimePoint & time_out) const
 {
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  TF2_TRACEPOINT(
+    lookup_transform_entry, this, target_frame.c_str(), source_frame.c_str(),
+    time.time_since_epoch().count());
+  BufferCoreStatisticsCollector * statistics = activeStatistics();
+  ShardLock shards(*this, statistics, LockKind::Query);
 
   if (target_frame == source_frame) {
     transform.setIdentity();
 
     if (time == TimePointZero) {
       CompactFrameID target_id = lookupFrameNumber(target_frame);
+      shards.acquire(shardBit(target_id));
       TimeCacheInterfacePtr cache = getFrame(target_id);
       if (cache) {
         time_out = cache->getLatestTimestamp();
@@ -650,6 +1606,7 @@ void BufferCore::lookupTransformImpl(
     } else {
       time_out = time;
     }
+    TF2_TRACEPOINT(lookup_transform_exit, this, static_cast<int>(tf2::TF2Error::TF2_NO_ERROR));
     return;
   }
 
@@ -659,32 +1616,210 @@ void BufferCore::lookupTransformImpl(
 
   std::string error_string;
   TransformAccum accum;
-  tf2::TF2Error retval = walkToTopParent(accum, time, target_id, source_id, &error_string, nullptr);
-  if (retval != tf2::TF2Error::TF2_NO_ERROR) {
-    switch (retval) {
-      case tf2::TF2Error::TF2_CONNECTIVITY_ERROR:
-        throw ConnectivityException(error_string);
-      case tf2::TF2Error::TF2_BACKWARD_EXTRAPOLATION_ERROR:
-        throw BackwardExtrapolationException(error_string);
-      case tf2::TF2Error::TF2_FORWARD_EXTRAPOLATION_ERROR:
-        throw ForwardExtrapolationException(error_string);
-      case tf2::TF2Error::TF2_NO_DATA_FOR_EXTRAPOLATION_ERROR:
-        throw NoDataForExtrapolationException(error_string);
-      case tf2::TF2Error::TF2_EXTRAPOLATION_ERROR:
-        throw ExtrapolationException(error_string);
-      case tf2::TF2Error::TF2_LOOKUP_ERROR:
-        throw LookupException(error_string);
-      default:
-        CONSOLE_BRIDGE_logError("Unknown error code: %d", retval);
-        assert(0);
-    }
-  }
+  uint64_t search_steps = statistics ? TimeCache::getThreadSearchSteps() : 0;
+  tf2::TF2Error retval = withChainShards(
+    shards, target_id, source_id, [&]() {
+      accum = TransformAccum();
+      return walkToTopParent(accum, time, target_id, source_id, &error_string, nullptr, &shards);
+    });
+  if (statistics) {
+    statistics->chain_depth.record(accum.hops);
+    statistics->cache_search_steps.record(TimeCache::getThreadSearchSteps() - search_steps);
+    recordQueryResult(statistics, retval);
+  }
+  TF2_TRACEPOINT(lookup_transform_exit, this, static_cast<int>(retval));
+  throwLookupError(retval, error_string);
 
   time_out = accum.time;
   transform.setOrigin(accum.result_vec);
   transform.setRotation(accum.result_quat);
 }
 
+TF2Error BufferCore::lookupTransform(
+  const std::string & target_frame, const std::string & source_frame,
+  const TimePoint & time, tf2::Transform & transform, TimePoint & time_out,
+  bool blocking) const noexcept
+{
+  TF2_TRACEPOINT(
+    lookup_transform_entry, this, target_frame.c_str(), source_frame.c_str(),
+    time.time_since_epoch().count());
+  BufferCoreStatisticsCollector * statistics = activeStatistics();
+  ShardLock shards(*this, statistics, LockKind::Query, blocking);
+  if (!shards.owns_lock()) {
+    TF2_TRACEPOINT(lookup_transform_exit, this, static_cast<int>(TF2Error::TF2_TIMEOUT_ERROR));
+    return TF2Error::TF2_TIMEOUT_ERROR;
+  }
+
+  TF2Error retval = TF2Error::TF2_NO_ERROR;
+  CompactFrameID target_id = 0;
+  CompactFrameID source_id = 0;
+  if (target_frame.empty() || source_frame.empty() ||
+    startsWithSlash(target_frame) || startsWithSlash(source_frame))
+  {
+    retval = TF2Error::TF2_INVALID_ARGUMENT_ERROR;
+  } else {
+    target_id = lookupFrameNumber(target_frame);
+    source_id = lookupFrameNumber(source_frame);
+    if (target_frame != source_frame && (target_id == 0 || source_id == 0)) {
+      retval = TF2Error::TF2_LOOKUP_ERROR;
+    }
+  }
+
+  if (retval == TF2Error::TF2_NO_ERROR) {
+    TransformAccum accum;
+    uint64_t search_steps = statistics ? TimeCache::getThreadSearchSteps() : 0;
+    if (target_frame == source_frame) {
+      // Lookups between a frame and itself succeed even if the frame does not exist yet
+      if (shards.acquire(shardBit(target_id))) {
+        TimeCacheInterfacePtr cache = getFrame(target_id);
+        accum.time = time == TimePointZero && cache ? cache->getLatestTimestamp() : time;
+      } else {
+        retval = TF2Error::TF2_TIMEOUT_ERROR;
+      }
+    } else {
+      retval = withChainShards(
+        shards, target_id, source_id, [&]() {
+          accum = TransformAccum();
+          return walkToTopParent(accum, time, target_id, source_id, nullptr, nullptr, &shards);
+        });
+    }
+    if (statistics) {
+      statistics->chain_depth.record(accum.hops);
+      statistics->cache_search_steps.record(TimeCache::getThreadSearchSteps() - search_steps);
+    }
+    if (retval == TF2Error::TF2_NO_ERROR) {
+      time_out = accum.time;
+      transform.setOrigin(accum.result_vec);
+      transform.setRotation(accum.result_quat);
+    }
+  }
+  if (statistics) {
+    recordQueryResult(statistics, retval);
+  }
+  TF2_TRACEPOINT(lookup_transform_exit, this, static_cast<int>(retval));
+  return retval;
+}
+
+// Gathers every link at the end of an averaging interval, and again at its start
+struct VelocityAccum
+{
+  CompactFrameID gather(
+    TimeCacheInterfacePtr cache, TimePoint time,
+    std::string * error_string, TF2Error * error_code)
+  {
+    CompactFrameID parent = end.gather(cache, time, error_string, error_code);
+    if (parent == 0) {
+      return 0;
+    }
+    CompactFrameID start_parent = start.gather(cache, start_time, error_string, error_code);
+    if (start_parent != parent) {
+      if (start_parent != 0) {
+        *error_code = TF2Error::TF2_LOOKUP_ERROR;
+        if (error_string) {
+          *error_string = "A frame changed its parent within the averaging interval";
+        }
+      }
+      return 0;
+    }
+    return parent;
+  }
+
+  void accum(bool source)
+  {
+    start.accum(source);
+    end.accum(source);
+  }
+
+  void finalize(WalkEnding ending, TimePoint _time)
+  {
+    start.finalize(ending, start_time);
+    end.finalize(ending, _time);
+  }
+
+  TimePoint start_time;
+  TransformAccum start;
+  TransformAccum end;
+};
+
+geometry_msgs::msg::TwistStamped BufferCore::lookupVelocity(
+  const std::string & tracking_frame, const std::string & observation_frame,
+  const TimePoint & time, const tf2::Duration & averaging_interval) const
+{
+  if (averaging_interval <= tf2::Duration::zero()) {
+    throw tf2::InvalidArgumentException("lookupVelocity averaging_interval must be positive");
+  }
+  BufferCoreStatisticsCollector * statistics = activeStatistics();
+  ShardLock shards(*this, statistics, LockKind::Query);
+
+  CompactFrameID tracking_id =
+    validateFrameId("lookupVelocity argument tracking_frame", tracking_frame);
+  CompactFrameID observation_id =
+    validateFrameId("lookupVelocity argument observation_frame", observation_frame);
+
+  std::string error_string;
+  TimePoint start_time;
+  TimePoint end_time;
+  VelocityAccum accum;
+  bool walked = false;
+  uint64_t search_steps = statistics ? TimeCache::getThreadSearchSteps() : 0;
+  tf2::TF2Error retval = withChainShards(
+    shards, observation_id, tracking_id, [&]() {
+      TimePoint latest_time;
+      tf2::TF2Error result = getLatestCommonTime(
+        observation_id, tracking_id, latest_time, &error_string, &shards);
+      if (result != tf2::TF2Error::TF2_NO_ERROR) {
+        return result;
+      }
+      // Zero is the latest common time of frames that only have static transforms
+      TimePoint target_time = time == TimePointZero ? latest_time : time;
+      end_time = target_time + averaging_interval / 2;
+      if (latest_time != TimePointZero && end_time > latest_time) {
+        end_time = latest_time;
+      }
+      start_time = end_time - averaging_interval;
+      accum = VelocityAccum();
+      accum.start_time = start_time;
+      walked = true;
+      return walkToTopParent(
+        accum, end_time, observation_id, tracking_id, &error_string, nullptr, &shards);
+    });
+  if (statistics) {
+    if (walked) {
+      statistics->chain_depth.record(accum.end.hops);
+      statistics->cache_search_steps.record(TimeCache::getThreadSearchSteps() - search_steps);
+    }
+    recordQueryResult(statistics, retval);
+  }
+  throwLookupError(retval, error_string);
+
+  const double dt = std::chrono::duration<double>(end_time - start_time).count();
+  tf2::Vector3 linear = (accum.end.result_vec - accum.start.result_vec) / dt;
+
+  // The rotation from the start to the end of the interval, in the observation frame
+  tf2::Quaternion delta = accum.end.result_quat * accum.start.result_quat.inverse();
+  if (delta.w() < 0.0) {
+    delta = delta * -1.0;
+  }
+  tf2::Vector3 angular = delta.getAxis() * (delta.getAngle() / dt);
+
+  geometry_msgs::msg::TwistStamped msg;
+  msg.twist.linear.x = linear.x();
+  msg.twist.linear.y = linear.y();
+  msg.twist.linear.z = linear.z();
+  msg.twist.angular.x = angular.x();
+  msg.twist.angular.y = angular.y();
+  msg.twist.angular.z = angular.z();
+  TimePoint stamp = start_time + (end_time - start_time) / 2;
+  std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    stamp.time_since_epoch());
+  std::chrono::seconds sec = std::chrono::duration_cast<std::chrono::seconds>(
+    stamp.time_since_epoch());
+  msg.header.stamp.sec = static_cast<int32_t>(sec.count());
+  msg.header.stamp.nanosec = static_cast<uint32_t>(ns.count() % 1000000000ull);
+  msg.header.frame_id = observation_frame;
+  return msg;
+}
+
 void BufferCore::lookupTransformImpl(
   const std::string & target_frame,
   const TimePoint & target_time,
@@ -693,16 +1828,50 @@ void BufferCore::lookupTransformImpl(
   const std::string & fixed_frame, tf2::Transform & transform,
   TimePoint & time_out) const
 {
-  validateFrameId("lookupTransform argument target_frame", target_frame);
-  validateFrameId("lookupTransform argument source_frame", source_frame);
-  validateFrameId("lookupTransform argument fixed_frame", fixed_frame);
-
-  tf2::Transform tf1, tf2;
+  TF2_TRACEPOINT(
+    lookup_transform_entry, this, target_frame.c_str(), source_frame.c_str(),
+    target_time.time_since_epoch().count());
+  BufferCoreStatisticsCollector * statistics = activeStatistics();
+  // Both halves see the same buffer, and each frame is resolved once
+  ShardLock shards(*this, statistics, LockKind::Query);
+  CompactFrameID target_id = validateFrameId("lookupTransform argument target_frame", target_frame);
+  CompactFrameID source_id = validateFrameId("lookupTransform argument source_frame", source_frame);
+  CompactFrameID fixed_id = validateFrameId("lookupTransform argument fixed_frame", fixed_frame);
 
-  lookupTransformImpl(fixed_frame, source_frame, source_time, tf1, time_out);
-  lookupTransformImpl(target_frame, fixed_frame, target_time, tf2, time_out);
+  std::string error_string;
+  TransformAccum source_accum;
+  TransformAccum target_accum;
+  uint64_t search_steps = statistics ? TimeCache::getThreadSearchSteps() : 0;
+  tf2::TF2Error retval = withChainShards(
+    shards, target_id, source_id, [&]() {
+      source_accum = TransformAccum();
+      target_accum = TransformAccum();
+      tf2::TF2Error error = walkToTopParent(
+        source_accum, source_time, fixed_id, source_id, &error_string, nullptr, &shards);
+      if (error != tf2::TF2Error::TF2_NO_ERROR) {
+        return error;
+      }
+      return walkToTopParent(
+        target_accum, target_time, target_id, fixed_id, &error_string, nullptr, &shards);
+    }, fixed_id);
+  if (retval == tf2::TF2Error::TF2_NO_ERROR && target_id == fixed_id &&
+    target_time == TimePointZero)
+  {
+    // Like lookups between a frame and itself, report the latest time of the frame
+    TimeCacheInterfacePtr cache = getFrame(target_id, &shards);
+    target_accum.time = cache ? cache->getLatestTimestamp() : target_time;
+  }
+  if (statistics) {
+    statistics->chain_depth.record(source_accum.hops + target_accum.hops);
+    statistics->cache_search_steps.record(TimeCache::getThreadSearchSteps() - search_steps);
+    recordQueryResult(statistics, retval);
+  }
+  TF2_TRACEPOINT(lookup_transform_exit, this, static_cast<int>(retval));
+  throwLookupError(retval, error_string);
 
-  transform = tf2 * tf1;
+  time_out = target_accum.time;
+  transform = tf2::Transform(target_accum.result_quat, target_accum.result_vec) *
+    tf2::Transform(source_accum.result_quat, source_accum.result_vec);
 }
 
 struct CanTransformAccum
@@ -711,6 +1880,7 @@ struct CanTransformAccum
     TimeCacheInterfacePtr cache, TimePoint time,
     std::string * error_string, TF2Error * error_code)
   {
+    ++hops;
     return cache->getParent(time, error_string, error_code);
   }
 
@@ -726,33 +1896,82 @@ struct CanTransformAccum
   }
 
   TransformStorage st;
+  uint32_t hops = 0;
 };
 
-bool BufferCore::canTransformInternal(
-  CompactFrameID target_id, CompactFrameID source_id,
+template<typename F>
+tf2::TF2Error BufferCore::walkChain(
+  F & accum, CompactFrameID target_id, CompactFrameID source_id,
   const TimePoint & time, std::string * error_msg) const
 {
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  BufferCoreStatisticsCollector * statistics = activeStatistics();
+  ShardLock shards(*this, statistics, LockKind::Query);
   if (target_id == 0 || source_id == 0) {
     if (error_msg) {
       *error_msg = "Source or target frame is not yet defined";
     }
-    return false;
+    return tf2::TF2Error::TF2_LOOKUP_ERROR;
   }
 
   if (target_id == source_id) {
-    return true;
+    // Like lookupTransform(), report the latest time of the frame for time 0
+    TimePoint time_out = time;
+    if (time == TimePointZero) {
+      shards.acquire(shardBit(target_id));
+      TimeCacheInterfacePtr cache = getFrame(target_id);
+      if (cache) {
+        time_out = cache->getLatestTimestamp();
+      }
+    }
+    accum.finalize(Identity, time_out);
+    return tf2::TF2Error::TF2_NO_ERROR;
+  }
+
+  // Reject frames of separate trees before gathering the shards of their chains
+  if (neverConnected(target_id, source_id)) {
+    createConnectivityErrorString(source_id, target_id, error_msg);
+    if (statistics) {
+      recordQueryResult(statistics, tf2::TF2Error::TF2_CONNECTIVITY_ERROR);
+    }
+    return tf2::TF2Error::TF2_CONNECTIVITY_ERROR;
+  }
+
+  uint64_t search_steps = statistics ? TimeCache::getThreadSearchSteps() : 0;
+  tf2::TF2Error retval = withChainShards(
+    shards, target_id, source_id, [&]() {
+      accum = F();
+      return walkToTopParent(accum, time, target_id, source_id, error_msg, nullptr, &shards);
+    });
+  if (statistics) {
+    statistics->chain_depth.record(accum.hops);
+    statistics->cache_search_steps.record(TimeCache::getThreadSearchSteps() - search_steps);
+    recordQueryResult(statistics, retval);
   }
 
+  return retval;
+}
+
+bool BufferCore::canTransformInternal(
+  CompactFrameID target_id, CompactFrameID source_id,
+  const TimePoint & time, std::string * error_msg) const
+{
   CanTransformAccum accum;
-  if (walkToTopParent(
-      accum, time, target_id, source_id,
-      error_msg, nullptr) == tf2::TF2Error::TF2_NO_ERROR)
-  {
-    return true;
+  return walkChain(accum, target_id, source_id, time, error_msg) == tf2::TF2Error::TF2_NO_ERROR;
+}
+
+bool BufferCore::lookupTransformInternal(
+  CompactFrameID target_id, CompactFrameID source_id, const TimePoint & time,
+  tf2::Transform & transform, TimePoint & time_out) const
+{
+  TransformAccum accum;
+  if (walkChain(accum, target_id, source_id, time, nullptr) != tf2::TF2Error::TF2_NO_ERROR) {
+    return false;
   }
 
-  return false;
+  transform.setOrigin(accum.result_vec);
+  transform.setRotation(accum.result_quat);
+  time_out = accum.time;
+  return true;
 }
 
 bool BufferCore::canTransform(
@@ -799,9 +2018,102 @@ bool BufferCore::canTransform(
     return false;
   }
 
-  return
-    canTransformInternal(target_id, fixed_id, target_time, error_msg) &&
-    canTransformInternal(fixed_id, source_id, source_time, error_msg);
+  // Both halves are tested under one lock, like lookupTransform() does
+  BufferCoreStatisticsCollector * statistics = activeStatistics();
+  ShardLock shards(*this, statistics, LockKind::Query);
+  CanTransformAccum source_accum;
+  CanTransformAccum target_accum;
+  uint64_t search_steps = statistics ? TimeCache::getThreadSearchSteps() : 0;
+  tf2::TF2Error retval = withChainShards(
+    shards, target_id, source_id, [&]() {
+      source_accum = CanTransformAccum();
+      target_accum = CanTransformAccum();
+      tf2::TF2Error error = walkToTopParent(
+        target_accum, target_time, target_id, fixed_id, error_msg, nullptr, &shards);
+      if (error != tf2::TF2Error::TF2_NO_ERROR) {
+        return error;
+      }
+      return walkToTopParent(
+        source_accum, source_time, fixed_id, source_id, error_msg, nullptr, &shards);
+    }, fixed_id);
+  if (statistics) {
+    statistics->chain_depth.record(source_accum.hops + target_accum.hops);
+    statistics->cache_search_steps.record(TimeCache::getThreadSearchSteps() - search_steps);
+    recordQueryResult(statistics, retval);
+  }
+
+  return retval == tf2::TF2Error::TF2_NO_ERROR;
+}
+
+bool BufferCore::canTransformAll(
+  const std::vector<std::string> & target_frames, const std::string & source_frame,
+  const TimePoint * times, size_t time_count, std::string * error_msg) const
+{
+  BufferCoreStatisticsCollector * statistics = activeStatistics();
+  ShardLock shards(*this, statistics, LockKind::Query);
+
+  // Resolve every frame first, so that all walks run with the same shards held
+  CompactFrameID source_id = 0;
+  std::vector<CompactFrameID> target_ids(target_frames.size(), 0);
+  uint64_t needed = shards_.size() == 1 ? 1 : 0;
+  for (size_t i = 0; i < target_frames.size(); ++i) {
+    // Like canTransform(), transforms from a frame to itself are possible even if it is unknown
+    if (target_frames[i] == source_frame) {
+      continue;
+    }
+    if (source_id == 0) {
+      source_id = validateFrameId("canTransform argument source_frame", source_frame, error_msg);
+      if (source_id == 0) {
+        return false;
+      }
+      needed |= shards_.size() == 1 ? 0 : pathShards(source_id);
+    }
+    target_ids[i] = validateFrameId(
+      "canTransform argument target_frame", target_frames[i], error_msg);
+    if (target_ids[i] == 0) {
+      return false;
+    }
+    if (neverConnected(target_ids[i], source_id)) {
+      createConnectivityErrorString(source_id, target_ids[i], error_msg);
+      if (statistics) {
+        recordQueryResult(statistics, tf2::TF2Error::TF2_CONNECTIVITY_ERROR);
+      }
+      return false;
+    }
+    needed |= shards_.size() == 1 ? 0 : pathShards(target_ids[i]);
+  }
+  if (source_id == 0) {
+    return true;
+  }
+
+  uint32_t hops = 0;
+  uint64_t search_steps = statistics ? TimeCache::getThreadSearchSteps() : 0;
+  tf2::TF2Error retval = withShards(
+    shards, needed, [&]() {
+      hops = 0;
+      for (CompactFrameID target_id : target_ids) {
+        if (target_id == 0) {
+          continue;
+        }
+        for (size_t i = 0; i < time_count; ++i) {
+          CanTransformAccum accum;
+          tf2::TF2Error error = walkToTopParent(
+            accum, times[i], target_id, source_id, error_msg, nullptr, &shards);
+          hops += accum.hops;
+          if (error != tf2::TF2Error::TF2_NO_ERROR) {
+            return error;
+          }
+        }
+      }
+      return tf2::TF2Error::TF2_NO_ERROR;
+    });
+  if (statistics) {
+    statistics->chain_depth.record(hops);
+    statistics->cache_search_steps.record(TimeCache::getThreadSearchSteps() - search_steps);
+    recordQueryResult(statistics, retval);
+  }
+
+  return retval == tf2::TF2Error::TF2_NO_ERROR;
 }
 
 tf2::TimeCacheInterfacePtr BufferCore::getFrame(CompactFrameID frame_id) const
@@ -813,31 +2125,45 @@ tf2::TimeCacheInterfacePtr BufferCore::getFrame(CompactFrameID frame_id) const
   }
 }
 
-CompactFrameID BufferCore::lookupFrameNumber(const std::string & frameid_str) const
+tf2::TimeCacheInterfacePtr BufferCore::getFrame(CompactFrameID frame_id, ShardLock * shards) const
+{
+  if (frame_id >= frames_.size()) {
+    return TimeCacheInterfacePtr();
+  }
+  const TimeCacheInterfacePtr & frame = frames_[frame_id];
+  if (frame && shards && !shards->covers(frame_id)) {
+    shards->miss();
+    return TimeCacheInterfacePtr();
+  }
+  return frame;
+}
+
+CompactFrameID BufferCore::lookupFrameNumber(std::string_view frameid_str) const
 {
-  CompactFrameID retval;
   M_StringToCompactFrameID::const_iterator map_it = frameIDs_.find(frameid_str);
   if (map_it == frameIDs_.end()) {
-    retval = CompactFrameID(0);
-  } else {
-    retval = map_it->second;
+    return CompactFrameID(0);
   }
-  return retval;
+  return map_it->second;
 }
 
-CompactFrameID BufferCore::lookupOrInsertFrameNumber(const std::string & frameid_str)
+CompactFrameID BufferCore::lookupOrInsertFrameNumber(std::string_view frameid_str)
 {
-  CompactFrameID retval = 0;
-  M_StringToCompactFrameID::iterator map_it = frameIDs_.find(frameid_str);
-  if (map_it == frameIDs_.end()) {
-    retval = CompactFrameID(frames_.size());
-    // Just a place holder for iteration
-    frames_.push_back(TimeCacheInterfacePtr());
-    frameIDs_[frameid_str] = retval;
-    frameIDs_reverse_.push_back(frameid_str);
-  } else {
-    retval = frameIDs_[frameid_str];
+  M_StringToCompactFrameID::const_iterator map_it = frameIDs_.find(frameid_str);
+  if (map_it != frameIDs_.end()) {
+    return map_it->second;
   }
+  CompactFrameID retval = CompactFrameID(frames_.size());
+  // Just a place holder for iteration
+  frames_.push_back(TimeCacheInterfacePtr());
+  frame_authority_.push_back(0);
+  frame_prediction_horizon_.push_back(tf2::Duration::zero());
+  frameIDs_reverse_.emplace_back(frameid_str);
+  frameIDs_[frameIDs_reverse_.back()] = retval;
+  auto shard_root = shard_roots_.find(frameIDs_reverse_.back());
+  frame_shard_.push_back(shard_root == shard_roots_.end() ? 0 : shard_root->second);
+  frame_links_.emplace_back();
+  frame_links_.back().root = retval;
   return retval;
 }
 
@@ -859,10 +2185,11 @@ void BufferCore::createConnectivityErrorString(
   if (!out) {
     return;
   }
-  *out = std::string(
-    "Could not find a connection between '" + lookupFrameString(target_frame) + "' and '" +
-    lookupFrameString(source_frame) + "' because they are not part of the same tree." +
-    "Tf has two or more unconnected trees.");
+  // Assembled in place, so that callers that pass the same string again do not allocate
+  out->assign("Could not find a connection between '");
+  out->append(lookupFrameString(target_frame)).append("' and '");
+  out->append(lookupFrameString(source_frame));
+  out->append("' because they are not part of the same tree.Tf has two or more unconnected trees.");
 }
 
 std::vector<std::string> BufferCore::getAllFrameNames() const
@@ -874,7 +2201,7 @@ std::vector<std::string> BufferCore::getAllFrameNames() const
 
 std::string BufferCore::allFramesAsString() const
 {
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  std::unique_lock<std::shared_mutex> lock(frame_mutex_);
   return this->allFramesAsStringNoLock();
 }
 
@@ -919,13 +2246,13 @@ struct TimeAndFrameIDFrameComparator
 
 tf2::TF2Error BufferCore::getLatestCommonTime(
   CompactFrameID target_id, CompactFrameID source_id,
-  TimePoint & time, std::string * error_string) const
+  TimePoint & time, std::string * error_string, ShardLock * shards) const
 {
   // Error if one of the frames don't exist.
   if (source_id == 0 || target_id == 0) {return tf2::TF2Error::TF2_LOOKUP_ERROR;}
 
   if (source_id == target_id) {
-    TimeCacheInterfacePtr cache = getFrame(source_id);
+    TimeCacheInterfacePtr cache = getFrame(source_id, shards);
     // Set time to latest timestamp of frameid in case of target and source frame id are the same
     if (cache) {
       time = cache->getLatestTimestamp();
@@ -935,7 +2262,36 @@ tf2::TF2Error BufferCore::getLatestCommonTime(
     return tf2::TF2Error::TF2_NO_ERROR;
   }
 
-  std::vector<P_TimeAndFrameID> lct_cache;
+  if (!latest_parents_loop_) {
+    // The chains of latest parents are known, climb the deeper one until they meet
+    if (frame_links_[source_id].root != frame_links_[target_id].root) {
+      createConnectivityErrorString(source_id, target_id, error_string);
+      return tf2::TF2Error::TF2_CONNECTIVITY_ERROR;
+    }
+    TimePoint common_time = TimePoint::max();
+    CompactFrameID source = source_id;
+    CompactFrameID target = target_id;
+    while (source != target) {
+      CompactFrameID & deeper =
+        frame_links_[source].depth >= frame_links_[target].depth ? source : target;
+      TimeCacheInterfacePtr cache = getFrame(deeper, shards);
+      if (!cache) {
+        // Only for a shard that is not held, the walk is repeated
+        return tf2::TF2Error::TF2_LOOKUP_ERROR;
+      }
+      TimePoint latest = cache->getLatestTimeAndParent().first;
+      if (latest != TimePointZero) {
+        common_time = std::min(latest, common_time);
+      }
+      deeper = frame_links_[deeper].parent;
+    }
+    time = common_time == TimePoint::max() ? TimePointZero : common_time;
+    return tf2::TF2Error::TF2_NO_ERROR;
+  }
+
+  // The latest parents form a loop, walk them as far as the loop allows
+  std::vector<P_TimeAndFrameID> & lct_cache = latestCommonTimeScratch();
+  lct_cache.clear();
 
   // Walk the tree to its root from the source frame, accumulating the list of parent/time as
   //  well as the latest time in the target is a direct parent
@@ -943,7 +2299,7 @@ tf2::TF2Error BufferCore::getLatestCommonTime(
   uint32_t depth = 0;
   TimePoint common_time = TimePoint::max();
   while (frame != 0) {
-    TimeCacheInterfacePtr cache = getFrame(frame);
+    TimeCacheInterfacePtr cache = getFrame(frame, shards);
 
     if (!cache) {
       // There will be no cache for the very root of the tree
@@ -976,6 +2332,11 @@ tf2::TF2Error BufferCore::getLatestCommonTime(
 
     ++depth;
     if (depth > MAX_GRAPH_DEPTH) {
+      if (shards && !shards->coversAll()) {
+        // Describing the tree needs every shard
+        shards->miss();
+        return tf2::TF2Error::TF2_LOOKUP_ERROR;
+      }
       if (error_string) {
         std::stringstream ss;
         ss << "The tf tree is invalid because it contains a loop." << std::endl <<
@@ -993,7 +2354,7 @@ tf2::TF2Error BufferCore::getLatestCommonTime(
   common_time = TimePoint::max();
   CompactFrameID common_parent = 0;
   while (true) {
-    TimeCacheInterfacePtr cache = getFrame(frame);
+    TimeCacheInterfacePtr cache = getFrame(frame, shards);
 
     if (!cache) {
       break;
@@ -1030,6 +2391,11 @@ tf2::TF2Error BufferCore::getLatestCommonTime(
 
     ++depth;
     if (depth > MAX_GRAPH_DEPTH) {
+      if (shards && !shards->coversAll()) {
+        // Describing the tree needs every shard
+        shards->miss();
+        return tf2::TF2Error::TF2_LOOKUP_ERROR;
+      }
       if (error_string) {
         std::stringstream ss;
         ss << "The tf tree is invalid because it contains a loop." << std::endl <<
@@ -1070,66 +2436,85 @@ tf2::TF2Error BufferCore::getLatestCommonTime(
 
 std::string BufferCore::allFramesAsYAML(TimePoint current_time) const
 {
-  std::stringstream mstream;
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  // Only copy ids and stamps under the locks, so that formatting a large tree does not stall
+  // lookups and inserts. Names and authorities are interned in deques and never change or move,
+  // so they are read through pointers once the locks are released.
+  struct FrameSummary
+  {
+    const std::string * name;
+    const std::string * parent;
+    const std::string * authority;
+    unsigned int list_length;
+    TimePoint latest;
+    TimePoint oldest;
+  };
+  std::vector<FrameSummary> summaries;
+  bool no_frames;
+  {
+    // The authority and the data of a frame change under its shard with frame_mutex_ shared
+    ShardLock shards(*this, nullptr, LockKind::Query);
+    shards.acquire(allShards());
+    no_frames = frames_.size() == 1;
+    summaries.reserve(frames_.size());
+
+    TransformStorage temp;
+    // one referenced for 0 is no frame
+    for (size_t counter = 1; counter < frames_.size(); counter++) {
+      CompactFrameID cfid = static_cast<CompactFrameID>(counter);
+      TimeCacheInterfacePtr cache = getFrame(cfid);
+      if (!cache) {
+        continue;
+      }
 
-  TransformStorage temp;
+      if (!cache->getData(TimePointZero, temp)) {
+        continue;
+      }
 
-  if (frames_.size() == 1) {
+      FrameSummary summary;
+      summary.name = &frameIDs_reverse_[cfid];
+      summary.parent = &frameIDs_reverse_[temp.frame_id_];
+      summary.authority = &authorities_[frame_authority_[cfid]];
+      summary.list_length = cache->getListLength();
+      summary.latest = cache->getLatestTimestamp();
+      summary.oldest = cache->getOldestTimestamp();
+      summaries.push_back(summary);
+    }
+  }
+
+  std::stringstream mstream;
+  if (no_frames) {
     mstream << "[]";
   }
 
   mstream.precision(3);
   mstream.setf(std::ios::fixed, std::ios::floatfield);
 
-  // one referenced for 0 is no frame
-  for (size_t counter = 1; counter < frames_.size(); counter++) {
-    CompactFrameID cfid = static_cast<CompactFrameID>(counter);
-    CompactFrameID frame_id_num;
-    TimeCacheInterfacePtr cache = getFrame(cfid);
-    if (!cache) {
-      continue;
-    }
-
-    if (!cache->getData(TimePointZero, temp)) {
-      continue;
-    }
-
-    frame_id_num = temp.frame_id_;
-
-    std::string authority = "no recorded authority";
-    std::map<CompactFrameID, std::string>::const_iterator it = frame_authority_.find(cfid);
-    if (it != frame_authority_.end()) {
-      authority = it->second;
-    }
-
-    tf2::Duration dur1 = cache->getLatestTimestamp() - cache->getOldestTimestamp();
+  for (const FrameSummary & summary : summaries) {
+    tf2::Duration dur1 = summary.latest - summary.oldest;
     tf2::Duration dur2 = tf2::Duration(std::chrono::microseconds(100));
 
     double rate;
     if (dur1 > dur2) {
-      rate = (cache->getListLength() * 1e9) / std::chrono::duration_cast<std::chrono::nanoseconds>(
+      rate = (summary.list_length * 1e9) / std::chrono::duration_cast<std::chrono::nanoseconds>(
         dur1).count();
     } else {
-      rate = (cache->getListLength() * 1e9) / std::chrono::duration_cast<std::chrono::nanoseconds>(
+      rate = (summary.list_length * 1e9) / std::chrono::duration_cast<std::chrono::nanoseconds>(
         dur2).count();
     }
 
     mstream << std::fixed;  // fixed point notation
     mstream.precision(3);  // 3 decimal places
-    mstream << frameIDs_reverse_[cfid] << ": " << std::endl;
-    mstream << "  parent: '" << frameIDs_reverse_[frame_id_num] << "'" << std::endl;
-    mstream << "  broadcaster: '" << authority << "'" << std::endl;
+    mstream << *summary.name << ": " << std::endl;
+    mstream << "  parent: '" << *summary.parent << "'" << std::endl;
+    mstream << "  broadcaster: '" << *summary.authority << "'" << std::endl;
     mstream << "  rate: " << rate << std::endl;
-    mstream << "  most_recent_transform: " << displayTimePoint(cache->getLatestTimestamp()) <<
-      std::endl;
-    mstream << "  oldest_transform: " << displayTimePoint(cache->getOldestTimestamp()) << std::endl;
+    mstream << "  most_recent_transform: " << displayTimePoint(summary.latest) << std::endl;
+    mstream << "  oldest_transform: " << displayTimePoint(summary.oldest) << std::endl;
     if (current_time != TimePointZero) {
       mstream << "  transform_delay: " <<
-        durationToSec(current_time - cache->getLatestTimestamp()) << std::endl;
+        durationToSec(current_time - summary.latest) << std::endl;
     }
-    mstream << "  buffer_length: " << durationToSec(
-      cache->getLatestTimestamp() - cache->getOldestTimestamp()) << std::endl;
+    mstream << "  buffer_length: " << durationToSec(summary.latest - summary.oldest) << std::endl;
   }
 
   return mstream.str();
@@ -1178,12 +2563,67 @@ TransformableRequestHandle BufferCore::addTransformableRequest(
     return 0;
   }
 
+  TransformableCallbacks callbacks;
+  callbacks.cb = cb;
+  return queueTransformableRequest(req, std::move(callbacks), target_frame, source_frame, time);
+}
+
+TransformableRequestHandle BufferCore::addTransformableRequest(
+  const TransformableTransformCallback & cb,
+  const std::string & target_frame,
+  const std::string & source_frame,
+  TimePoint time,
+  geometry_msgs::msg::TransformStamped & immediate_transform)
+{
+  tf2::Transform transform;
+  TimePoint time_out;
+
+  // shortcut if target == source, which like lookupTransform() works for unknown frames too
+  if (target_frame == source_frame) {
+    CompactFrameID frame_id = lookupFrameNumber(target_frame);
+    if (frame_id == 0 || !lookupTransformInternal(frame_id, frame_id, time, transform, time_out)) {
+      transform.setIdentity();
+      time_out = time;
+    }
+    immediate_transform = transformToMsg(transform, time_out, target_frame, source_frame);
+    return 0;
+  }
+
+  // Held across the check for the same reason as in the other overload
+  std::unique_lock<std::mutex> lock(transformable_requests_mutex_);
+
+  TransformableRequest req;
+  req.target_id = lookupFrameNumber(target_frame);
+  req.source_id = lookupFrameNumber(source_frame);
+  req.wants_transform = true;
+
+  // The walk that finds the request transformable also computes the transform
+  if (lookupTransformInternal(req.target_id, req.source_id, time, transform, time_out)) {
+    immediate_transform = transformToMsg(transform, time_out, target_frame, source_frame);
+    return 0;
+  }
+
+  TransformableCallbacks callbacks;
+  callbacks.transform_cb = cb;
+  return queueTransformableRequest(req, std::move(callbacks), target_frame, source_frame, time);
+}
+
+TransformableRequestHandle BufferCore::queueTransformableRequest(
+  TransformableRequest & req, TransformableCallbacks callbacks,
+  const std::string & target_frame, const std::string & source_frame, TimePoint time)
+{
   // Might not be transformable at all, ever (if it's too far in the past)
   if (req.target_id && req.source_id) {
     TimePoint latest_time;
     // TODO(anyone): This is incorrect, but better than nothing.  Really we want the latest time for
     // any of the frames
-    getLatestCommonTime(req.target_id, req.source_id, latest_time, 0);
+    {
+      ShardLock shards(*this, nullptr, LockKind::Query);
+      withChainShards(
+        shards, req.target_id, req.source_id, [&]() {
+          return getLatestCommonTime(req.target_id, req.source_id, latest_time, 0, &shards);
+        });
+    }
     if ((latest_time != TimePointZero) && (time + cache_time_ < latest_time)) {
       return 0xffffffffffffffffULL;
     }
@@ -1192,7 +2632,7 @@ TransformableRequestHandle BufferCore::addTransformableRequest(
   {
     std::unique_lock<std::mutex> lock(transformable_callbacks_mutex_);
     TransformableCallbackHandle handle = ++transformable_callbacks_counter_;
-    while (!transformable_callbacks_.insert(std::make_pair(handle, cb)).second) {
+    while (!transformable_callbacks_.emplace(handle, callbacks).second) {
       handle = ++transformable_callbacks_counter_;
     }
 
@@ -1231,12 +2671,77 @@ void BufferCore::cancelTransformableRequest(TransformableRequestHandle handle)
   }
 
   transformable_requests_.erase(remove_it, transformable_requests_.end());
+  tc_lock.unlock();
+  tr_lock.unlock();
+
+  // The request may have been satisfied already, with its callback not yet returned
+  transformable_dispatch_->cancel(handle);
+}
+
+void BufferCore::setTransformableCallbackExecutor(TransformableCallbackExecutor executor)
+{
+  std::unique_lock<std::mutex> lock(transformable_callbacks_mutex_);
+  transformable_callback_executor_ = std::move(executor);
+}
+
+void BufferCore::TransformableDispatch::run(
+  TransformableRequestHandle handle, const std::function<void()> & callback)
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (pending.erase(handle) == 0) {
+      return;
+    }
+    running[handle] = std::this_thread::get_id();
+  }
+
+  auto finish = [this, handle]() {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        running.erase(handle);
+      }
+      done.notify_all();
+    };
+  try {
+    callback();
+  } catch (...) {
+    finish();
+    throw;
+  }
+  finish();
+}
+
+void BufferCore::TransformableDispatch::cancel(TransformableRequestHandle handle)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  pending.erase(handle);
+  // A callback that cancels its own request must not wait for itself
+  done.wait(
+    lock, [this, handle]() {
+      auto it = running.find(handle);
+      return it == running.end() || it->second == std::this_thread::get_id();
+    });
+}
+
+void BufferCore::TransformableDispatch::close()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  pending.clear();
+  done.wait(
+    lock, [this]() {
+      for (const auto & kv : running) {
+        if (kv.second != std::this_thread::get_id()) {
+          return false;
+        }
+      }
+      return true;
+    });
 }
 
 // backwards compability for tf methods
 bool BufferCore::_frameExists(const std::string & frame_id_str) const
 {
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  std::shared_lock<std::shared_mutex> lock(frame_mutex_);
   return frameIDs_.count(frame_id_str) != 0;
 }
 
@@ -1244,7 +2749,7 @@ bool BufferCore::_getParent(
   const std::string & frame_id, TimePoint time,
   std::string & parent) const
 {
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  std::unique_lock<std::shared_mutex> lock(frame_mutex_);
   CompactFrameID frame_number = lookupFrameNumber(frame_id);
   TimeCacheInterfacePtr frame = getFrame(frame_number);
 
@@ -1265,7 +2770,7 @@ void BufferCore::_getFrameStrings(std::vector<std::string> & vec) const
 {
   vec.clear();
 
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  std::shared_lock<std::shared_mutex> lock(frame_mutex_);
 
   TransformStorage temp;
 
@@ -1274,9 +2779,38 @@ void BufferCore::_getFrameStrings(std::vector<std::string> & vec) const
   }
 }
 
+BufferCoreStatistics BufferCore::getStatistics() const
+{
+  return statistics_.snapshot();
+}
+
+void BufferCore::resetStatistics()
+{
+  statistics_.reset();
+}
+
+BufferCoreStatistics BufferCore::takeStatistics()
+{
+  return statistics_.take();
+}
+
 void BufferCore::testTransformableRequests()
 {
+  BufferCoreStatisticsCollector * statistics = activeStatistics();
+  std::chrono::steady_clock::time_point start;
+  if (statistics) {
+    start = std::chrono::steady_clock::now();
+  }
+
+  // Callbacks are only collected under the locks, and dispatched once they are released
+  std::vector<std::pair<TransformableRequestHandle, std::function<void()>>> satisfied;
+  TransformableCallbackExecutor executor;
+
   std::unique_lock<std::mutex> lock(transformable_requests_mutex_);
+  if (statistics) {
+    statistics->transformable_request_queue_length.record(transformable_requests_.size());
+  }
+  TF2_TRACEPOINT(transformable_requests_entry, this, transformable_requests_.size());
   V_TransformableRequest::iterator it = transformable_requests_.begin();
   while (it != transformable_requests_.end()) {
     TransformableRequest & req = *it;
@@ -1293,15 +2827,25 @@ void BufferCore::testTransformableRequests()
     TimePoint latest_time;
     bool do_cb = false;
     TransformableResult result = TransformAvailable;
+    tf2::Transform transform;
+    TimePoint time_out = req.time;
     // TODO(anyone): This is incorrect, but better than nothing. Really we want the latest time for
     // any of the frames
-    getLatestCommonTime(req.target_id, req.source_id, latest_time, 0);
+    {
+      ShardLock shards(*this, nullptr, LockKind::Query);
+      withChainShards(
+        shards, req.target_id, req.source_id, [&]() {
+          return getLatestCommonTime(req.target_id, req.source_id, latest_time, 0, &shards);
+        });
+    }
     if ((latest_time != TimePointZero) && (req.time + cache_time_ < latest_time)) {
       do_cb = true;
       result = TransformFailure;
-    } else if (canTransformInternal(req.target_id, req.source_id, req.time, 0)) {
-      do_cb = true;
-      result = TransformAvailable;
+    } else if (req.wants_transform) {
+      // The walk that proves the request transformable also computes its transform
+      do_cb = lookupTransformInternal(req.target_id, req.source_id, req.time, transform, time_out);
+    } else {
+      do_cb = canTransformInternal(req.target_id, req.source_id, req.time, 0);
     }
 
     if (do_cb) {
@@ -1309,11 +2853,32 @@ void BufferCore::testTransformableRequests()
         std::unique_lock<std::mutex> lock2(transformable_callbacks_mutex_);
         M_TransformableCallback::iterator it = transformable_callbacks_.find(req.cb_handle);
         if (it != transformable_callbacks_.end()) {
-          const TransformableCallback & cb = it->second;
-          cb(
-            req.request_handle, lookupFrameString(req.target_id), lookupFrameString(
-              req.source_id), req.time, result);
-          transformable_callbacks_.erase(req.cb_handle);
+          TransformableCallbacks callbacks = std::move(it->second);
+          transformable_callbacks_.erase(it);
+          TransformableRequestHandle handle = req.request_handle;
+          if (callbacks.transform_cb) {
+            if (result != TransformAvailable) {
+              transform.setIdentity();
+            }
+            satisfied.emplace_back(
+              handle, [cb = std::move(callbacks.transform_cb), handle, result,
+              msg = transformToMsg(
+                transform, time_out, lookupFrameString(req.target_id),
+                lookupFrameString(req.source_id))]() {
+                cb(handle, msg, result);
+              });
+          } else {
+            satisfied.emplace_back(
+              handle, [cb = std::move(callbacks.cb), handle, result, time = req.time,
+              target = lookupFrameString(req.target_id),
+              source = lookupFrameString(req.source_id)]() {
+                cb(handle, target, source, time, result);
+              });
+          }
+          // Registered before the request leaves the queue, so that cancelling it either finds
+          // the request or drops its callback
+          std::unique_lock<std::mutex> lock3(transformable_dispatch_->mutex);
+          transformable_dispatch_->pending.insert(handle);
         }
       }
 
@@ -1332,13 +2897,47 @@ void BufferCore::testTransformableRequests()
       ++it;
     }
   }
+
+  TF2_TRACEPOINT(transformable_requests_exit, this, transformable_requests_.size());
+  if (!satisfied.empty()) {
+    std::unique_lock<std::mutex> lock2(transformable_callbacks_mutex_);
+    executor = transformable_callback_executor_;
+  }
+  lock.unlock();
+  if (statistics) {
+    statistics->transformable_requests_ns.record(
+      elapsedNanoseconds(start, std::chrono::steady_clock::now()));
+  }
+
+  // Every callback gets its chance, the first exception is passed on afterwards
+  std::exception_ptr error;
+  for (auto & handle_and_callback : satisfied) {
+    auto task = [dispatch = transformable_dispatch_, handle = handle_and_callback.first,
+        callback = std::move(handle_and_callback.second)]() {
+        dispatch->run(handle, callback);
+      };
+    try {
+      if (executor) {
+        executor(std::move(task));
+      } else {
+        task();
+      }
+    } catch (...) {
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
 }
 
 std::string BufferCore::_allFramesAsDot(TimePoint current_time) const
 {
   std::stringstream mstream;
   mstream << "digraph G {" << std::endl;
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  std::unique_lock<std::shared_mutex> lock(frame_mutex_);
 
   TransformStorage temp;
 
@@ -1359,13 +2958,7 @@ std::string BufferCore::_allFramesAsDot(TimePoint current_time) const
     } else {
       frame_id_num = temp.frame_id_;
     }
-    std::string authority = "no recorded authority";
-    std::map<CompactFrameID,
-      std::string>::const_iterator it =
-      frame_authority_.find(static_cast<CompactFrameID>(counter));
-    if (it != frame_authority_.end()) {
-      authority = it->second;
-    }
+    const std::string & authority = authorities_[frame_authority_[counter]];
 
     tf2::Duration dur1 = counter_frame->getLatestTimestamp() - counter_frame->getOldestTimestamp();
     tf2::Duration dur2 = std::chrono::microseconds(100);
@@ -1449,7 +3042,7 @@ void BufferCore::_chainAsVector(
   output.clear();  // empty vector
 
   std::stringstream mstream;
-  std::unique_lock<std::mutex> lock(frame_mutex_);
+  std::unique_lock<std::shared_mutex> lock(frame_mutex_);
 
   TransformAccum accum;
 
@@ -1462,51 +3055,15 @@ void BufferCore::_chainAsVector(
   tf2::TF2Error retval = walkToTopParent(
     accum, source_time, fixed_id, source_id, &error_string,
     &source_frame_chain);
-  if (retval != tf2::TF2Error::TF2_NO_ERROR) {
-    switch (retval) {
-      case tf2::TF2Error::TF2_CONNECTIVITY_ERROR:
-        throw ConnectivityException(error_string);
-      case tf2::TF2Error::TF2_BACKWARD_EXTRAPOLATION_ERROR:
-        throw BackwardExtrapolationException(error_string);
-      case tf2::TF2Error::TF2_FORWARD_EXTRAPOLATION_ERROR:
-        throw ForwardExtrapolationException(error_string);
-      case tf2::TF2Error::TF2_NO_DATA_FOR_EXTRAPOLATION_ERROR:
-        throw NoDataForExtrapolationException(error_string);
-      case tf2::TF2Error::TF2_EXTRAPOLATION_ERROR:
-        throw ExtrapolationException(error_string);
-      case tf2::TF2Error::TF2_LOOKUP_ERROR:
-        throw LookupException(error_string);
-      default:
-        CONSOLE_BRIDGE_logError("Unknown error code: %d", retval);
-        assert(0);
-    }
-  }
+  throwLookupError(retval, error_string);
 
   if (source_time != target_time) {
     std::vector<CompactFrameID> target_frame_chain;
     retval = walkToTopParent(
       accum, target_time, target_id, fixed_id, &error_string,
       &target_frame_chain);
+    throwLookupError(retval, error_string);
 
-    if (retval != tf2::TF2Error::TF2_NO_ERROR) {
-      switch (retval) {
-        case tf2::TF2Error::TF2_CONNECTIVITY_ERROR:
-          throw ConnectivityException(error_string);
-        case tf2::TF2Error::TF2_BACKWARD_EXTRAPOLATION_ERROR:
-          throw BackwardExtrapolationException(error_string);
-        case tf2::TF2Error::TF2_FORWARD_EXTRAPOLATION_ERROR:
-          throw ForwardExtrapolationException(error_string);
-        case tf2::TF2Error::TF2_NO_DATA_FOR_EXTRAPOLATION_ERROR:
-          throw NoDataForExtrapolationException(error_string);
-        case tf2::TF2Error::TF2_EXTRAPOLATION_ERROR:
-          throw ExtrapolationException(error_string);
-        case tf2::TF2Error::TF2_LOOKUP_ERROR:
-          throw LookupException(error_string);
-        default:
-          CONSOLE_BRIDGE_logError("Unknown error code: %d", retval);
-          assert(0);
-      }
-    }
     size_t m = target_frame_chain.size();
     size_t n = source_frame_chain.size();
     while (m > 0u && n > 0u) {
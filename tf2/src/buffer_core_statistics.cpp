@@ -0,0 +1,210 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "tf2/buffer_core_statistics.h"
+
+namespace tf2
+{
+
+namespace
+{
+
+unsigned int highestBit(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return 63u - static_cast<unsigned int>(__builtin_clzll(value));
+#else
+  unsigned int bit = 0;
+  while (value >>= 1) {
+    ++bit;
+  }
+  return bit;
+#endif
+}
+
+}  // namespace
+
+double HistogramSnapshot::mean() const
+{
+  if (count == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(sum) / static_cast<double>(count);
+}
+
+uint64_t HistogramSnapshot::percentile(double p) const
+{
+  if (count == 0) {
+    return 0;
+  }
+  p = std::min(std::max(p, 0.0), 1.0);
+  uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count - 1)) + 1;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      return std::min(Histogram::bucketUpperBound(i), max);
+    }
+  }
+  return max;
+}
+
+Histogram::Histogram()
+{
+  reset();
+}
+
+size_t Histogram::bucketIndex(uint64_t value)
+{
+  if (value < SUB_BUCKETS) {
+    return static_cast<size_t>(value);
+  }
+  unsigned int exponent = highestBit(value);
+  if (exponent > MAX_EXPONENT) {
+    return BUCKET_COUNT - 1;
+  }
+  unsigned int shift = exponent - SUB_BUCKET_BITS;
+  size_t sub_bucket = static_cast<size_t>((value >> shift) & (SUB_BUCKETS - 1));
+  return SUB_BUCKETS + shift * SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t Histogram::bucketUpperBound(size_t index)
+{
+  if (index < SUB_BUCKETS) {
+    return index;
+  }
+  unsigned int shift = static_cast<unsigned int>((index - SUB_BUCKETS) / SUB_BUCKETS);
+  uint64_t sub_bucket = (index - SUB_BUCKETS) % SUB_BUCKETS;
+  uint64_t lower = (SUB_BUCKETS + sub_bucket) << shift;
+  return lower + ((uint64_t(1) << shift) - 1);
+}
+
+void Histogram::record(uint64_t value)
+{
+  buckets_[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  uint64_t current_max = max_.load(std::memory_order_relaxed);
+  while (value > current_max &&
+    !max_.compare_exchange_weak(current_max, value, std::memory_order_relaxed))
+  {
+  }
+}
+
+HistogramSnapshot Histogram::snapshot() const
+{
+  HistogramSnapshot snapshot;
+  snapshot.buckets.resize(BUCKET_COUNT);
+  for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+    snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    snapshot.count += snapshot.buckets[i];
+  }
+  // Derive the count from the buckets so that percentiles stay consistent
+  // with the snapshot even while other threads are recording.
+  snapshot.sum = sum_.load(std::memory_order_relaxed);
+  snapshot.max = max_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+void Histogram::reset()
+{
+  for (std::atomic<uint64_t> & bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+HistogramSnapshot Histogram::take()
+{
+  HistogramSnapshot snapshot;
+  snapshot.buckets.resize(BUCKET_COUNT);
+  for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+    snapshot.buckets[i] = buckets_[i].exchange(0, std::memory_order_relaxed);
+    snapshot.count += snapshot.buckets[i];
+  }
+  snapshot.sum = sum_.exchange(0, std::memory_order_relaxed);
+  snapshot.max = max_.exchange(0, std::memory_order_relaxed);
+  return snapshot;
+}
+
+BufferCoreStatistics BufferCoreStatisticsCollector::snapshot() const
+{
+  BufferCoreStatistics statistics;
+  statistics.queries = queries.load(std::memory_order_relaxed);
+  statistics.inserts = inserts.load(std::memory_order_relaxed);
+  statistics.old_data_rejections = old_data_rejections.load(std::memory_order_relaxed);
+  statistics.late_inserts = late_inserts.load(std::memory_order_relaxed);
+  statistics.lookup_failures = lookup_failures.load(std::memory_order_relaxed);
+  statistics.connectivity_failures = connectivity_failures.load(std::memory_order_relaxed);
+  statistics.extrapolation_failures = extrapolation_failures.load(std::memory_order_relaxed);
+  statistics.query_lock_wait_ns = query_lock_wait_ns.snapshot();
+  statistics.query_lock_hold_ns = query_lock_hold_ns.snapshot();
+  statistics.insert_lock_wait_ns = insert_lock_wait_ns.snapshot();
+  statistics.insert_lock_hold_ns = insert_lock_hold_ns.snapshot();
+  statistics.chain_depth = chain_depth.snapshot();
+  statistics.cache_search_steps = cache_search_steps.snapshot();
+  statistics.transformable_requests_ns = transformable_requests_ns.snapshot();
+  statistics.transformable_request_queue_length = transformable_request_queue_length.snapshot();
+  statistics.insert_lateness_ns = insert_lateness_ns.snapshot();
+  return statistics;
+}
+
+void BufferCoreStatisticsCollector::reset()
+{
+  queries.store(0, std::memory_order_relaxed);
+  inserts.store(0, std::memory_order_relaxed);
+  old_data_rejections.store(0, std::memory_order_relaxed);
+  late_inserts.store(0, std::memory_order_relaxed);
+  lookup_failures.store(0, std::memory_order_relaxed);
+  connectivity_failures.store(0, std::memory_order_relaxed);
+  extrapolation_failures.store(0, std::memory_order_relaxed);
+  query_lock_wait_ns.reset();
+  query_lock_hold_ns.reset();
+  insert_lock_wait_ns.reset();
+  insert_lock_hold_ns.reset();
+  chain_depth.reset();
+  cache_search_steps.reset();
+  transformable_requests_ns.reset();
+  transformable_request_queue_length.reset();
+  insert_lateness_ns.reset();
+}
+
+BufferCoreStatistics BufferCoreStatisticsCollector::take()
+{
+  BufferCoreStatistics statistics;
+  statistics.queries = queries.exchange(0, std::memory_order_relaxed);
+  statistics.inserts = inserts.exchange(0, std::memory_order_relaxed);
+  statistics.old_data_rejections = old_data_rejections.exchange(0, std::memory_order_relaxed);
+  statistics.late_inserts = late_inserts.exchange(0, std::memory_order_relaxed);
+  statistics.lookup_failures = lookup_failures.exchange(0, std::memory_order_relaxed);
+  statistics.connectivity_failures = connectivity_failures.exchange(0, std::memory_order_relaxed);
+  statistics.extrapolation_failures = extrapolation_failures.exchange(0, std::memory_order_relaxed);
+  statistics.query_lock_wait_ns = query_lock_wait_ns.take();
+  statistics.query_lock_hold_ns = query_lock_hold_ns.take();
+  statistics.insert_lock_wait_ns = insert_lock_wait_ns.take();
+  statistics.insert_lock_hold_ns = insert_lock_hold_ns.take();
+  statistics.chain_depth = chain_depth.take();
+  statistics.cache_search_steps = cache_search_steps.take();
+  statistics.transformable_requests_ns = transformable_requests_ns.take();
+  statistics.transformable_request_queue_length = transformable_request_queue_length.take();
+  statistics.insert_lateness_ns = insert_lateness_ns.take();
+  return statistics;
+}
+
+}  // namespace tf2
@@ -28,10 +28,15 @@
 
 /** \author Tully Foote */
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <iterator>
+#include <cstdint>
 #include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "tf2/time_cache.h"
 #include "tf2/exceptions.h"
@@ -58,8 +63,12 @@ TransformStorage::TransformStorage(
 {
 }
 
-TimeCache::TimeCache(tf2::Duration max_storage_time)
-: max_storage_time_(max_storage_time)
+template<typename StorageT>
+BasicTimeCache<StorageT>::BasicTimeCache(
+  tf2::Duration max_storage_time, std::pmr::memory_resource * resource)
+: storage_(resource),
+  reorder_(resource),
+  max_storage_time_(max_storage_time)
 {}
 
 // Avoid ODR collisions https://github.com/ros/geometry2/issues/175
@@ -108,10 +117,16 @@ void createExtrapolationException3(
     *error_str = ss.str();
   }
 }
+
+// Entries stepped over by findClosest on this thread, see getThreadSearchSteps
+thread_local uint64_t search_steps = 0;
+// Lookups answered by prediction on this thread, see getThreadPredictions
+thread_local uint64_t predictions = 0;
 }  // namespace cache
 
-uint8_t TimeCache::findClosest(
-  TransformStorage * & one, TransformStorage * & two,
+template<typename StorageT>
+uint8_t BasicTimeCache<StorageT>::findClosest(
+  const StorageT * & one, const StorageT * & two,
   TimePoint target_time, std::string * error_str, TF2Error * error_code)
 {
   if (error_code) {
@@ -133,28 +148,55 @@ uint8_t TimeCache::findClosest(
   }
 
   // One value stored
-  if (++storage_.begin() == storage_.end()) {
-    TransformStorage & ts = *storage_.begin();
+  if (reorder_.empty() && ++storage_.begin() == storage_.end()) {
+    const StorageT & ts = *storage_.begin();
     if (ts.stamp_ == target_time) {
       one = &ts;
       return 1;
+    } else if (target_time > ts.stamp_ && target_time - ts.stamp_ <= prediction_horizon_) {
+      // Nothing to estimate a velocity from, hold the only value
+      ++cache::predictions;
+      one = &ts;
+      return 1;
     } else {
       cache::createExtrapolationException1(target_time, ts.stamp_, error_str, error_code);
       return 0;
     }
   }
 
+  // Staged entries are all older than the latest one, but might be the earliest
+  const StorageT & earliest =
+    !reorder_.empty() && reorder_.rbegin()->stamp_ < storage_.back().stamp_ ?
+    *reorder_.rbegin() : storage_.back();
   TimePoint latest_time = (*storage_.begin()).stamp_;
-  TimePoint earliest_time = (*(storage_.rbegin())).stamp_;
+  TimePoint earliest_time = earliest.stamp_;
 
   if (target_time == latest_time) {
     one = &(*storage_.begin());
     return 1;
   } else if (target_time == earliest_time) {
-    one = &(*storage_.rbegin());
+    one = &earliest;
     return 1;
   } else {   // Catch cases that would require extrapolation
     if (target_time > latest_time) {
+      if (target_time - latest_time <= prediction_horizon_) {
+        // Predict from the two latest values, interpolate() extrapolates past the newer one
+        ++cache::predictions;
+        two = &storage_.front();
+        typename L_TransformStorage::iterator second = ++storage_.begin();
+        if (!reorder_.empty() &&
+          (second == storage_.end() || reorder_.begin()->stamp_ >= second->stamp_))
+        {
+          one = &*reorder_.begin();
+        } else {
+          one = &*second;
+        }
+        if (one->frame_id_ != two->frame_id_) {
+          one = two;
+          return 1;
+        }
+        return 2;
+      }
       cache::createExtrapolationException2(target_time, latest_time, error_str, error_code);
       return 0;
     } else {
@@ -167,21 +209,45 @@ uint8_t TimeCache::findClosest(
 
   // At least 2 values stored
   // Find the first value less than the target value
-  L_TransformStorage::iterator storage_it = storage_.begin();
+  typename L_TransformStorage::iterator storage_it = storage_.begin();
+  uint64_t steps = 0;
   while (storage_it != storage_.end()) {
     if (storage_it->stamp_ <= target_time) {
       break;
     }
     storage_it++;
+    steps++;
+  }
+  cache::search_steps += steps;
+
+  if (reorder_.empty()) {
+    // Finally the case were somewhere in the middle  Guarenteed no extrapolation :-)
+    one = &*(storage_it);  // Older
+    two = &*(--storage_it);  // Newer
+    return 2;
   }
 
-  // Finally the case were somewhere in the middle  Guarenteed no extrapolation :-)
-  one = &*(storage_it);  // Older
-  two = &*(--storage_it);  // Newer
+  // Take the closest of the staged and the stored entries on either side, there is always a
+  // stored one after the target since the latest entry is stored
+  typename S_TransformStorage::iterator staged_it = reorder_.lower_bound(target_time);
+  if (staged_it != reorder_.end() &&
+    (storage_it == storage_.end() || staged_it->stamp_ >= storage_it->stamp_))
+  {
+    one = &*staged_it;
+  } else {
+    one = &*storage_it;
+  }
+  --storage_it;
+  if (staged_it != reorder_.begin() && std::prev(staged_it)->stamp_ < storage_it->stamp_) {
+    two = &*std::prev(staged_it);
+  } else {
+    two = &*storage_it;
+  }
   return 2;
 }
 
-void TimeCache::interpolate(
+template<typename StorageT>
+void BasicTimeCache<StorageT>::interpolate(
   const TransformStorage & one, const TransformStorage & two,
   TimePoint time, TransformStorage & output)
 {
@@ -198,20 +264,28 @@ void TimeCache::interpolate(
   output.translation_.setInterpolate3(one.translation_, two.translation_, ratio);
 
   // Interpolate rotation
-  output.rotation_ = slerp(one.rotation_, two.rotation_, ratio);
+  tf2Scalar dot = one.rotation_.dot(two.rotation_);
+  if (std::abs(dot) >= nlerp_min_dot_) {
+    // q and -q are the same rotation, blend towards the closer one
+    tf2Scalar two_weight = dot < 0.0 ? -ratio : ratio;
+    output.rotation_ = (one.rotation_ * (1.0 - ratio) + two.rotation_ * two_weight).normalized();
+  } else {
+    output.rotation_ = slerp(one.rotation_, two.rotation_, ratio);
+  }
 
   output.stamp_ = one.stamp_;
   output.frame_id_ = one.frame_id_;
   output.child_frame_id_ = one.child_frame_id_;
 }
 
-bool TimeCache::getData(
+template<typename StorageT>
+bool BasicTimeCache<StorageT>::getData(
   TimePoint time, TransformStorage & data_out,
   std::string * error_str, TF2Error * error_code)
 {
   // returns false if data not available
-  TransformStorage * p_temp_1;
-  TransformStorage * p_temp_2;
+  const StorageT * p_temp_1;
+  const StorageT * p_temp_2;
 
   int num_nodes = findClosest(p_temp_1, p_temp_2, time, error_str, error_code);
   if (num_nodes == 0) {
@@ -230,11 +304,12 @@ bool TimeCache::getData(
   return true;
 }
 
-CompactFrameID TimeCache::getParent(
+template<typename StorageT>
+CompactFrameID BasicTimeCache<StorageT>::getParent(
   TimePoint time, std::string * error_str, TF2Error * error_code)
 {
-  TransformStorage * p_temp_1;
-  TransformStorage * p_temp_2;
+  const StorageT * p_temp_1;
+  const StorageT * p_temp_2;
 
   int num_nodes = findClosest(p_temp_1, p_temp_2, time, error_str, error_code);
   if (num_nodes == 0) {
@@ -244,14 +319,23 @@ CompactFrameID TimeCache::getParent(
   return p_temp_1->frame_id_;
 }
 
-bool TimeCache::insertData(const TransformStorage & new_data)
+template<typename StorageT>
+bool BasicTimeCache<StorageT>::insertData(const TransformStorage & new_data)
 {
-  L_TransformStorage::iterator storage_it = storage_.begin();
+  typename L_TransformStorage::iterator storage_it = storage_.begin();
 
   if (storage_it != storage_.end()) {
     if (storage_it->stamp_ > new_data.stamp_ + max_storage_time_) {
       return false;
     }
+    if (reorder_window_ != 0 && storage_it->stamp_ > new_data.stamp_) {
+      // Stage late entries, so that they are merged together rather than one at a time
+      reorder_.emplace(new_data);
+      if (reorder_.size() >= reorder_window_) {
+        mergeReordered();
+      }
+      return true;
+    }
   }
 
   while (storage_it != storage_.end()) {
@@ -260,33 +344,48 @@ bool TimeCache::insertData(const TransformStorage & new_data)
     }
     storage_it++;
   }
-  storage_.insert(storage_it, new_data);
+  storage_.emplace(storage_it, new_data);
 
   pruneList();
   return true;
 }
 
-void TimeCache::clearList()
+template<typename StorageT>
+void BasicTimeCache<StorageT>::clearList()
 {
   storage_.clear();
+  reorder_.clear();
+}
+
+template<typename StorageT>
+void BasicTimeCache<StorageT>::truncateAfter(TimePoint time)
+{
+  mergeReordered();
+  // The newest data is at the front
+  while (!storage_.empty() && storage_.front().stamp_ > time) {
+    storage_.pop_front();
+  }
 }
 
-unsigned int TimeCache::getListLength()
+template<typename StorageT>
+unsigned int BasicTimeCache<StorageT>::getListLength()
 {
-  return (unsigned int)storage_.size();
+  return (unsigned int)(storage_.size() + reorder_.size());
 }
 
-P_TimeAndFrameID TimeCache::getLatestTimeAndParent()
+template<typename StorageT>
+P_TimeAndFrameID BasicTimeCache<StorageT>::getLatestTimeAndParent()
 {
   if (storage_.empty()) {
     return std::make_pair(TimePoint(), 0);
   }
 
-  const TransformStorage & ts = storage_.front();
+  const StorageT & ts = storage_.front();
   return std::make_pair(ts.stamp_, ts.frame_id_);
 }
 
-TimePoint TimeCache::getLatestTimestamp()
+template<typename StorageT>
+TimePoint BasicTimeCache<StorageT>::getLatestTimestamp()
 {
   // empty list case
   if (storage_.empty()) {
@@ -295,21 +394,99 @@ TimePoint TimeCache::getLatestTimestamp()
   return storage_.front().stamp_;
 }
 
-TimePoint TimeCache::getOldestTimestamp()
+template<typename StorageT>
+TimePoint BasicTimeCache<StorageT>::getOldestTimestamp()
 {
   // empty list case
   if (storage_.empty()) {
     return TimePoint();
   }
+  if (!reorder_.empty() && reorder_.rbegin()->stamp_ < storage_.back().stamp_) {
+    return reorder_.rbegin()->stamp_;
+  }
   return storage_.back().stamp_;
 }
 
-void TimeCache::pruneList()
+template<typename StorageT>
+void BasicTimeCache<StorageT>::getDataSince(
+  TimePoint time, std::vector<TransformStorage> & data_out)
+{
+  typename L_TransformStorage::reverse_iterator it = storage_.rbegin();
+  typename S_TransformStorage::reverse_iterator staged_it = reorder_.rbegin();
+  while (it != storage_.rend() || staged_it != reorder_.rend()) {
+    // Interleave the staged entries, in the order merging them would give
+    const StorageT & entry =
+      staged_it != reorder_.rend() && (it == storage_.rend() || staged_it->stamp_ < it->stamp_) ?
+      *staged_it++ : *it++;
+    if (entry.stamp_ >= time) {
+      data_out.push_back(entry);
+    }
+  }
+}
+
+template<typename StorageT>
+uint64_t BasicTimeCache<StorageT>::getThreadSearchSteps()
+{
+  return cache::search_steps;
+}
+
+template<typename StorageT>
+void BasicTimeCache<StorageT>::setPredictionHorizon(tf2::Duration horizon)
+{
+  prediction_horizon_ = horizon;
+}
+
+template<typename StorageT>
+uint64_t BasicTimeCache<StorageT>::getThreadPredictions()
+{
+  return cache::predictions;
+}
+
+template<typename StorageT>
+void BasicTimeCache<StorageT>::setInterpolationPolicy(
+  InterpolationPolicy policy, double nlerp_max_angle)
+{
+  if (policy == InterpolationPolicy::Nlerp) {
+    nlerp_min_dot_ = std::cos(nlerp_max_angle / 2.0);
+  } else {
+    nlerp_min_dot_ = 2.0;
+  }
+}
+
+template<typename StorageT>
+void BasicTimeCache<StorageT>::setReorderWindow(size_t window)
+{
+  mergeReordered();
+  reorder_window_ = window;
+}
+
+template<typename StorageT>
+void BasicTimeCache<StorageT>::pruneList()
 {
   TimePoint latest_time = storage_.begin()->stamp_;
 
   while (!storage_.empty() && storage_.back().stamp_ + max_storage_time_ < latest_time) {
     storage_.pop_back();
   }
+  while (!reorder_.empty() && reorder_.rbegin()->stamp_ + max_storage_time_ < latest_time) {
+    reorder_.erase(std::prev(reorder_.end()));
+  }
 }
+
+template<typename StorageT>
+void BasicTimeCache<StorageT>::mergeReordered()
+{
+  // Both are sorted newest first, so one pass from the front places every staged entry
+  typename L_TransformStorage::iterator storage_it = storage_.begin();
+  for (const StorageT & staged : reorder_) {
+    while (storage_it != storage_.end() && storage_it->stamp_ > staged.stamp_) {
+      ++storage_it;
+    }
+    storage_.emplace(storage_it, staged);
+  }
+  reorder_.clear();
+}
+
+template class BasicTimeCache<TransformStorage>;
+template class BasicTimeCache<CompactTransformStorage>;
 }  // namespace tf2
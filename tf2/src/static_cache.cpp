@@ -28,6 +28,7 @@
 
 /** \author Tully Foote */
 
+#include <memory>
 #include <string>
 #include <utility>
 
@@ -55,6 +56,11 @@ bool tf2::StaticCache::insertData(const tf2::TransformStorage & new_data)
 
 void tf2::StaticCache::clearList() {}
 
+void tf2::StaticCache::truncateAfter(tf2::TimePoint time)
+{
+  (void)time;
+}
+
 unsigned tf2::StaticCache::getListLength() {return 1;}
 
 tf2::CompactFrameID tf2::StaticCache::getParent(
@@ -81,3 +87,76 @@ tf2::TimePoint tf2::StaticCache::getOldestTimestamp()
 {
   return tf2::TimePoint();
 }
+
+bool tf2::SharedStaticCache::getData(
+  tf2::TimePoint time,
+  tf2::TransformStorage & data_out, std::string * error_str, TF2Error * error_code)
+{
+  (void)error_code;
+  (void)error_str;
+  if (storage_) {
+    data_out = *storage_;
+  } else {
+    data_out = TransformStorage();
+  }
+  data_out.stamp_ = time;
+  data_out.frame_id_ = frame_id_;
+  data_out.child_frame_id_ = child_frame_id_;
+  return true;
+}
+
+bool tf2::SharedStaticCache::insertData(const tf2::TransformStorage & new_data)
+{
+  storage_ = std::make_shared<const TransformStorage>(new_data);
+  frame_id_ = new_data.frame_id_;
+  child_frame_id_ = new_data.child_frame_id_;
+  return true;
+}
+
+void tf2::SharedStaticCache::insertSharedData(
+  std::shared_ptr<const TransformStorage> data, CompactFrameID frame_id,
+  CompactFrameID child_frame_id)
+{
+  storage_ = std::move(data);
+  frame_id_ = frame_id;
+  child_frame_id_ = child_frame_id;
+}
+
+std::shared_ptr<const tf2::TransformStorage> tf2::SharedStaticCache::getSharedData() const
+{
+  return storage_;
+}
+
+void tf2::SharedStaticCache::clearList() {}
+
+void tf2::SharedStaticCache::truncateAfter(tf2::TimePoint time)
+{
+  (void)time;
+}
+
+unsigned tf2::SharedStaticCache::getListLength() {return 1;}
+
+tf2::CompactFrameID tf2::SharedStaticCache::getParent(
+  tf2::TimePoint time, std::string * error_str,
+  TF2Error * error_code)
+{
+  (void)time;
+  (void)error_code;
+  (void)error_str;
+  return frame_id_;
+}
+
+tf2::P_TimeAndFrameID tf2::SharedStaticCache::getLatestTimeAndParent()
+{
+  return std::make_pair(TimePoint(), frame_id_);
+}
+
+tf2::TimePoint tf2::SharedStaticCache::getLatestTimestamp()
+{
+  return tf2::TimePoint();
+}
+
+tf2::TimePoint tf2::SharedStaticCache::getOldestTimestamp()
+{
+  return tf2::TimePoint();
+}
@@ -0,0 +1,152 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// LTTng-UST tracepoint provider for tf2, only compiled with TF2_TRACING.
+// This header is read several times by lttng/tracepoint-event.h, hence the unusual guard.
+
+#undef TRACEPOINT_PROVIDER
+#define TRACEPOINT_PROVIDER tf2
+
+#undef TRACEPOINT_INCLUDE
+#define TRACEPOINT_INCLUDE "tf2_tracing_provider.h"
+
+#if !defined(TF2_TRACING_PROVIDER_H_) || defined(TRACEPOINT_HEADER_MULTI_READ)  // NOLINT
+#define TF2_TRACING_PROVIDER_H_
+
+#include <lttng/tracepoint.h>
+
+#include <cstdint>
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  set_transform,
+  TP_ARGS(
+    const void *, buffer_arg,
+    const char *, frame_id_arg,
+    const char *, child_frame_id_arg,
+    int64_t, stamp_arg,
+    int, is_static_arg,
+    int, accepted_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, buffer, buffer_arg)
+    ctf_string(frame_id, frame_id_arg)
+    ctf_string(child_frame_id, child_frame_id_arg)
+    ctf_integer(int64_t, stamp, stamp_arg)
+    ctf_integer(uint8_t, is_static, is_static_arg)
+    ctf_integer(uint8_t, accepted, accepted_arg))
+)
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  lookup_transform_entry,
+  TP_ARGS(
+    const void *, buffer_arg,
+    const char *, target_frame_arg,
+    const char *, source_frame_arg,
+    int64_t, time_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, buffer, buffer_arg)
+    ctf_string(target_frame, target_frame_arg)
+    ctf_string(source_frame, source_frame_arg)
+    ctf_integer(int64_t, time, time_arg))
+)
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  lookup_transform_exit,
+  TP_ARGS(
+    const void *, buffer_arg,
+    int, error_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, buffer, buffer_arg)
+    ctf_integer(int, error, error_arg))
+)
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  transformable_requests_entry,
+  TP_ARGS(
+    const void *, buffer_arg,
+    uint64_t, queue_length_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, buffer, buffer_arg)
+    ctf_integer(uint64_t, queue_length, queue_length_arg))
+)
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  transformable_requests_exit,
+  TP_ARGS(
+    const void *, buffer_arg,
+    uint64_t, queue_length_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, buffer, buffer_arg)
+    ctf_integer(uint64_t, queue_length, queue_length_arg))
+)
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  transform_listener_callback_entry,
+  TP_ARGS(
+    const void *, listener_arg,
+    uint64_t, transform_count_arg,
+    int, is_static_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, listener, listener_arg)
+    ctf_integer(uint64_t, transform_count, transform_count_arg)
+    ctf_integer(uint8_t, is_static, is_static_arg))
+)
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  transform_listener_callback_exit,
+  TP_ARGS(
+    const void *, listener_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, listener, listener_arg))
+)
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  message_filter_add,
+  TP_ARGS(
+    const void *, filter_arg,
+    const char *, frame_id_arg,
+    int64_t, stamp_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, filter, filter_arg)
+    ctf_string(frame_id, frame_id_arg)
+    ctf_integer(int64_t, stamp, stamp_arg))
+)
+
+TRACEPOINT_EVENT(
+  TRACEPOINT_PROVIDER,
+  message_filter_release,
+  TP_ARGS(
+    const void *, filter_arg,
+    const char *, frame_id_arg,
+    int64_t, stamp_arg,
+    int, success_arg,
+    int, reason_arg),
+  TP_FIELDS(
+    ctf_integer_hex(const void *, filter, filter_arg)
+    ctf_string(frame_id, frame_id_arg)
+    ctf_integer(int64_t, stamp, stamp_arg)
+    ctf_integer(uint8_t, success, success_arg)
+    ctf_integer(int, reason, reason_arg))
+)
+
+#endif  // TF2_TRACING_PROVIDER_H_
+
+#include <lttng/tracepoint-event.h>
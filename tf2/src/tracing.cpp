@@ -0,0 +1,81 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Only compiled with TF2_TRACING, which also defines TF2_TRACING_ENABLED.
+
+#define TRACEPOINT_CREATE_PROBES
+#define TRACEPOINT_DEFINE
+#include "tf2_tracing_provider.h"
+
+#include <cstdint>
+
+#include "tf2/tracing.h"
+
+namespace tf2
+{
+namespace tracing
+{
+
+void set_transform(
+  const void * buffer, const char * frame_id, const char * child_frame_id, int64_t stamp_ns,
+  bool is_static, bool accepted)
+{
+  tracepoint(tf2, set_transform, buffer, frame_id, child_frame_id, stamp_ns, is_static, accepted);
+}
+
+void lookup_transform_entry(
+  const void * buffer, const char * target_frame, const char * source_frame, int64_t time_ns)
+{
+  tracepoint(tf2, lookup_transform_entry, buffer, target_frame, source_frame, time_ns);
+}
+
+void lookup_transform_exit(const void * buffer, int error)
+{
+  tracepoint(tf2, lookup_transform_exit, buffer, error);
+}
+
+void transformable_requests_entry(const void * buffer, uint64_t queue_length)
+{
+  tracepoint(tf2, transformable_requests_entry, buffer, queue_length);
+}
+
+void transformable_requests_exit(const void * buffer, uint64_t queue_length)
+{
+  tracepoint(tf2, transformable_requests_exit, buffer, queue_length);
+}
+
+void transform_listener_callback_entry(
+  const void * listener, uint64_t transform_count, bool is_static)
+{
+  tracepoint(tf2, transform_listener_callback_entry, listener, transform_count, is_static);
+}
+
+void transform_listener_callback_exit(const void * listener)
+{
+  tracepoint(tf2, transform_listener_callback_exit, listener);
+}
+
+void message_filter_add(const void * filter, const char * frame_id, int64_t stamp_ns)
+{
+  tracepoint(tf2, message_filter_add, filter, frame_id, stamp_ns);
+}
+
+void message_filter_release(
+  const void * filter, const char * frame_id, int64_t stamp_ns, bool success, int reason)
+{
+  tracepoint(tf2, message_filter_release, filter, frame_id, stamp_ns, success, reason);
+}
+
+}  // namespace tracing
+}  // namespace tf2
@@ -0,0 +1,523 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include "geometry_msgs/msg/transform_stamped.hpp"
+
+#include "tf2/buffer_core.h"
+#include "tf2/exceptions.h"
+#include "tf2/time.h"
+
+#include "synthetic_tree.hpp"
+
+using tf2_benchmark::SyntheticTree;
+using tf2_benchmark::SyntheticTreeConfig;
+
+namespace
+{
+// Number of allocations made by the process, reported per item by the ingest benchmarks
+std::atomic<size_t> allocations{0};
+// Number of bytes allocated by the process, reported per entry by the memory benchmarks
+std::atomic<size_t> allocated_bytes{0};
+}  // namespace
+
+void * operator new(std::size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  void * p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void * p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void * operator new(std::size_t size, std::align_val_t alignment)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+  void * p = _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+  void * p = std::aligned_alloc(align, ((size == 0 ? 1 : size) + align - 1) / align * align);
+#endif
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void * p, std::align_val_t) noexcept
+{
+#ifdef _WIN32
+  _aligned_free(p);
+#else
+  std::free(p);
+#endif
+}
+
+void operator delete(void * p, std::size_t, std::align_val_t alignment) noexcept
+{
+  operator delete(p, alignment);
+}
+
+namespace
+{
+
+// Benchmark arguments are {depth, fan_out, static_every, cache_time_s, rate_hz}.
+SyntheticTreeConfig configFromState(const benchmark::State & state)
+{
+  SyntheticTreeConfig config;
+  config.depth = static_cast<size_t>(state.range(0));
+  config.fan_out = static_cast<size_t>(state.range(1));
+  config.static_every = static_cast<size_t>(state.range(2));
+  config.cache_time = std::chrono::seconds(state.range(3));
+  config.rate_hz = static_cast<double>(state.range(4));
+  return config;
+}
+
+void treeShapes(benchmark::internal::Benchmark * b)
+{
+  b->ArgNames({"depth", "fan_out", "static_every", "cache_s", "rate_hz"});
+  // Shallow and deep chains, all dynamic.
+  b->Args({2, 4, 0, 10, 100});
+  b->Args({8, 4, 0, 10, 100});
+  b->Args({32, 4, 0, 10, 100});
+  // Wide tree.
+  b->Args({8, 32, 0, 10, 100});
+  // Mixed static/dynamic, like a robot_state_publisher tree.
+  b->Args({8, 4, 2, 10, 100});
+  // Deep cache at a high publish rate.
+  b->Args({8, 4, 0, 10, 1000});
+}
+
+void reportTree(benchmark::State & state, const SyntheticTree & tree)
+{
+  state.counters["frames"] = static_cast<double>(tree.frameCount());
+  state.counters["cache_entries"] = static_cast<double>(tree.ticksPerCacheWindow());
+}
+
+}  // namespace
+
+static void setTransform(benchmark::State & state, tf2::StoragePrecision precision)
+{
+  SyntheticTree tree(configFromState(state));
+  tf2::BufferCore buffer(tree.config().cache_time, precision);
+  tree.fill(buffer);
+
+  // Steady state: every insert also prunes the oldest entry of its cache.
+  // Messages are built up front and only their stamps advance in the loop.
+  std::vector<geometry_msgs::msg::TransformStamped> messages;
+  for (size_t index = 0; index < tree.frameCount(); ++index) {
+    messages.push_back(tree.message(index, tree.ticksPerCacheWindow()));
+  }
+  const uint32_t period_ns = static_cast<uint32_t>(tree.period().count());
+  const std::string authority = "benchmark";
+  size_t index = 0;
+  size_t allocations_before = allocations.load(std::memory_order_relaxed);
+  for (auto _ : state) {
+    geometry_msgs::msg::TransformStamped & msg = messages[index];
+    benchmark::DoNotOptimize(buffer.setTransform(msg, authority, tree.isStatic(index)));
+    msg.header.stamp.nanosec += period_ns;
+    if (msg.header.stamp.nanosec >= 1000000000u) {
+      msg.header.stamp.nanosec -= 1000000000u;
+      ++msg.header.stamp.sec;
+    }
+    if (++index == messages.size()) {
+      index = 0;
+    }
+  }
+  state.counters["allocations_per_insert"] = benchmark::Counter(
+    static_cast<double>(allocations.load(std::memory_order_relaxed) - allocations_before),
+    benchmark::Counter::kAvgIterations);
+  state.SetItemsProcessed(state.iterations());
+  reportTree(state, tree);
+}
+
+static void BM_SetTransform(benchmark::State & state)
+{
+  setTransform(state, tf2::StoragePrecision::Double);
+}
+BENCHMARK(BM_SetTransform)->Apply(treeShapes);
+
+static void BM_SetTransformSingle(benchmark::State & state)
+{
+  setTransform(state, tf2::StoragePrecision::Single);
+}
+BENCHMARK(BM_SetTransformSingle)->Apply(treeShapes);
+
+// Two publishers of one link, the second one lagging behind the first by lag entries.
+static void BM_SetTransformReordered(benchmark::State & state)
+{
+  tf2::BufferCore buffer(std::chrono::seconds(10));
+  buffer.setReorderWindow(static_cast<size_t>(state.range(0)));
+  const int64_t lag = state.range(1);
+  const int64_t period_ns = 10000000;
+  geometry_msgs::msg::TransformStamped msg;
+  msg.header.frame_id = "odom";
+  msg.child_frame_id = "base_link";
+  msg.transform.rotation.w = 1.0;
+  auto stamp = [&msg, period_ns](int64_t index) {
+      int64_t ns = (index + 1) * period_ns;
+      msg.header.stamp.sec = static_cast<int32_t>(ns / 1000000000);
+      msg.header.stamp.nanosec = static_cast<uint32_t>(ns % 1000000000);
+    };
+  const std::string authority = "benchmark";
+  // Fill the cache window in order, so that every insert prunes
+  int64_t index = 0;
+  for (; index < 1000; ++index) {
+    stamp(index);
+    buffer.setTransform(msg, authority);
+  }
+  for (auto _ : state) {
+    // Even entries arrive on time, odd ones lag entries late
+    stamp(index % 2 == 0 ? index : index - lag);
+    benchmark::DoNotOptimize(buffer.setTransform(msg, authority));
+    ++index;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SetTransformReordered)
+->ArgNames({"window", "lag"})->ArgsProduct({{0, 16}, {2, 64, 512}});
+
+// Heap held by a full cache window, including the frame table and the cache pools.
+static void cacheMemory(benchmark::State & state, tf2::StoragePrecision precision)
+{
+  SyntheticTree tree(configFromState(state));
+  size_t bytes = 0;
+  for (auto _ : state) {
+    size_t bytes_before = allocated_bytes.load(std::memory_order_relaxed);
+    tf2::BufferCore buffer(tree.config().cache_time, precision);
+    tree.fill(buffer);
+    bytes = allocated_bytes.load(std::memory_order_relaxed) - bytes_before;
+  }
+  // Static frames keep a single entry.
+  double entries = 0.0;
+  for (size_t index = 0; index < tree.frameCount(); ++index) {
+    entries += tree.isStatic(index) ? 1.0 : static_cast<double>(tree.ticksPerCacheWindow());
+  }
+  state.counters["bytes"] = static_cast<double>(bytes);
+  state.counters["bytes_per_entry"] = static_cast<double>(bytes) / entries;
+  reportTree(state, tree);
+}
+
+static void BM_CacheMemory(benchmark::State & state)
+{
+  cacheMemory(state, tf2::StoragePrecision::Double);
+}
+BENCHMARK(BM_CacheMemory)->Apply(treeShapes)->Unit(benchmark::kMillisecond);
+
+static void BM_CacheMemorySingle(benchmark::State & state)
+{
+  cacheMemory(state, tf2::StoragePrecision::Single);
+}
+BENCHMARK(BM_CacheMemorySingle)->Apply(treeShapes)->Unit(benchmark::kMillisecond);
+
+static void BM_LookupTransformLatest(benchmark::State & state)
+{
+  SyntheticTree tree(configFromState(state));
+  tf2::BufferCore buffer(tree.config().cache_time);
+  tree.fill(buffer);
+  const std::string target = tree.leaf(0);
+  const std::string source = tree.leaf(1);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer.lookupTransform(target, source, tf2::TimePointZero));
+  }
+  state.SetItemsProcessed(state.iterations());
+  reportTree(state, tree);
+}
+BENCHMARK(BM_LookupTransformLatest)->Apply(treeShapes);
+
+static void lookupInterpolated(
+  benchmark::State & state, tf2::InterpolationPolicy policy,
+  tf2::StoragePrecision precision = tf2::StoragePrecision::Double)
+{
+  SyntheticTree tree(configFromState(state));
+  tf2::BufferCore buffer(tree.config().cache_time, precision);
+  buffer.setInterpolationPolicy(policy);
+  tree.fill(buffer);
+  const std::string target = tree.leaf(0);
+  const std::string source = tree.leaf(1);
+  // Halfway between two samples in the middle of the cache window.
+  const tf2::TimePoint time = tree.stamp(tree.ticksPerCacheWindow() / 2) + tree.period() / 2;
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer.lookupTransform(target, source, time));
+  }
+  state.SetItemsProcessed(state.iterations());
+  reportTree(state, tree);
+}
+
+static void BM_LookupTransformInterpolated(benchmark::State & state)
+{
+  lookupInterpolated(state, tf2::InterpolationPolicy::Slerp);
+}
+BENCHMARK(BM_LookupTransformInterpolated)->Apply(treeShapes);
+
+static void BM_LookupTransformInterpolatedNlerp(benchmark::State & state)
+{
+  lookupInterpolated(state, tf2::InterpolationPolicy::Nlerp);
+}
+BENCHMARK(BM_LookupTransformInterpolatedNlerp)->Apply(treeShapes);
+
+static void BM_LookupTransformInterpolatedSingle(benchmark::State & state)
+{
+  lookupInterpolated(state, tf2::InterpolationPolicy::Slerp, tf2::StoragePrecision::Single);
+}
+BENCHMARK(BM_LookupTransformInterpolatedSingle)->Apply(treeShapes);
+
+static void BM_LookupTransformFixedFrame(benchmark::State & state)
+{
+  SyntheticTree tree(configFromState(state));
+  tf2::BufferCore buffer(tree.config().cache_time);
+  tree.fill(buffer);
+  const std::string target = tree.leaf(0);
+  const std::string source = tree.leaf(1);
+  const tf2::TimePoint source_time =
+    tree.stamp(tree.ticksPerCacheWindow() / 4) + tree.period() / 2;
+  const tf2::TimePoint target_time =
+    tree.stamp(tree.ticksPerCacheWindow() / 2) + tree.period() / 2;
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+      buffer.lookupTransform(target, target_time, source, source_time, tree.root()));
+  }
+  state.SetItemsProcessed(state.iterations());
+  reportTree(state, tree);
+}
+BENCHMARK(BM_LookupTransformFixedFrame)->Apply(treeShapes);
+
+// Odometry-style motion compensation: where a leaf was one tick ago, seen from where it is now.
+static void BM_LookupTransformTimeTravel(benchmark::State & state)
+{
+  SyntheticTree tree(configFromState(state));
+  tf2::BufferCore buffer(tree.config().cache_time);
+  tree.fill(buffer);
+  const std::string frame = tree.leaf(0);
+  const tf2::TimePoint target_time =
+    tree.stamp(tree.ticksPerCacheWindow() / 2) + tree.period() / 2;
+  const tf2::TimePoint source_time = target_time - tree.period();
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+      buffer.lookupTransform(frame, target_time, frame, source_time, tree.root()));
+  }
+  state.SetItemsProcessed(state.iterations());
+  reportTree(state, tree);
+}
+BENCHMARK(BM_LookupTransformTimeTravel)->Apply(treeShapes);
+
+static void BM_CanTransformHit(benchmark::State & state)
+{
+  SyntheticTree tree(configFromState(state));
+  tf2::BufferCore buffer(tree.config().cache_time);
+  tree.fill(buffer);
+  const std::string target = tree.leaf(0);
+  const std::string source = tree.leaf(1);
+  const tf2::TimePoint time = tree.stamp(tree.ticksPerCacheWindow() / 2) + tree.period() / 2;
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer.canTransform(target, source, time));
+  }
+  state.SetItemsProcessed(state.iterations());
+  reportTree(state, tree);
+}
+BENCHMARK(BM_CanTransformHit)->Apply(treeShapes);
+
+static void BM_CanTransformMissDisconnected(benchmark::State & state)
+{
+  SyntheticTree tree(configFromState(state));
+  tf2::BufferCore buffer(tree.config().cache_time);
+  tree.fill(buffer);
+
+  // A frame in a second tree that is not connected to the first one.
+  geometry_msgs::msg::TransformStamped island = tree.message(0, 0);
+  island.header.frame_id = "island_root";
+  island.child_frame_id = "island";
+  buffer.setTransform(island, "benchmark", true);
+
+  const std::string target = tree.leaf(0);
+  std::string error;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer.canTransform(target, "island", tf2::TimePointZero, &error));
+  }
+  state.SetItemsProcessed(state.iterations());
+  reportTree(state, tree);
+}
+BENCHMARK(BM_CanTransformMissDisconnected)->Apply(treeShapes);
+
+static void BM_CanTransformMissExtrapolation(benchmark::State & state)
+{
+  SyntheticTree tree(configFromState(state));
+  tf2::BufferCore buffer(tree.config().cache_time);
+  tree.fill(buffer);
+  const std::string target = tree.leaf(0);
+  const std::string source = tree.leaf(1);
+  // Just past the newest data, the common case while waiting on /tf.
+  const tf2::TimePoint time = tree.stamp(tree.ticksPerCacheWindow()) + tree.period() / 2;
+
+  std::string error;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer.canTransform(target, source, time, &error));
+  }
+  state.SetItemsProcessed(state.iterations());
+  reportTree(state, tree);
+}
+BENCHMARK(BM_CanTransformMissExtrapolation)->Apply(treeShapes);
+
+static void BM_GetLatestCommonTime(benchmark::State & state)
+{
+  SyntheticTree tree(configFromState(state));
+  tf2::BufferCore buffer(tree.config().cache_time);
+  tree.fill(buffer);
+  const tf2::CompactFrameID target = buffer._lookupFrameNumber(tree.leaf(0));
+  const tf2::CompactFrameID source = buffer._lookupFrameNumber(tree.leaf(1));
+
+  tf2::TimePoint time;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer._getLatestCommonTime(target, source, time, nullptr));
+    benchmark::DoNotOptimize(time);
+  }
+  state.SetItemsProcessed(state.iterations());
+  reportTree(state, tree);
+}
+BENCHMARK(BM_GetLatestCommonTime)->Apply(treeShapes);
+
+namespace
+{
+
+// State shared by all threads of the contention benchmarks.
+struct ContentionFixture
+{
+  /// With sharded set, every branch of the tree gets a shard of its own.
+  explicit ContentionFixture(bool sharded = false)
+  : tree(config()), buffer(tree.config().cache_time), next_tick(tree.ticksPerCacheWindow())
+  {
+    if (sharded) {
+      for (size_t branch = 0; branch < tree.config().fan_out; ++branch) {
+        buffer.addShard(SyntheticTree::frameName(branch, 0));
+      }
+    }
+    tree.fill(buffer);
+  }
+
+  static SyntheticTreeConfig config()
+  {
+    SyntheticTreeConfig config;
+    config.depth = 8;
+    config.fan_out = 4;
+    return config;
+  }
+
+  SyntheticTree tree;
+  tf2::BufferCore buffer;
+  std::atomic<size_t> next_tick;
+};
+
+std::unique_ptr<ContentionFixture> g_contention;
+
+}  // namespace
+
+// Thread 0 publishes the whole tree at an ever increasing stamp while all
+// other threads look up the latest transform between two leaves.
+static void BM_LookupTransformContention(benchmark::State & state)
+{
+  // The fixture is only touched inside the timing loop, whose start and end
+  // act as barriers across all threads of the run.
+  if (state.thread_index() == 0) {
+    g_contention = std::make_unique<ContentionFixture>();
+  }
+
+  for (auto _ : state) {
+    ContentionFixture & fixture = *g_contention;
+    if (state.thread_index() == 0 && state.threads() > 1) {
+      size_t tick = fixture.next_tick++;
+      for (size_t index = 0; index < fixture.tree.frameCount(); ++index) {
+        fixture.buffer.setTransform(fixture.tree.message(index, tick), "benchmark");
+      }
+    } else {
+      benchmark::DoNotOptimize(
+        fixture.buffer.lookupTransform(
+          fixture.tree.leaf(0), fixture.tree.leaf(1), tf2::TimePointZero));
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  if (state.thread_index() == 0) {
+    g_contention.reset();
+  }
+}
+BENCHMARK(BM_LookupTransformContention)->ThreadRange(1, 8)->UseRealTime();
+
+// Thread 0 publishes branch 0 at an ever increasing stamp while all other
+// threads look up the latest transform across branch 1 (disjoint) or across
+// branch 0 (overlapping).
+// Arguments: whether each branch has a shard, whether lookups overlap the writes.
+static void BM_LookupTransformShardContention(benchmark::State & state)
+{
+  if (state.thread_index() == 0) {
+    g_contention = std::make_unique<ContentionFixture>(state.range(0) != 0);
+  }
+  const bool overlapping = state.range(1) != 0;
+
+  for (auto _ : state) {
+    ContentionFixture & fixture = *g_contention;
+    if (state.thread_index() == 0 && state.threads() > 1) {
+      size_t tick = fixture.next_tick++;
+      for (size_t index = 0; index < fixture.tree.config().depth; ++index) {
+        fixture.buffer.setTransform(fixture.tree.message(index, tick), "benchmark");
+      }
+    } else {
+      benchmark::DoNotOptimize(
+        fixture.buffer.lookupTransform(
+          SyntheticTree::frameName(overlapping ? 0 : 1, 0),
+          fixture.tree.leaf(overlapping ? 0 : 1), tf2::TimePointZero));
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  if (state.thread_index() == 0) {
+    g_contention.reset();
+  }
+}
+BENCHMARK(BM_LookupTransformShardContention)
+->ArgsProduct({{0, 1}, {0, 1}})->ArgNames({"sharded", "overlapping"})
+->ThreadRange(2, 8)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,493 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Offline replay of a recorded /tf + /tf_static stream into a BufferCore.
+//
+// The trace is either CSV, one transform per line:
+//
+//   receive_ns,is_static,frame_id,child_frame_id,sec,nanosec,tx,ty,tz,qx,qy,qz,qw
+//
+// or the equivalent binary form produced by --convert. Consecutive transforms
+// with the same receive_ns are replayed as a single TFMessage burst, which is
+// how robot_state_publisher output arrives. Lines starting with '#' are ignored.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "geometry_msgs/msg/transform_stamped.hpp"
+
+#include "tf2/buffer_core.h"
+#include "tf2/exceptions.h"
+#include "tf2/time.h"
+
+namespace
+{
+
+constexpr char BINARY_MAGIC[8] = {'T', 'F', '2', 'T', 'R', 'A', 'C', 'E'};
+constexpr uint32_t BINARY_VERSION = 1;
+
+struct TraceMessage
+{
+  int64_t receive_ns = 0;
+  std::vector<std::pair<geometry_msgs::msg::TransformStamped, bool>> transforms;
+};
+
+struct LookupPair
+{
+  std::string target;
+  std::string source;
+};
+
+enum class LookupTime
+{
+  Latest,
+  Stamp,
+};
+
+struct Options
+{
+  std::string trace;
+  std::string convert_to;
+  bool recorded_speed = false;
+  std::vector<LookupPair> lookups;
+  size_t lookups_per_message = 1;
+  size_t lookup_threads = 0;
+  LookupTime lookup_time = LookupTime::Latest;
+  tf2::Duration lookup_delay = tf2::Duration(0);
+  tf2::Duration cache_time = tf2::BUFFER_CORE_DEFAULT_CACHE_TIME;
+};
+
+struct LookupStats
+{
+  std::vector<int64_t> latencies_ns;
+  size_t lookup_errors = 0;
+  size_t connectivity_errors = 0;
+  size_t extrapolation_errors = 0;
+};
+
+void usage()
+{
+  printf("Usage: tf2_replay_benchmark TRACE [options]\n\n");
+  printf("Replays a recorded TF stream into tf2::BufferCore without a ROS graph and reports\n");
+  printf("ingest throughput and lookup latency percentiles.\n\n");
+  printf("TRACE is a CSV file with one transform per line:\n");
+  printf("  receive_ns,is_static,frame_id,child_frame_id,sec,nanosec,tx,ty,tz,qx,qy,qz,qw\n");
+  printf("or a binary trace written by --convert.\n\n");
+  printf("Options:\n");
+  printf("  --speed recorded|max       Pace messages by receive_ns, or as fast as possible\n");
+  printf("                             (default: max)\n");
+  printf("  --lookup TARGET,SOURCE     Frame pair to look up, may be repeated\n");
+  printf("  --lookups-per-message N    Lookups interleaved after each message (default: 1)\n");
+  printf("  --lookup-threads N         Run lookups on N threads instead of interleaving\n");
+  printf("  --lookup-time latest|stamp[:DELAY_S]\n");
+  printf("                             Look up the latest data, or at the stamp of the last\n");
+  printf("                             message minus an optional delay (default: latest)\n");
+  printf("  --cache-time SECONDS       BufferCore cache time (default: 10)\n");
+  printf("  --convert OUT              Write TRACE in binary form to OUT and exit\n");
+}
+
+bool parseOptions(int argc, char ** argv, Options & options)
+{
+  std::vector<std::string> args(argv + 1, argv + argc);
+  for (size_t i = 0; i < args.size(); ++i) {
+    const std::string & arg = args[i];
+    auto next = [&]() -> const std::string & {
+        if (i + 1 >= args.size()) {
+          throw std::invalid_argument("missing value for " + arg);
+        }
+        return args[++i];
+      };
+    if (arg == "--speed") {
+      const std::string & speed = next();
+      if (speed != "recorded" && speed != "max") {
+        throw std::invalid_argument("unknown speed '" + speed + "'");
+      }
+      options.recorded_speed = speed == "recorded";
+    } else if (arg == "--lookup") {
+      const std::string & pair = next();
+      size_t comma = pair.find(',');
+      if (comma == std::string::npos) {
+        throw std::invalid_argument("--lookup expects TARGET,SOURCE");
+      }
+      options.lookups.push_back({pair.substr(0, comma), pair.substr(comma + 1)});
+    } else if (arg == "--lookups-per-message") {
+      options.lookups_per_message = std::stoul(next());
+    } else if (arg == "--lookup-threads") {
+      options.lookup_threads = std::stoul(next());
+    } else if (arg == "--lookup-time") {
+      const std::string & mode = next();
+      if (mode == "latest") {
+        options.lookup_time = LookupTime::Latest;
+      } else if (mode.compare(0, 5, "stamp") == 0) {
+        options.lookup_time = LookupTime::Stamp;
+        if (mode.size() > 6 && mode[5] == ':') {
+          options.lookup_delay = tf2::durationFromSec(std::stod(mode.substr(6)));
+        }
+      } else {
+        throw std::invalid_argument("unknown lookup time '" + mode + "'");
+      }
+    } else if (arg == "--cache-time") {
+      options.cache_time = tf2::durationFromSec(std::stod(next()));
+    } else if (arg == "--convert") {
+      options.convert_to = next();
+    } else if (options.trace.empty() && arg.compare(0, 2, "--") != 0) {
+      options.trace = arg;
+    } else {
+      throw std::invalid_argument("unexpected argument '" + arg + "'");
+    }
+  }
+  return !options.trace.empty();
+}
+
+void appendTransform(
+  std::vector<TraceMessage> & messages, int64_t receive_ns,
+  geometry_msgs::msg::TransformStamped && transform, bool is_static)
+{
+  if (messages.empty() || messages.back().receive_ns != receive_ns) {
+    messages.emplace_back();
+    messages.back().receive_ns = receive_ns;
+  }
+  messages.back().transforms.emplace_back(std::move(transform), is_static);
+}
+
+std::vector<TraceMessage> loadCsv(std::istream & in)
+{
+  std::vector<TraceMessage> messages;
+  std::string line;
+  size_t line_number = 0;
+  while (std::getline(in, line)) {
+    ++line_number;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string field;
+    while (std::getline(ss, field, ',')) {
+      fields.push_back(field);
+    }
+    if (fields.size() != 13) {
+      throw std::runtime_error(
+              "line " + std::to_string(line_number) + ": expected 13 fields, got " +
+              std::to_string(fields.size()));
+    }
+    geometry_msgs::msg::TransformStamped transform;
+    transform.header.frame_id = fields[2];
+    transform.child_frame_id = fields[3];
+    transform.header.stamp.sec = static_cast<int32_t>(std::stol(fields[4]));
+    transform.header.stamp.nanosec = static_cast<uint32_t>(std::stoul(fields[5]));
+    transform.transform.translation.x = std::stod(fields[6]);
+    transform.transform.translation.y = std::stod(fields[7]);
+    transform.transform.translation.z = std::stod(fields[8]);
+    transform.transform.rotation.x = std::stod(fields[9]);
+    transform.transform.rotation.y = std::stod(fields[10]);
+    transform.transform.rotation.z = std::stod(fields[11]);
+    transform.transform.rotation.w = std::stod(fields[12]);
+    appendTransform(messages, std::stoll(fields[0]), std::move(transform), fields[1] == "1");
+  }
+  return messages;
+}
+
+template<typename T>
+void readValue(std::istream & in, T & value)
+{
+  in.read(reinterpret_cast<char *>(&value), sizeof(value));
+  if (!in) {
+    throw std::runtime_error("truncated binary trace");
+  }
+}
+
+template<typename T>
+void writeValue(std::ostream & out, const T & value)
+{
+  out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+std::string readString(std::istream & in)
+{
+  uint16_t length;
+  readValue(in, length);
+  std::string value(length, '\0');
+  in.read(&value[0], length);
+  if (!in) {
+    throw std::runtime_error("truncated binary trace");
+  }
+  return value;
+}
+
+void writeString(std::ostream & out, const std::string & value)
+{
+  writeValue(out, static_cast<uint16_t>(value.size()));
+  out.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+std::vector<TraceMessage> loadBinary(std::istream & in)
+{
+  std::vector<TraceMessage> messages;
+  uint32_t version;
+  readValue(in, version);
+  if (version != BINARY_VERSION) {
+    throw std::runtime_error("unsupported binary trace version " + std::to_string(version));
+  }
+  while (in.peek() != std::char_traits<char>::eof()) {
+    int64_t receive_ns;
+    uint8_t is_static;
+    geometry_msgs::msg::TransformStamped transform;
+    readValue(in, receive_ns);
+    readValue(in, is_static);
+    readValue(in, transform.header.stamp.sec);
+    readValue(in, transform.header.stamp.nanosec);
+    readValue(in, transform.transform.translation.x);
+    readValue(in, transform.transform.translation.y);
+    readValue(in, transform.transform.translation.z);
+    readValue(in, transform.transform.rotation.x);
+    readValue(in, transform.transform.rotation.y);
+    readValue(in, transform.transform.rotation.z);
+    readValue(in, transform.transform.rotation.w);
+    transform.header.frame_id = readString(in);
+    transform.child_frame_id = readString(in);
+    appendTransform(messages, receive_ns, std::move(transform), is_static != 0);
+  }
+  return messages;
+}
+
+std::vector<TraceMessage> loadTrace(const std::string & path)
+{
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("could not open " + path);
+  }
+  char magic[sizeof(BINARY_MAGIC)] = {};
+  in.read(magic, sizeof(magic));
+  if (in && std::memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0) {
+    return loadBinary(in);
+  }
+  in.clear();
+  in.seekg(0);
+  return loadCsv(in);
+}
+
+void writeBinary(const std::string & path, const std::vector<TraceMessage> & messages)
+{
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    throw std::runtime_error("could not open " + path);
+  }
+  out.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+  writeValue(out, BINARY_VERSION);
+  for (const TraceMessage & message : messages) {
+    for (const auto & entry : message.transforms) {
+      const geometry_msgs::msg::TransformStamped & transform = entry.first;
+      writeValue(out, message.receive_ns);
+      writeValue(out, static_cast<uint8_t>(entry.second ? 1 : 0));
+      writeValue(out, transform.header.stamp.sec);
+      writeValue(out, transform.header.stamp.nanosec);
+      writeValue(out, transform.transform.translation.x);
+      writeValue(out, transform.transform.translation.y);
+      writeValue(out, transform.transform.translation.z);
+      writeValue(out, transform.transform.rotation.x);
+      writeValue(out, transform.transform.rotation.y);
+      writeValue(out, transform.transform.rotation.z);
+      writeValue(out, transform.transform.rotation.w);
+      writeString(out, transform.header.frame_id);
+      writeString(out, transform.child_frame_id);
+    }
+  }
+}
+
+tf2::TimePoint stampOf(const geometry_msgs::msg::TransformStamped & transform)
+{
+  return tf2::TimePoint(
+    std::chrono::seconds(transform.header.stamp.sec) +
+    std::chrono::nanoseconds(transform.header.stamp.nanosec));
+}
+
+void runLookup(
+  const tf2::BufferCore & buffer, const LookupPair & pair, tf2::TimePoint time,
+  LookupStats & stats)
+{
+  auto start = std::chrono::steady_clock::now();
+  try {
+    buffer.lookupTransform(pair.target, pair.source, time);
+  } catch (const tf2::ConnectivityException &) {
+    ++stats.connectivity_errors;
+  } catch (const tf2::ExtrapolationException &) {
+    ++stats.extrapolation_errors;
+  } catch (const tf2::TransformException &) {
+    ++stats.lookup_errors;
+  }
+  stats.latencies_ns.push_back(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count());
+}
+
+void printPercentiles(const char * name, std::vector<int64_t> & samples)
+{
+  if (samples.empty()) {
+    printf("%s: no samples\n", name);
+    return;
+  }
+  std::sort(samples.begin(), samples.end());
+  auto percentile = [&samples](double p) {
+      size_t index = static_cast<size_t>(p * static_cast<double>(samples.size() - 1));
+      return static_cast<double>(samples[index]) / 1e3;
+    };
+  printf(
+    "%s latency (us): p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f  (%zu samples)\n",
+    name, percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999),
+    static_cast<double>(samples.back()) / 1e3, samples.size());
+}
+
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  Options options;
+  std::vector<TraceMessage> messages;
+  try {
+    if (!parseOptions(argc, argv, options)) {
+      usage();
+      return 1;
+    }
+    messages = loadTrace(options.trace);
+    if (!options.convert_to.empty()) {
+      writeBinary(options.convert_to, messages);
+      return 0;
+    }
+  } catch (const std::exception & ex) {
+    fprintf(stderr, "tf2_replay_benchmark: %s\n", ex.what());
+    return 2;
+  }
+  if (messages.empty()) {
+    fprintf(stderr, "tf2_replay_benchmark: trace %s is empty\n", options.trace.c_str());
+    return 2;
+  }
+
+  tf2::BufferCore buffer(options.cache_time);
+  std::atomic<int64_t> last_stamp_ns{0};
+  std::atomic<bool> done{false};
+
+  auto lookupTime = [&options, &last_stamp_ns]() {
+      if (options.lookup_time == LookupTime::Latest) {
+        return tf2::TimePointZero;
+      }
+      return tf2::TimePoint(std::chrono::nanoseconds(last_stamp_ns.load())) - options.lookup_delay;
+    };
+
+  std::vector<LookupStats> thread_stats(options.lookup_threads);
+  std::vector<std::thread> lookup_threads;
+  for (size_t t = 0; t < options.lookup_threads && !options.lookups.empty(); ++t) {
+    lookup_threads.emplace_back(
+      [&, t]() {
+        size_t n = 0;
+        while (!done.load()) {
+          runLookup(
+            buffer, options.lookups[n++ % options.lookups.size()], lookupTime(),
+            thread_stats[t]);
+        }
+      });
+  }
+
+  LookupStats inline_stats;
+  std::vector<int64_t> ingest_ns;
+  size_t transform_count = 0;
+  size_t rejected = 0;
+  size_t out_of_order = 0;
+  int64_t newest_stamp_ns = 0;
+  const bool interleave = options.lookup_threads == 0 && !options.lookups.empty();
+  size_t next_lookup = 0;
+
+  const auto replay_start = std::chrono::steady_clock::now();
+  const int64_t trace_start_ns = messages.front().receive_ns;
+  for (const TraceMessage & message : messages) {
+    if (options.recorded_speed) {
+      std::this_thread::sleep_until(
+        replay_start + std::chrono::nanoseconds(message.receive_ns - trace_start_ns));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (const auto & entry : message.transforms) {
+      if (!buffer.setTransform(entry.first, "tf2_replay_benchmark", entry.second)) {
+        ++rejected;
+      }
+    }
+    ingest_ns.push_back(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    transform_count += message.transforms.size();
+
+    for (const auto & entry : message.transforms) {
+      if (entry.second) {
+        continue;
+      }
+      int64_t stamp_ns = stampOf(entry.first).time_since_epoch().count();
+      if (stamp_ns < newest_stamp_ns) {
+        ++out_of_order;
+      }
+      newest_stamp_ns = std::max(newest_stamp_ns, stamp_ns);
+    }
+    last_stamp_ns.store(newest_stamp_ns);
+
+    if (interleave) {
+      for (size_t i = 0; i < options.lookups_per_message; ++i) {
+        runLookup(
+          buffer, options.lookups[next_lookup++ % options.lookups.size()], lookupTime(),
+          inline_stats);
+      }
+    }
+  }
+  const auto replay_end = std::chrono::steady_clock::now();
+
+  done.store(true);
+  for (std::thread & thread : lookup_threads) {
+    thread.join();
+  }
+
+  LookupStats lookups = std::move(inline_stats);
+  for (LookupStats & stats : thread_stats) {
+    lookups.latencies_ns.insert(
+      lookups.latencies_ns.end(), stats.latencies_ns.begin(), stats.latencies_ns.end());
+    lookups.lookup_errors += stats.lookup_errors;
+    lookups.connectivity_errors += stats.connectivity_errors;
+    lookups.extrapolation_errors += stats.extrapolation_errors;
+  }
+
+  const double elapsed_s = std::chrono::duration<double>(replay_end - replay_start).count();
+  printf(
+    "Replayed %zu messages (%zu transforms) in %.3f s: %.0f transforms/s\n",
+    messages.size(), transform_count, elapsed_s,
+    static_cast<double>(transform_count) / elapsed_s);
+  printf(
+    "Rejected transforms: %zu, out of order dynamic stamps: %zu\n", rejected, out_of_order);
+  printPercentiles("setTransform per message", ingest_ns);
+  if (!options.lookups.empty()) {
+    printf(
+      "Lookups: %zu, %.0f lookups/s, errors: %zu lookup, %zu connectivity, %zu extrapolation\n",
+      lookups.latencies_ns.size(), static_cast<double>(lookups.latencies_ns.size()) / elapsed_s,
+      lookups.lookup_errors, lookups.connectivity_errors, lookups.extrapolation_errors);
+    printPercentiles("lookupTransform", lookups.latencies_ns);
+  }
+  return 0;
+}
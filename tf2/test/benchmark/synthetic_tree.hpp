@@ -0,0 +1,173 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BENCHMARK__SYNTHETIC_TREE_HPP_
+#define BENCHMARK__SYNTHETIC_TREE_HPP_
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "geometry_msgs/msg/transform_stamped.hpp"
+
+#include "tf2/buffer_core.h"
+#include "tf2/time.h"
+
+namespace tf2_benchmark
+{
+
+/// Shape of a synthetic frame tree used to drive the benchmarks.
+struct SyntheticTreeConfig
+{
+  /// Number of frames in each branch below the root.
+  size_t depth = 8;
+  /// Number of independent branches hanging off the root.
+  size_t fan_out = 4;
+  /// Every n-th frame of a branch is published on /tf_static (0 for none).
+  size_t static_every = 0;
+  /// Cache time handed to the BufferCore.
+  tf2::Duration cache_time = tf2::BUFFER_CORE_DEFAULT_CACHE_TIME;
+  /// Publish rate of the dynamic frames.
+  double rate_hz = 100.0;
+};
+
+/// Builds a frame tree of `fan_out` chains of `depth` frames each, rooted at "world".
+/**
+ * Frames are named "b<branch>_l<level>", with level 0 attached to "world".
+ * Dynamic frames wobble slowly so that interpolation does real work.
+ */
+class SyntheticTree
+{
+public:
+  explicit SyntheticTree(const SyntheticTreeConfig & config)
+  : config_(config),
+    period_(std::chrono::duration_cast<tf2::Duration>(
+        std::chrono::duration<double>(1.0 / config.rate_hz))),
+    start_(tf2::timeFromSec(1000.0))
+  {
+    for (size_t branch = 0; branch < config_.fan_out; ++branch) {
+      std::string parent = root();
+      for (size_t level = 0; level < config_.depth; ++level) {
+        Link link;
+        link.parent = parent;
+        link.child = frameName(branch, level);
+        link.is_static = config_.static_every != 0 && (level + 1) % config_.static_every == 0;
+        links_.push_back(link);
+        parent = link.child;
+      }
+    }
+  }
+
+  const std::string & root() const
+  {
+    static const std::string root_name = "world";
+    return root_name;
+  }
+
+  static std::string frameName(size_t branch, size_t level)
+  {
+    return "b" + std::to_string(branch) + "_l" + std::to_string(level);
+  }
+
+  /// The deepest frame of a branch.
+  std::string leaf(size_t branch) const
+  {
+    return frameName(branch % config_.fan_out, config_.depth - 1);
+  }
+
+  size_t frameCount() const {return links_.size();}
+
+  tf2::Duration period() const {return period_;}
+
+  /// Timestamp of the n-th publication.
+  tf2::TimePoint stamp(size_t tick) const
+  {
+    return start_ + period_ * static_cast<int64_t>(tick);
+  }
+
+  /// Number of publications needed to fill the cache window once.
+  size_t ticksPerCacheWindow() const
+  {
+    return static_cast<size_t>(config_.cache_time / period_);
+  }
+
+  const SyntheticTreeConfig & config() const {return config_;}
+
+  /// The message for link `index` published at publication `tick`.
+  geometry_msgs::msg::TransformStamped message(size_t index, size_t tick) const
+  {
+    const Link & link = links_[index];
+    const double phase = 0.01 * static_cast<double>(tick) + static_cast<double>(index);
+    const double yaw = link.is_static ? 0.1 : 0.1 + 0.05 * std::sin(phase);
+
+    geometry_msgs::msg::TransformStamped msg;
+    std::chrono::nanoseconds ns = stamp(link.is_static ? 0 : tick).time_since_epoch();
+    msg.header.stamp.sec = static_cast<int32_t>(ns.count() / 1000000000);
+    msg.header.stamp.nanosec = static_cast<uint32_t>(ns.count() % 1000000000);
+    msg.header.frame_id = link.parent;
+    msg.child_frame_id = link.child;
+    msg.transform.translation.x = 0.1;
+    msg.transform.translation.y = link.is_static ? 0.0 : 0.01 * std::cos(phase);
+    msg.transform.translation.z = 0.05;
+    msg.transform.rotation.x = 0.0;
+    msg.transform.rotation.y = 0.0;
+    msg.transform.rotation.z = std::sin(yaw / 2.0);
+    msg.transform.rotation.w = std::cos(yaw / 2.0);
+    return msg;
+  }
+
+  bool isStatic(size_t index) const {return links_[index].is_static;}
+
+  /// Publish every static link once and every dynamic link for ticks [first, last).
+  void publish(tf2::BufferCore & buffer, size_t first, size_t last) const
+  {
+    for (size_t index = 0; index < links_.size(); ++index) {
+      if (links_[index].is_static && first == 0) {
+        buffer.setTransform(message(index, 0), "benchmark", true);
+      }
+    }
+    for (size_t tick = first; tick < last; ++tick) {
+      for (size_t index = 0; index < links_.size(); ++index) {
+        if (!links_[index].is_static) {
+          buffer.setTransform(message(index, tick), "benchmark", false);
+        }
+      }
+    }
+  }
+
+  /// Fill a buffer with a full cache window of history.
+  void fill(tf2::BufferCore & buffer) const
+  {
+    publish(buffer, 0, ticksPerCacheWindow());
+  }
+
+private:
+  struct Link
+  {
+    std::string parent;
+    std::string child;
+    bool is_static;
+  };
+
+  SyntheticTreeConfig config_;
+  tf2::Duration period_;
+  tf2::TimePoint start_;
+  std::vector<Link> links_;
+};
+
+}  // namespace tf2_benchmark
+
+#endif  // BENCHMARK__SYNTHETIC_TREE_HPP_
@@ -28,6 +28,7 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <stdexcept>
@@ -299,6 +300,58 @@ TEST(TimeCache, AngularInterpolation)
   }
 }
 
+TEST(TimeCache, NlerpInterpolation)
+{
+  uint64_t offset = 200;
+  tf2::TimeCache cache;
+  cache.setInterpolationPolicy(tf2::InterpolationPolicy::Nlerp, 0.5);
+
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  stor.frame_id_ = 3;
+
+  // Within the threshold the error stays under the documented bound, whichever sign the
+  // quaternions are stored with
+  for (double theta : {0.001, 0.01, 0.1, 0.5}) {
+    for (double sign : {1.0, -1.0}) {
+      std::vector<tf2::Quaternion> quats(2);
+      quats[0].setRPY(0.3, -0.2, 0.1);
+      quats[1] = quats[0] * tf2::Quaternion(tf2::Vector3(1.0, 2.0, 3.0).normalized(), theta);
+      quats[1] *= sign;
+      for (uint64_t step = 0; step < 2; step++) {
+        stor.rotation_ = quats[step];
+        stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(offset + step * 100));
+        cache.insertData(stor);
+      }
+
+      double max_error = 0.0;
+      for (int pos = 0; pos <= 100; pos++) {
+        EXPECT_TRUE(cache.getData(tf2::TimePoint(std::chrono::nanoseconds(offset + pos)), stor));
+        tf2::Quaternion ground_truth = quats[0].slerp(quats[1], pos / 100.0);
+        // acos is too coarse near zero, measure the angle of the difference from its sine
+        tf2::Quaternion difference = ground_truth.inverse() * stor.rotation_;
+        double sine = tf2::Vector3(difference.x(), difference.y(), difference.z()).length();
+        double error = 2.0 * std::asin(std::min(1.0, sine));
+        max_error = std::max(max_error, error);
+      }
+      EXPECT_LT(max_error, std::pow(theta, 3) / 240.0 + 1e-12);
+      cache.clearList();
+    }
+  }
+
+  // Above the threshold it falls back on slerp
+  std::vector<tf2::Quaternion> quats(2);
+  quats[0].setRPY(0.0, 0.0, 0.0);
+  quats[1].setRPY(0.0, 0.0, 1.0);
+  for (uint64_t step = 0; step < 2; step++) {
+    stor.rotation_ = quats[step];
+    stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(offset + step * 100));
+    cache.insertData(stor);
+  }
+  EXPECT_TRUE(cache.getData(tf2::TimePoint(std::chrono::nanoseconds(offset + 25)), stor));
+  EXPECT_NEAR(0.0, quats[0].slerp(quats[1], 0.25).angleShortestPath(stor.rotation_), 1e-12);
+}
+
 TEST(TimeCache, DuplicateEntries)
 {
   tf2::TimeCache cache;
@@ -323,6 +376,189 @@ TEST(TimeCache, DuplicateEntries)
   EXPECT_TRUE(!std::isnan(stor.rotation_.w()));
 }
 
+TEST(TimeCache, TruncateAfter)
+{
+  tf2::TimeCache cache;
+
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  for (uint64_t i = 1; i <= 10; i++) {
+    stor.frame_id_ = tf2::CompactFrameID(i);
+    stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(i * 100));
+    cache.insertData(stor);
+  }
+
+  cache.truncateAfter(tf2::TimePoint(std::chrono::nanoseconds(550)));
+  EXPECT_EQ(5u, cache.getListLength());
+  EXPECT_EQ(tf2::TimePoint(std::chrono::nanoseconds(500)), cache.getLatestTimestamp());
+  EXPECT_EQ(tf2::TimePoint(std::chrono::nanoseconds(100)), cache.getOldestTimestamp());
+
+  // Data stamped at the truncation time is kept
+  cache.truncateAfter(tf2::TimePoint(std::chrono::nanoseconds(300)));
+  EXPECT_EQ(3u, cache.getListLength());
+  EXPECT_TRUE(cache.getData(tf2::TimePoint(std::chrono::nanoseconds(300)), stor));
+  EXPECT_EQ(3u, stor.frame_id_);
+
+  // New data after the truncation point is accepted again
+  stor.frame_id_ = 11;
+  stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(400));
+  EXPECT_TRUE(cache.insertData(stor));
+  EXPECT_EQ(4u, cache.getListLength());
+
+  cache.truncateAfter(tf2::TimePoint(std::chrono::nanoseconds(0)));
+  EXPECT_EQ(0u, cache.getListLength());
+}
+
+TEST(TimeCache, Prediction)
+{
+  double epsilon = 1e-6;
+  tf2::TimeCache cache;
+
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  stor.frame_id_ = 3;
+  stor.translation_.setValue(1.0, 0.0, 0.0);
+  stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(100));
+  cache.insertData(stor);
+
+  // A single value is held
+  cache.setPredictionHorizon(tf2::Duration(std::chrono::nanoseconds(50)));
+  uint64_t predictions = tf2::TimeCache::getThreadPredictions();
+  EXPECT_TRUE(cache.getData(tf2::TimePoint(std::chrono::nanoseconds(150)), stor));
+  EXPECT_NEAR(1.0, stor.translation_.x(), epsilon);
+  EXPECT_EQ(predictions + 1, tf2::TimeCache::getThreadPredictions());
+
+  stor.translation_.setValue(2.0, 0.0, 0.0);
+  stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(200));
+  cache.insertData(stor);
+
+  // Two values give the velocity
+  EXPECT_TRUE(cache.getData(tf2::TimePoint(std::chrono::nanoseconds(250)), stor));
+  EXPECT_NEAR(2.5, stor.translation_.x(), epsilon);
+  EXPECT_EQ(predictions + 2, tf2::TimeCache::getThreadPredictions());
+
+  // Interpolation is not a prediction
+  EXPECT_TRUE(cache.getData(tf2::TimePoint(std::chrono::nanoseconds(150)), stor));
+  EXPECT_EQ(predictions + 2, tf2::TimeCache::getThreadPredictions());
+
+  // Nor is anything beyond the horizon
+  EXPECT_FALSE(cache.getData(tf2::TimePoint(std::chrono::nanoseconds(251)), stor));
+  EXPECT_EQ(predictions + 2, tf2::TimeCache::getThreadPredictions());
+
+  // Reparented data is held rather than extrapolated across parents
+  stor.frame_id_ = 4;
+  stor.translation_.setValue(5.0, 0.0, 0.0);
+  stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(300));
+  cache.insertData(stor);
+  EXPECT_TRUE(cache.getData(tf2::TimePoint(std::chrono::nanoseconds(330)), stor));
+  EXPECT_NEAR(5.0, stor.translation_.x(), epsilon);
+  EXPECT_EQ(4u, cache.getParent(tf2::TimePoint(std::chrono::nanoseconds(330)), nullptr));
+
+  cache.setPredictionHorizon(tf2::Duration::zero());
+  EXPECT_FALSE(cache.getData(tf2::TimePoint(std::chrono::nanoseconds(330)), stor));
+}
+
+TEST(TimeCache, ReorderWindow)
+{
+  tf2::TimeCache staged;
+  staged.setReorderWindow(4);
+  tf2::TimeCache direct;
+
+  // Every seventh entry arrives late, some behind several others
+  std::vector<int64_t> order;
+  for (int64_t i = 1; i <= 60; i++) {
+    if (i % 7 != 0) {
+      order.push_back(i);
+    }
+    if (i % 7 == 3 && i > 7) {
+      order.push_back(i - 3);
+    }
+  }
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  for (int64_t i : order) {
+    stor.frame_id_ = i < 30 ? 1 : 2;
+    stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(i * 100));
+    stor.translation_.setValue(static_cast<double>(i), 0.0, 0.0);
+    EXPECT_TRUE(staged.insertData(stor));
+    EXPECT_TRUE(direct.insertData(stor));
+
+    // Staged entries are found before they are merged
+    EXPECT_EQ(direct.getListLength(), staged.getListLength());
+    EXPECT_EQ(direct.getOldestTimestamp(), staged.getOldestTimestamp());
+    EXPECT_EQ(direct.getLatestTimeAndParent(), staged.getLatestTimeAndParent());
+    for (int64_t t = 0; t <= 6100; t += 50) {
+      tf2::TransformStorage expected;
+      tf2::TransformStorage out;
+      tf2::TimePoint time = tf2::TimePoint(std::chrono::nanoseconds(t));
+      ASSERT_EQ(direct.getData(time, expected), staged.getData(time, out)) << t;
+      EXPECT_EQ(expected.translation_.x(), out.translation_.x()) << t;
+      EXPECT_EQ(expected.frame_id_, out.frame_id_) << t;
+    }
+  }
+
+  std::vector<tf2::TransformStorage> expected;
+  std::vector<tf2::TransformStorage> out;
+  direct.getDataSince(tf2::TimePoint(std::chrono::nanoseconds(1000)), expected);
+  staged.getDataSince(tf2::TimePoint(std::chrono::nanoseconds(1000)), out);
+  ASSERT_EQ(expected.size(), out.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_EQ(expected[i].stamp_, out[i].stamp_);
+  }
+
+  // Predictions extrapolate from a staged second latest entry too
+  staged.setPredictionHorizon(tf2::Duration(std::chrono::nanoseconds(100)));
+  stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(7000));
+  stor.translation_.setValue(70.0, 0.0, 0.0);
+  EXPECT_TRUE(staged.insertData(stor));
+  stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(6900));
+  stor.translation_.setValue(69.0, 0.0, 0.0);
+  EXPECT_TRUE(staged.insertData(stor));
+  EXPECT_TRUE(staged.getData(tf2::TimePoint(std::chrono::nanoseconds(7050)), stor));
+  EXPECT_DOUBLE_EQ(70.5, stor.translation_.x());
+
+  staged.clearList();
+  EXPECT_EQ(0u, staged.getListLength());
+}
+
+TEST(TimeCache, CompactStorage)
+{
+  EXPECT_LT(sizeof(tf2::CompactTransformStorage), sizeof(tf2::TransformStorage));
+
+  double epsilon = 1e-6;
+  tf2::CompactTimeCache cache;
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  stor.frame_id_ = 3;
+  stor.child_frame_id_ = 4;
+
+  // The endpoints round trip to float precision
+  stor.translation_.setValue(1.0, 2.0, 3.0);
+  stor.rotation_.setRPY(0.0, 0.0, 0.1);
+  stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(100));
+  EXPECT_TRUE(cache.insertData(stor));
+  stor.translation_.setValue(3.0, 2.0, 1.0);
+  stor.rotation_.setRPY(0.0, 0.0, 0.3);
+  stor.stamp_ = tf2::TimePoint(std::chrono::nanoseconds(200));
+  EXPECT_TRUE(cache.insertData(stor));
+
+  tf2::TransformStorage out;
+  EXPECT_TRUE(cache.getData(tf2::TimePoint(std::chrono::nanoseconds(100)), out));
+  EXPECT_NEAR(1.0, out.translation_.x(), epsilon);
+  EXPECT_NEAR(3.0, out.translation_.z(), epsilon);
+  EXPECT_NEAR(0.1, out.rotation_.getAngle(), epsilon);
+  EXPECT_NEAR(1.0, out.rotation_.length(), epsilon);
+  EXPECT_EQ(3u, out.frame_id_);
+  EXPECT_EQ(4u, out.child_frame_id_);
+  EXPECT_EQ(tf2::TimePoint(std::chrono::nanoseconds(100)), out.stamp_);
+
+  // Interpolation happens in double precision between the widened endpoints
+  EXPECT_TRUE(cache.getData(tf2::TimePoint(std::chrono::nanoseconds(150)), out));
+  EXPECT_NEAR(2.0, out.translation_.x(), epsilon);
+  EXPECT_NEAR(2.0, out.translation_.z(), epsilon);
+  EXPECT_NEAR(0.2, out.rotation_.getAngle(), epsilon);
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -31,15 +31,23 @@
 #include <algorithm>
 #include <array>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
 #include <numeric>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "builtin_interfaces/msg/time.hpp"
 #include "geometry_msgs/msg/transform_stamped.hpp"
+#include "geometry_msgs/msg/twist_stamped.hpp"
 
 #include "tf2/buffer_core.h"
+#include "tf2/buffer_core_statistics.h"
 #include "tf2/convert.h"
+#include "tf2/LinearMath/Quaternion.h"
+#include "tf2/LinearMath/Transform.h"
 #include "tf2/LinearMath/Vector3.h"
 #include "tf2/exceptions.h"
 #include "tf2/time.h"
@@ -115,6 +123,103 @@ TEST(tf2, setTransformValidWithCallback)
   EXPECT_TRUE(transform_available);
 }
 
+TEST(tf2, setTransformValidWithTransformCallback)
+{
+  tf2::BufferCore buffer;
+  const tf2::TimePoint time_point = tf2::timeFromSec(1.0);
+
+  geometry_msgs::msg::TransformStamped received;
+  bool transform_available = false;
+  auto cb =
+    [&received, &transform_available](
+    tf2::TransformableRequestHandle request_handle,
+    const geometry_msgs::msg::TransformStamped & transform,
+    tf2::TransformableResult result)
+    {
+      (void)request_handle;
+      received = transform;
+      transform_available = tf2::TransformAvailable == result;
+    };
+
+  geometry_msgs::msg::TransformStamped immediate;
+  ASSERT_NE(buffer.addTransformableRequest(cb, "foo", "bar", time_point, immediate), 0u);
+
+  geometry_msgs::msg::TransformStamped transform_msg;
+  transform_msg.header.frame_id = "foo";
+  transform_msg.header.stamp.sec = 1;
+  transform_msg.child_frame_id = "bar";
+  transform_msg.transform.translation.x = 2;
+  transform_msg.transform.rotation.w = 1;
+  EXPECT_TRUE(buffer.setTransform(transform_msg, "authority1"));
+
+  // The transform found by the check is handed over, without another lookup
+  EXPECT_TRUE(transform_available);
+  EXPECT_EQ(received.header.frame_id, "foo");
+  EXPECT_EQ(received.child_frame_id, "bar");
+  EXPECT_EQ(received.header.stamp.sec, 1);
+  EXPECT_DOUBLE_EQ(received.transform.translation.x, 2);
+
+  // Requests that are already transformable return 0 and the transform right away
+  EXPECT_EQ(buffer.addTransformableRequest(cb, "bar", "foo", time_point, immediate), 0u);
+  EXPECT_EQ(immediate.header.frame_id, "bar");
+  EXPECT_EQ(immediate.child_frame_id, "foo");
+  EXPECT_DOUBLE_EQ(immediate.transform.translation.x, -2);
+  EXPECT_EQ(buffer.addTransformableRequest(cb, "bar", "bar", tf2::TimePointZero, immediate), 0u);
+  EXPECT_EQ(immediate.header.stamp.sec, 1);
+  EXPECT_DOUBLE_EQ(immediate.transform.translation.x, 0);
+}
+
+TEST(tf2, setTransformDeferredCallbacks)
+{
+  tf2::BufferCore buffer;
+  std::vector<std::function<void()>> tasks;
+  buffer.setTransformableCallbackExecutor(
+    [&tasks](std::function<void()> task) {tasks.push_back(std::move(task));});
+
+  int calls = 0;
+  tf2::TransformableRequestHandle nested_handle = 0;
+  geometry_msgs::msg::TransformStamped immediate;
+  auto cb = [&](
+    tf2::TransformableRequestHandle request_handle,
+    const geometry_msgs::msg::TransformStamped & transform, tf2::TransformableResult result)
+    {
+      (void)request_handle;
+      (void)transform;
+      EXPECT_EQ(result, tf2::TransformAvailable);
+      ++calls;
+      // The buffer is not locked anymore, so callbacks may add requests of their own
+      nested_handle = buffer.addTransformableRequest(
+        [](tf2::TransformableRequestHandle, const geometry_msgs::msg::TransformStamped &,
+        tf2::TransformableResult) {}, "foo", "baz", tf2::timeFromSec(1.0), immediate);
+    };
+  tf2::TransformableRequestHandle kept = buffer.addTransformableRequest(
+    cb, "foo", "bar", tf2::timeFromSec(1.0), immediate);
+  tf2::TransformableRequestHandle cancelled = buffer.addTransformableRequest(
+    cb, "bar", "foo", tf2::timeFromSec(1.0), immediate);
+  ASSERT_NE(kept, 0u);
+  ASSERT_NE(cancelled, 0u);
+
+  geometry_msgs::msg::TransformStamped transform_msg;
+  transform_msg.header.frame_id = "foo";
+  transform_msg.header.stamp.sec = 1;
+  transform_msg.child_frame_id = "bar";
+  transform_msg.transform.rotation.w = 1;
+  EXPECT_TRUE(buffer.setTransform(transform_msg, "authority1"));
+
+  // Both requests are satisfied, but their callbacks only run on the executor
+  ASSERT_EQ(tasks.size(), 2u);
+  EXPECT_EQ(calls, 0);
+
+  // Cancelling a satisfied request drops the callback that did not run yet
+  buffer.cancelTransformableRequest(cancelled);
+  for (auto & task : tasks) {
+    task();
+  }
+  EXPECT_EQ(calls, 1);
+  EXPECT_NE(nested_handle, 0u);
+  buffer.cancelTransformableRequest(nested_handle);
+}
+
 TEST(tf2, setTransformInvalidQuaternion)
 {
   tf2::BufferCore tfc;
@@ -210,6 +315,48 @@ TEST(tf2_lookupTransform, TransformException_Backward_Forward)
           4))), tf2::ForwardExtrapolationException);
 }
 
+TEST(tf2_lookupTransform, Fixed_Frame_Time_Travel)
+{
+  tf2::BufferCore tfc;
+  geometry_msgs::msg::TransformStamped st;
+  st.transform.rotation.w = 1;
+  // base_link drives along x at 1 m/s, the laser sits 0.5 m ahead of it
+  for (int32_t sec = 1; sec <= 3; ++sec) {
+    st.header.stamp.sec = sec;
+    st.header.frame_id = "odom";
+    st.child_frame_id = "base_link";
+    st.transform.translation.x = sec;
+    EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+    st.header.frame_id = "base_link";
+    st.child_frame_id = "laser";
+    st.transform.translation.x = 0.5;
+    EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+  }
+  tf2::TimePoint one = tf2::timeFromSec(1.0);
+  tf2::TimePoint three = tf2::timeFromSec(3.0);
+
+  // Where the laser was at 1s, seen from base_link at 3s
+  geometry_msgs::msg::TransformStamped out =
+    tfc.lookupTransform("base_link", three, "laser", one, "odom");
+  EXPECT_DOUBLE_EQ(-1.5, out.transform.translation.x);
+  EXPECT_EQ(3, out.header.stamp.sec);
+  EXPECT_TRUE(tfc.canTransform("base_link", three, "laser", one, "odom"));
+
+  // Either end may be the fixed frame
+  EXPECT_DOUBLE_EQ(
+    1.0, tfc.lookupTransform("odom", one, "base_link", one, "odom").transform.translation.x);
+  EXPECT_EQ(
+    3, tfc.lookupTransform(
+      "base_link", tf2::TimePointZero, "laser", one, "base_link").header.stamp.sec);
+
+  EXPECT_FALSE(tfc.canTransform("base_link", tf2::timeFromSec(4.0), "laser", one, "odom"));
+  EXPECT_THROW(
+    tfc.lookupTransform("base_link", three, "laser", tf2::timeFromSec(0.5), "odom"),
+    tf2::ExtrapolationException);
+  EXPECT_THROW(
+    tfc.lookupTransform("base_link", three, "laser", one, "map"), tf2::LookupException);
+}
+
 TEST(tf2_canTransform, One_Exists)
 {
   tf2::BufferCore tfc;
@@ -224,6 +371,45 @@ TEST(tf2_canTransform, One_Exists)
   EXPECT_FALSE(tfc.canTransform("foo", "bar", tf2::TimePoint(std::chrono::seconds(1))));
 }
 
+TEST(tf2_canTransform, All_Targets)
+{
+  tf2::BufferCore tfc;
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "map";
+  st.child_frame_id = "odom";
+  st.transform.rotation.w = 1;
+  for (int32_t sec : {1, 3}) {
+    st.header.stamp.sec = sec;
+    EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+  }
+  st.header.frame_id = "odom";
+  st.child_frame_id = "base_link";
+  for (int32_t sec : {1, 2}) {
+    st.header.stamp.sec = sec;
+    EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+  }
+  st.header.frame_id = "other";
+  st.child_frame_id = "island";
+  EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+
+  const tf2::TimePoint times[] = {
+    tf2::timeFromSec(1.5), tf2::timeFromSec(2), tf2::timeFromSec(2.5)};
+  std::string error;
+  EXPECT_TRUE(tfc.canTransformAll({"map", "odom", "base_link"}, "base_link", times, 2, &error));
+  EXPECT_TRUE(tfc.canTransformAll({"ghost"}, "ghost", times, 2));
+  EXPECT_TRUE(tfc.canTransformAll({}, "base_link", times, 2));
+
+  // Every target at every time has to be possible
+  EXPECT_FALSE(tfc.canTransformAll({"map", "odom"}, "base_link", times, 3, &error));
+  EXPECT_FALSE(error.empty());
+  error.clear();
+  EXPECT_FALSE(tfc.canTransformAll({"map", "island"}, "base_link", times, 2, &error));
+  EXPECT_FALSE(error.empty());
+  error.clear();
+  EXPECT_FALSE(tfc.canTransformAll({"map", "ghost"}, "base_link", times, 2, &error));
+  EXPECT_FALSE(error.empty());
+}
+
 TEST(tf2_clear, LookUp_Static_Transfrom_Succeed)
 {
   tf2::BufferCore tfc;
@@ -259,6 +445,575 @@ TEST(tf2_clear, LookUp_Static_Transfrom_Fail)
   );
 }
 
+TEST(tf2_rollbackTo, Keeps_Static_And_Older_Data)
+{
+  tf2::BufferCore tfc;
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "foo";
+  st.child_frame_id = "bar";
+  st.transform.rotation.w = 1;
+  for (int32_t sec = 1; sec <= 5; ++sec) {
+    st.header.stamp.sec = sec;
+    EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+  }
+  st.header.frame_id = "bar";
+  st.child_frame_id = "baz";
+  st.header.stamp.sec = 4;
+  EXPECT_TRUE(tfc.setTransform(st, "authority1", true));
+
+  tfc.rollbackTo(tf2::timeFromSec(3.0));
+
+  EXPECT_TRUE(tfc.canTransform("foo", "bar", tf2::timeFromSec(2.5)));
+  EXPECT_FALSE(tfc.canTransform("foo", "bar", tf2::timeFromSec(3.5)));
+  EXPECT_TRUE(tfc.canTransform("foo", "baz", tf2::timeFromSec(2.5)));
+  EXPECT_EQ(3, tfc.lookupTransform("foo", "bar", tf2::TimePointZero).header.stamp.sec);
+
+  // Data after the rollback point is accepted again
+  st.header.frame_id = "foo";
+  st.child_frame_id = "bar";
+  st.header.stamp.sec = 4;
+  EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+  EXPECT_TRUE(tfc.canTransform("foo", "bar", tf2::timeFromSec(3.5)));
+}
+
+TEST(tf2_prediction, Flags_Predicted_Lookups)
+{
+  tf2::BufferCore tfc;
+  // Set before the frame exists, it applies once it does
+  tfc.setPredictionHorizon("/bar", tf2::durationFromSec(0.5));
+
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "foo";
+  st.child_frame_id = "bar";
+  st.transform.rotation.w = 1;
+  for (int32_t sec = 1; sec <= 2; ++sec) {
+    st.header.stamp.sec = sec;
+    st.transform.translation.x = sec;
+    EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+  }
+
+  bool predicted = true;
+  geometry_msgs::msg::TransformStamped out =
+    tfc.lookupTransform("foo", "bar", tf2::timeFromSec(1.5), predicted);
+  EXPECT_DOUBLE_EQ(1.5, out.transform.translation.x);
+  EXPECT_FALSE(predicted);
+  out = tfc.lookupTransform("foo", "bar", tf2::timeFromSec(2.25), predicted);
+  EXPECT_DOUBLE_EQ(2.25, out.transform.translation.x);
+  EXPECT_TRUE(predicted);
+  EXPECT_TRUE(tfc.canTransform("bar", "foo", tf2::timeFromSec(2.5)));
+  EXPECT_FALSE(tfc.canTransform("bar", "foo", tf2::timeFromSec(2.6)));
+
+  tfc.setPredictionHorizon("bar", tf2::Duration::zero());
+  EXPECT_FALSE(tfc.canTransform("bar", "foo", tf2::timeFromSec(2.25)));
+  EXPECT_THROW(
+    tfc.setPredictionHorizon("", tf2::durationFromSec(1.0)), tf2::InvalidArgumentException);
+}
+
+TEST(tf2_storagePrecision, Single_Matches_Double)
+{
+  tf2::BufferCore single(tf2::BUFFER_CORE_DEFAULT_CACHE_TIME, tf2::StoragePrecision::Single);
+  tf2::BufferCore reference;
+
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "map";
+  st.child_frame_id = "odom";
+  st.transform.translation.x = 1000.125;
+  st.transform.rotation.w = 1;
+  for (int32_t sec = 1; sec <= 2; ++sec) {
+    st.header.stamp.sec = sec;
+    EXPECT_TRUE(single.setTransform(st, "authority1", true));
+    EXPECT_TRUE(reference.setTransform(st, "authority1", true));
+  }
+  st.header.frame_id = "odom";
+  st.child_frame_id = "base";
+  for (int32_t sec = 1; sec <= 2; ++sec) {
+    st.header.stamp.sec = sec;
+    st.transform.translation.y = 0.5 * sec;
+    st.transform.rotation.z = std::sin(0.25 * sec);
+    st.transform.rotation.w = std::cos(0.25 * sec);
+    EXPECT_TRUE(single.setTransform(st, "authority1"));
+    EXPECT_TRUE(reference.setTransform(st, "authority1"));
+  }
+
+  geometry_msgs::msg::TransformStamped expected =
+    reference.lookupTransform("map", "base", tf2::timeFromSec(1.5));
+  geometry_msgs::msg::TransformStamped out =
+    single.lookupTransform("map", "base", tf2::timeFromSec(1.5));
+  EXPECT_NEAR(expected.transform.translation.x, out.transform.translation.x, 1e-4);
+  EXPECT_NEAR(expected.transform.translation.y, out.transform.translation.y, 1e-6);
+  EXPECT_NEAR(expected.transform.rotation.z, out.transform.rotation.z, 1e-6);
+  EXPECT_NEAR(expected.transform.rotation.w, out.transform.rotation.w, 1e-6);
+}
+
+TEST(tf2_namespaces, Lookup_Through_Shared_Frame)
+{
+  tf2::BufferCore tfc;
+  tfc.addSharedFrame("world");
+  EXPECT_EQ("robot1/base_link", tfc.namespacedFrameId("/robot1/", "base_link"));
+  EXPECT_EQ("world", tfc.namespacedFrameId("robot1", "/world"));
+  EXPECT_EQ("base_link", tfc.namespacedFrameId("", "base_link"));
+
+  geometry_msgs::msg::TransformStamped st;
+  st.header.stamp.sec = 1;
+  st.transform.rotation.w = 1;
+  for (int robot = 1; robot <= 2; ++robot) {
+    const std::string tf_namespace = "robot" + std::to_string(robot);
+    st.header.frame_id = "world";
+    st.child_frame_id = "base_link";
+    st.transform.translation.x = robot;
+    EXPECT_TRUE(tfc.setTransform(st, "authority1", false, tf_namespace));
+    // Identical sensor mounts
+    st.header.frame_id = "base_link";
+    st.child_frame_id = "laser";
+    st.transform.translation.x = 0.5;
+    EXPECT_TRUE(tfc.setTransform(st, "authority1", true, tf_namespace));
+  }
+
+  EXPECT_FALSE(tfc._frameExists("base_link"));
+  geometry_msgs::msg::TransformStamped out =
+    tfc.lookupTransform("robot1/laser", "robot2/laser", tf2::TimePointZero);
+  EXPECT_DOUBLE_EQ(1.0, out.transform.translation.x);
+  out = tfc.lookupTransform("world", "robot2/laser", tf2::TimePointZero);
+  EXPECT_DOUBLE_EQ(2.5, out.transform.translation.x);
+
+  // Changing a shared static transform only changes it in its own namespace
+  st.transform.translation.x = 0.75;
+  EXPECT_TRUE(tfc.setTransform(st, "authority1", true, "robot2"));
+  out = tfc.lookupTransform("world", "robot1/laser", tf2::TimePointZero);
+  EXPECT_DOUBLE_EQ(1.5, out.transform.translation.x);
+  out = tfc.lookupTransform("world", "robot2/laser", tf2::TimePointZero);
+  EXPECT_DOUBLE_EQ(2.75, out.transform.translation.x);
+}
+
+TEST(tf2_shards, Lookups_Across_Shards)
+{
+  tf2::BufferCore tfc;
+  EXPECT_THROW(tfc.addShard(""), tf2::InvalidArgumentException);
+  tfc.addShard("arm");
+  tfc.addShard("/head");
+
+  geometry_msgs::msg::TransformStamped st;
+  st.transform.rotation.w = 1;
+  const std::pair<const char *, const char *> links[] = {
+    {"world", "base"}, {"base", "arm"}, {"arm", "hand"}, {"base", "head"}, {"head", "camera"}};
+  for (int32_t sec = 1; sec <= 2; ++sec) {
+    st.header.stamp.sec = sec;
+    for (const auto & link : links) {
+      st.header.frame_id = link.first;
+      st.child_frame_id = link.second;
+      st.transform.translation.x = sec;
+      EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+    }
+  }
+
+  // Between frames of different shards, and within one
+  tf2::TimePoint time = tf2::TimePoint(std::chrono::milliseconds(1500));
+  EXPECT_DOUBLE_EQ(
+    0.0, tfc.lookupTransform("hand", "camera", time).transform.translation.x);
+  EXPECT_DOUBLE_EQ(
+    4.5, tfc.lookupTransform("world", "hand", time).transform.translation.x);
+  EXPECT_DOUBLE_EQ(
+    4.0, tfc.lookupTransform("base", "hand", tf2::TimePointZero).transform.translation.x);
+  EXPECT_TRUE(tfc.canTransform("camera", "hand", time));
+
+  // The camera moves to the hand, lookups in the past still go through the head
+  st.header.frame_id = "hand";
+  st.child_frame_id = "camera";
+  st.transform.translation.x = 0.25;
+  for (int32_t sec = 3; sec <= 4; ++sec) {
+    st.header.stamp.sec = sec;
+    EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+  }
+  tf2::Transform transform;
+  tf2::TimePoint time_out;
+  EXPECT_EQ(
+    tf2::TF2Error::TF2_NO_ERROR,
+    tfc.lookupTransform("head", "camera", time, transform, time_out));
+  EXPECT_DOUBLE_EQ(1.5, transform.getOrigin().x());
+  EXPECT_DOUBLE_EQ(
+    0.25, tfc.lookupTransform(
+      "hand", "camera", tf2::TimePoint(std::chrono::milliseconds(3500))).transform.translation.x);
+
+  for (int shard = 3; shard < 64; ++shard) {
+    tfc.addShard("root" + std::to_string(shard));
+  }
+  EXPECT_THROW(tfc.addShard("one_too_many"), tf2::InvalidArgumentException);
+  tfc.addShard("arm");
+}
+
+TEST(tf2_frameLinks, Loops_And_Common_Ancestors)
+{
+  tf2::BufferCore tfc;
+  geometry_msgs::msg::TransformStamped st;
+  st.transform.rotation.w = 1;
+  st.transform.translation.x = 1;
+  auto link = [&](const char * parent, const char * child, int32_t sec) {
+      st.header.frame_id = parent;
+      st.child_frame_id = child;
+      st.header.stamp.sec = sec;
+      return tfc.setTransform(st, "authority1");
+    };
+  for (int32_t sec = 1; sec <= 2; ++sec) {
+    EXPECT_TRUE(link("map", "odom", sec));
+    EXPECT_TRUE(link("odom", "base", sec));
+    EXPECT_TRUE(link("base", "laser", sec));
+    EXPECT_TRUE(link("base", "camera", sec));
+  }
+  tf2::TimePoint time = tf2::TimePoint(std::chrono::milliseconds(1500));
+  EXPECT_DOUBLE_EQ(0.0, tfc.lookupTransform("laser", "camera", time).transform.translation.x);
+  EXPECT_DOUBLE_EQ(-2.0, tfc.lookupTransform("laser", "odom", time).transform.translation.x);
+  EXPECT_DOUBLE_EQ(2.0, tfc.lookupTransform("odom", "laser", time).transform.translation.x);
+  EXPECT_EQ(
+    2, tfc.lookupTransform("map", "camera", tf2::TimePointZero).header.stamp.sec);
+
+  // Closing a loop makes the frames on it unreachable, until it is broken again
+  EXPECT_TRUE(link("camera", "map", 3));
+  EXPECT_THROW(
+    tfc.lookupTransform("laser", "map", tf2::TimePointZero), tf2::LookupException);
+  EXPECT_FALSE(tfc.canTransform("laser", "map", tf2::TimePointZero));
+  EXPECT_TRUE(link("world", "map", 4));
+  EXPECT_TRUE(link("map", "odom", 4));
+  EXPECT_TRUE(link("odom", "base", 4));
+  EXPECT_TRUE(link("base", "laser", 4));
+  EXPECT_DOUBLE_EQ(
+    4.0, tfc.lookupTransform("world", "laser", tf2::TimePointZero).transform.translation.x);
+
+  // Lookups in the past still follow the parents of the past
+  EXPECT_DOUBLE_EQ(2.0, tfc.lookupTransform("odom", "laser", time).transform.translation.x);
+}
+
+TEST(tf2_frameLinks, Disconnected_Trees)
+{
+  tf2::BufferCore tfc;
+  geometry_msgs::msg::TransformStamped st;
+  st.transform.rotation.w = 1;
+  st.transform.translation.x = 1;
+  auto link = [&](const char * parent, const char * child, int32_t sec) {
+      st.header.frame_id = parent;
+      st.child_frame_id = child;
+      st.header.stamp.sec = sec;
+      return tfc.setTransform(st, "authority1");
+    };
+  for (int32_t sec = 1; sec <= 2; ++sec) {
+    EXPECT_TRUE(link("map", "base", sec));
+    EXPECT_TRUE(link("world", "robot2", sec));
+    EXPECT_TRUE(link("base", "sensor", sec));
+    EXPECT_TRUE(link("sensor", "lens", sec));
+  }
+  tf2::TimePoint time = tf2::TimePoint(std::chrono::milliseconds(1500));
+  std::string error;
+  EXPECT_FALSE(tfc.canTransform("robot2", "base", time, &error));
+  EXPECT_NE(std::string::npos, error.find("not part of the same tree"));
+  EXPECT_FALSE(tfc.canTransform("robot2", "lens", tf2::TimePointZero));
+  // Separate trees are reported as such, even at times without data
+  EXPECT_THROW(
+    tfc.lookupTransform("robot2", "base", tf2::TimePoint(std::chrono::seconds(9))),
+    tf2::ConnectivityException);
+
+  // A frame that moves to the other tree still connects them at the times it was in both
+  EXPECT_TRUE(link("robot2", "sensor", 3));
+  EXPECT_FALSE(tfc.canTransform("robot2", "map", time));
+  EXPECT_TRUE(tfc.canTransform("base", "lens", time));
+  EXPECT_TRUE(tfc.canTransform("robot2", "sensor", tf2::TimePoint(std::chrono::seconds(3))));
+  EXPECT_FALSE(tfc.canTransform("base", "lens", tf2::TimePointZero));
+
+  // So does older data with another parent, behind the latest one
+  EXPECT_TRUE(link("world", "tag", 2));
+  EXPECT_FALSE(tfc.canTransform("map", "tag", tf2::TimePoint(std::chrono::seconds(1))));
+  EXPECT_TRUE(link("map", "tag", 1));
+  EXPECT_TRUE(tfc.canTransform("map", "tag", tf2::TimePoint(std::chrono::seconds(1))));
+}
+
+TEST(tf2_lookupVelocity, Translation_And_Rotation)
+{
+  tf2::BufferCore tfc;
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "foo";
+  st.child_frame_id = "bar";
+  // bar moves along x at 1 m/s and turns about z at 0.5 rad/s
+  for (int32_t sec = 1; sec <= 5; ++sec) {
+    tf2::Quaternion q;
+    q.setRPY(0.0, 0.0, 0.5 * sec);
+    st.header.stamp.sec = sec;
+    st.transform.translation.x = sec;
+    st.transform.rotation.x = q.x();
+    st.transform.rotation.y = q.y();
+    st.transform.rotation.z = q.z();
+    st.transform.rotation.w = q.w();
+    EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+  }
+  st.header.frame_id = "bar";
+  st.child_frame_id = "baz";
+  st.transform.translation.x = 0.0;
+  st.transform.translation.y = 1.0;
+  st.transform.rotation.x = 0.0;
+  st.transform.rotation.y = 0.0;
+  st.transform.rotation.z = 0.0;
+  st.transform.rotation.w = 1.0;
+  EXPECT_TRUE(tfc.setTransform(st, "authority1", true));
+
+  geometry_msgs::msg::TwistStamped twist =
+    tfc.lookupVelocity("bar", "foo", tf2::timeFromSec(3.0), tf2::durationFromSec(1.0));
+  EXPECT_EQ("foo", twist.header.frame_id);
+  EXPECT_EQ(3, twist.header.stamp.sec);
+  EXPECT_NEAR(1.0, twist.twist.linear.x, 1e-9);
+  EXPECT_NEAR(0.0, twist.twist.linear.y, 1e-9);
+  EXPECT_NEAR(0.5, twist.twist.angular.z, 1e-9);
+
+  // A point off the axis of rotation also moves with the rotation
+  double epsilon = 1e-4;
+  twist = tfc.lookupVelocity("baz", "foo", tf2::timeFromSec(3.0), tf2::durationFromSec(0.01));
+  EXPECT_NEAR(1.0 - 0.5 * std::cos(1.5), twist.twist.linear.x, epsilon);
+  EXPECT_NEAR(-0.5 * std::sin(1.5), twist.twist.linear.y, epsilon);
+  EXPECT_NEAR(0.5, twist.twist.angular.z, epsilon);
+
+  // The interval is shifted back to end at the latest data
+  twist = tfc.lookupVelocity("bar", "foo", tf2::TimePointZero, tf2::durationFromSec(1.0));
+  EXPECT_EQ(4, twist.header.stamp.sec);
+  EXPECT_EQ(500000000u, twist.header.stamp.nanosec);
+  EXPECT_NEAR(1.0, twist.twist.linear.x, 1e-9);
+
+  twist = tfc.lookupVelocity("bar", "bar", tf2::timeFromSec(3.0), tf2::durationFromSec(1.0));
+  EXPECT_EQ(0.0, twist.twist.linear.x);
+  EXPECT_EQ(0.0, twist.twist.angular.z);
+
+  EXPECT_THROW(
+    tfc.lookupVelocity("bar", "foo", tf2::timeFromSec(1.0), tf2::durationFromSec(1.0)),
+    tf2::ExtrapolationException);
+  EXPECT_THROW(
+    tfc.lookupVelocity("bar", "foo", tf2::timeFromSec(3.0), tf2::Duration::zero()),
+    tf2::InvalidArgumentException);
+  EXPECT_THROW(
+    tfc.lookupVelocity("qux", "foo", tf2::timeFromSec(3.0), tf2::durationFromSec(1.0)),
+    tf2::LookupException);
+}
+
+TEST(tf2_transformHistory, Round_Trip)
+{
+  tf2::BufferCore source;
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "foo";
+  st.child_frame_id = "bar";
+  st.transform.rotation.w = 1;
+  for (int32_t sec = 1; sec <= 5; ++sec) {
+    st.header.stamp.sec = sec;
+    st.transform.translation.x = sec;
+    EXPECT_TRUE(source.setTransform(st, "authority1"));
+  }
+  st.header.frame_id = "bar";
+  st.child_frame_id = "baz";
+  EXPECT_TRUE(source.setTransform(st, "authority1", true));
+
+  tf2::TransformHistory history = source.getTransformHistory(tf2::timeFromSec(2.0));
+  // Static transforms are not part of the history
+  ASSERT_EQ(4u, history.transforms.size());
+  EXPECT_EQ(tf2::timeFromSec(2.0), history.transforms.front().stamp_);
+  EXPECT_EQ(tf2::timeFromSec(5.0), history.transforms.back().stamp_);
+  EXPECT_EQ("foo", history.frame_ids[history.transforms.front().frame_id_]);
+  EXPECT_EQ("bar", history.frame_ids[history.transforms.front().child_frame_id_]);
+
+  // Frame numbers differ between the two buffers
+  tf2::BufferCore destination;
+  st.header.frame_id = "other";
+  st.child_frame_id = "frame";
+  EXPECT_TRUE(destination.setTransform(st, "authority2"));
+  EXPECT_EQ(4u, destination.setTransformHistory(history, "backfill"));
+
+  EXPECT_TRUE(destination.canTransform("foo", "bar", tf2::timeFromSec(2.5)));
+  EXPECT_FALSE(destination.canTransform("foo", "bar", tf2::timeFromSec(1.5)));
+  EXPECT_DOUBLE_EQ(
+    3.5, destination.lookupTransform("foo", "bar", tf2::timeFromSec(3.5)).transform.translation.x);
+  EXPECT_NE(std::string::npos, destination.allFramesAsYAML().find("broadcaster: 'backfill'"));
+
+  // Invalid indices and static frames of the destination are skipped
+  st.header.frame_id = "foo";
+  st.child_frame_id = "bar";
+  tf2::BufferCore static_destination;
+  EXPECT_TRUE(static_destination.setTransform(st, "authority2", true));
+  history.transforms.back().frame_id_ = 42;
+  EXPECT_EQ(0u, static_destination.setTransformHistory(history, "backfill"));
+
+  // Entries are checked like the transforms of setTransform
+  tf2::BufferCore checked_destination;
+  history.transforms[1].translation_.setX(std::nan(""));
+  history.transforms[2].rotation_ = tf2::Quaternion(0.0, 0.0, 0.0, 2.0);
+  history.transforms[3].frame_id_ = history.transforms[3].child_frame_id_;
+  EXPECT_EQ(1u, checked_destination.setTransformHistory(history, "backfill"));
+  EXPECT_TRUE(checked_destination.canTransform("foo", "bar", tf2::timeFromSec(2.0)));
+  EXPECT_FALSE(checked_destination.canTransform("foo", "bar", tf2::timeFromSec(3.0)));
+}
+
+TEST(tf2_compactTransforms, Checked_Like_SetTransform)
+{
+  tf2::BufferCore tfc;
+  tfc.setStatisticsEnabled(true);
+  std::vector<tf2::CompactFrameID> ids;
+  tfc.resolveFrameNumbers({"foo", "bar"}, ids);
+  tf2::TransformStorage storage;
+  storage.rotation_ = tf2::Quaternion(0.0, 0.0, 0.0, 1.0);
+  storage.translation_ = tf2::Vector3(1.0, 0.0, 0.0);
+  storage.frame_id_ = ids[0];
+  storage.child_frame_id_ = ids[1];
+  std::vector<tf2::TransformStorage> transforms(5, storage);
+  transforms[0].stamp_ = tf2::timeFromSec(2.0);
+  transforms[1].stamp_ = tf2::timeFromSec(3.0);
+  transforms[1].translation_.setY(std::nan(""));
+  transforms[2].stamp_ = tf2::timeFromSec(3.0);
+  transforms[2].rotation_ = tf2::Quaternion(0.0, 0.0, 0.0, 2.0);
+  transforms[3].stamp_ = tf2::timeFromSec(3.0);
+  transforms[3].child_frame_id_ = ids[0];
+  // Older than the cache time
+  transforms[4].stamp_ = tf2::timeFromSec(-100.0);
+  EXPECT_EQ(1u, tfc.setCompactTransforms(transforms, "compact"));
+
+  geometry_msgs::msg::TransformStamped stored =
+    tfc.lookupTransform("foo", "bar", tf2::TimePointZero);
+  EXPECT_EQ(2, stored.header.stamp.sec);
+  EXPECT_DOUBLE_EQ(1.0, stored.transform.translation.x);
+  tf2::BufferCoreStatistics statistics = tfc.getStatistics();
+  EXPECT_EQ(1u, statistics.inserts);
+  EXPECT_EQ(1u, statistics.old_data_rejections);
+}
+
+TEST(tf2_allFramesAsYAML, Frames)
+{
+  tf2::BufferCore tfc;
+  EXPECT_EQ("[]", tfc.allFramesAsYAML());
+
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "foo";
+  st.header.stamp.sec = 1;
+  st.child_frame_id = "bar";
+  st.transform.rotation.w = 1;
+  EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+  st.header.stamp.sec = 2;
+  EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+
+  std::string yaml = tfc.allFramesAsYAML(tf2::timeFromSec(3.0));
+  EXPECT_NE(std::string::npos, yaml.find("bar: \n  parent: 'foo'\n"));
+  EXPECT_NE(std::string::npos, yaml.find("  broadcaster: 'authority1'\n"));
+  EXPECT_NE(std::string::npos, yaml.find("  rate: 2.000\n"));
+  EXPECT_NE(std::string::npos, yaml.find("  transform_delay: 1.000\n"));
+  EXPECT_NE(std::string::npos, yaml.find("  buffer_length: 1.000\n"));
+  EXPECT_EQ(std::string::npos, yaml.find("foo:"));
+}
+
+TEST(tf2_statistics, Histogram_Percentiles)
+{
+  tf2::Histogram histogram;
+  for (uint64_t value = 1; value <= 1000; ++value) {
+    histogram.record(value);
+  }
+  tf2::HistogramSnapshot snapshot = histogram.snapshot();
+  EXPECT_EQ(1000u, snapshot.count);
+  EXPECT_EQ(1000u, snapshot.max);
+  EXPECT_DOUBLE_EQ(500.5, snapshot.mean());
+  // Percentiles are upper bounds within 12.5% of the true value
+  EXPECT_GE(snapshot.percentile(0.5), 500u);
+  EXPECT_LE(snapshot.percentile(0.5), 563u);
+  EXPECT_GE(snapshot.percentile(0.99), 990u);
+  EXPECT_LE(snapshot.percentile(0.99), 1000u);
+  EXPECT_EQ(1000u, snapshot.percentile(1.0));
+
+  histogram.reset();
+  EXPECT_EQ(0u, histogram.snapshot().count);
+  EXPECT_EQ(0u, histogram.snapshot().percentile(0.5));
+}
+
+TEST(tf2_statistics, Histogram_Bucket_Bounds)
+{
+  for (uint64_t value : {0ull, 7ull, 8ull, 9ull, 1000ull, 123456789ull, 1ull << 40}) {
+    size_t index = tf2::Histogram::bucketIndex(value);
+    ASSERT_LT(index, tf2::Histogram::BUCKET_COUNT);
+    EXPECT_GE(tf2::Histogram::bucketUpperBound(index), value);
+    if (index > 0) {
+      EXPECT_LT(tf2::Histogram::bucketUpperBound(index - 1), value);
+    }
+  }
+  EXPECT_EQ(tf2::Histogram::BUCKET_COUNT - 1, tf2::Histogram::bucketIndex(UINT64_MAX));
+}
+
+TEST(tf2_statistics, Collects_Only_When_Enabled)
+{
+  tf2::BufferCore tfc;
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "foo";
+  st.header.stamp.sec = 1;
+  st.child_frame_id = "bar";
+  st.transform.rotation.w = 1;
+  EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+  EXPECT_NO_THROW(tfc.lookupTransform("foo", "bar", tf2::TimePointZero));
+  EXPECT_FALSE(tfc.isStatisticsEnabled());
+  EXPECT_EQ(0u, tfc.getStatistics().inserts);
+  EXPECT_EQ(0u, tfc.getStatistics().queries);
+
+  tfc.setStatisticsEnabled(true);
+  st.header.stamp.sec = 2;
+  EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+  st.header.stamp.sec = 3;
+  EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+  // Older than the cache time
+  st.header.stamp.sec = -100;
+  EXPECT_FALSE(tfc.setTransform(st, "authority1"));
+
+  EXPECT_NO_THROW(tfc.lookupTransform("foo", "bar", tf2::timeFromSec(2.5)));
+  EXPECT_THROW(
+    tfc.lookupTransform("foo", "bar", tf2::timeFromSec(4.0)),
+    tf2::ForwardExtrapolationException);
+  EXPECT_TRUE(tfc.canTransform("foo", "bar", tf2::timeFromSec(1.5)));
+
+  tf2::BufferCoreStatistics statistics = tfc.getStatistics();
+  EXPECT_EQ(2u, statistics.inserts);
+  EXPECT_EQ(1u, statistics.old_data_rejections);
+  EXPECT_EQ(3u, statistics.queries);
+  EXPECT_EQ(1u, statistics.extrapolation_failures);
+  EXPECT_EQ(0u, statistics.connectivity_failures);
+  EXPECT_EQ(3u, statistics.insert_lock_wait_ns.count);
+  EXPECT_EQ(3u, statistics.insert_lock_hold_ns.count);
+  EXPECT_EQ(3u, statistics.query_lock_wait_ns.count);
+  EXPECT_EQ(3u, statistics.chain_depth.count);
+  EXPECT_EQ(1u, statistics.chain_depth.max);
+  // Interpolating at 1.5s has to step over the samples at 3s and 2s
+  EXPECT_EQ(2u, statistics.cache_search_steps.max);
+  EXPECT_EQ(2u, statistics.transformable_requests_ns.count);
+  EXPECT_EQ(0u, statistics.transformable_request_queue_length.max);
+
+  statistics = tfc.takeStatistics();
+  EXPECT_EQ(2u, statistics.inserts);
+  EXPECT_EQ(0u, tfc.getStatistics().inserts);
+  EXPECT_EQ(0u, tfc.getStatistics().chain_depth.count);
+
+  EXPECT_TRUE(tfc.canTransform("foo", "bar", tf2::timeFromSec(2.5)));
+  EXPECT_EQ(1u, tfc.getStatistics().queries);
+  tfc.resetStatistics();
+  EXPECT_EQ(0u, tfc.getStatistics().queries);
+}
+
+TEST(tf2_statistics, Late_Inserts)
+{
+  tf2::BufferCore tfc;
+  tfc.setReorderWindow(2);
+  tfc.setStatisticsEnabled(true);
+  geometry_msgs::msg::TransformStamped st;
+  st.header.frame_id = "foo";
+  st.child_frame_id = "bar";
+  st.transform.rotation.w = 1;
+  for (int32_t sec : {1, 3, 4, 2}) {
+    st.header.stamp.sec = sec;
+    st.transform.translation.x = sec;
+    EXPECT_TRUE(tfc.setTransform(st, "authority1"));
+  }
+  // The late transform is found while it is staged
+  EXPECT_DOUBLE_EQ(
+    2.5, tfc.lookupTransform("foo", "bar", tf2::timeFromSec(2.5)).transform.translation.x);
+
+  tf2::BufferCoreStatistics statistics = tfc.getStatistics();
+  EXPECT_EQ(4u, statistics.inserts);
+  EXPECT_EQ(1u, statistics.late_inserts);
+  EXPECT_EQ(1u, statistics.insert_lateness_ns.count);
+  EXPECT_EQ(2000000000u, statistics.insert_lateness_ns.max);
+}
+
 TEST(tf2_time, Display_Time_Point)
 {
   tf2::TimePoint t = tf2::get_now();
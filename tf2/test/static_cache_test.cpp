@@ -86,6 +86,34 @@ TEST(StaticCache, DuplicateEntries)
   EXPECT_TRUE(!std::isnan(stor.rotation_.w()));
 }
 
+TEST(SharedStaticCache, SharedData)
+{
+  tf2::SharedStaticCache cache;
+  tf2::SharedStaticCache other;
+
+  tf2::TransformStorage stor;
+  setIdentity(stor);
+  stor.translation_.setValue(1.0, 2.0, 3.0);
+  stor.frame_id_ = tf2::CompactFrameID(3);
+  stor.child_frame_id_ = tf2::CompactFrameID(4);
+  cache.insertData(stor);
+
+  other.insertSharedData(cache.getSharedData(), 5, 6);
+  EXPECT_EQ(cache.getSharedData(), other.getSharedData());
+  EXPECT_EQ(5u, other.getParent(tf2::TimePoint(), nullptr));
+  other.getData(tf2::TimePoint(std::chrono::nanoseconds(1)), stor);
+  EXPECT_EQ(5u, stor.frame_id_);
+  EXPECT_EQ(6u, stor.child_frame_id_);
+  EXPECT_EQ(2.0, stor.translation_.y());
+
+  // Storing new data replaces the shared transform instead of changing it
+  stor.translation_.setValue(0.0, 0.0, 0.0);
+  other.insertData(stor);
+  cache.getData(tf2::TimePoint(std::chrono::nanoseconds(1)), stor);
+  EXPECT_EQ(3u, stor.frame_id_);
+  EXPECT_EQ(2.0, stor.translation_.y());
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,293 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include "geometry_msgs/msg/transform_stamped.hpp"
+#include "tf2/buffer_core.h"
+#include "tf2/time.h"
+
+// Count every allocation made by this process, to check that the real-time path makes none.
+// Every variant of new and delete is replaced, so that each allocation is freed by its match.
+// The helpers are kept out of line: once inlined into the replaced operators, GCC sees std::free
+// applied to the result of operator new and warns with -Wmismatched-new-delete.
+#ifdef __GNUC__
+#define COUNTED_NOINLINE __attribute__((noinline))
+#else
+#define COUNTED_NOINLINE
+#endif
+
+namespace
+{
+std::atomic<size_t> allocations{0};
+
+COUNTED_NOINLINE void * countedAlloc(std::size_t size) noexcept
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+COUNTED_NOINLINE void * countedAlignedAlloc(std::size_t size, std::align_val_t alignment) noexcept
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+  return _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+  return std::aligned_alloc(align, ((size == 0 ? 1 : size) + align - 1) / align * align);
+#endif
+}
+
+COUNTED_NOINLINE void countedFree(void * p) noexcept
+{
+  std::free(p);
+}
+
+COUNTED_NOINLINE void countedAlignedFree(void * p) noexcept
+{
+#ifdef _WIN32
+  _aligned_free(p);
+#else
+  std::free(p);
+#endif
+}
+
+void * throwIfNull(void * p)
+{
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+}  // namespace
+
+void * operator new(std::size_t size)
+{
+  return throwIfNull(countedAlloc(size));
+}
+
+void * operator new[](std::size_t size)
+{
+  return throwIfNull(countedAlloc(size));
+}
+
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+  return countedAlloc(size);
+}
+
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+  return countedAlloc(size);
+}
+
+void operator delete(void * p) noexcept
+{
+  countedFree(p);
+}
+
+void operator delete[](void * p) noexcept
+{
+  countedFree(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept
+{
+  countedFree(p);
+}
+
+void operator delete[](void * p, std::size_t) noexcept
+{
+  countedFree(p);
+}
+
+void operator delete(void * p, const std::nothrow_t &) noexcept
+{
+  countedFree(p);
+}
+
+void operator delete[](void * p, const std::nothrow_t &) noexcept
+{
+  countedFree(p);
+}
+
+// std::pmr::new_delete_resource allocates through the aligned overloads
+void * operator new(std::size_t size, std::align_val_t alignment)
+{
+  return throwIfNull(countedAlignedAlloc(size, alignment));
+}
+
+void * operator new[](std::size_t size, std::align_val_t alignment)
+{
+  return throwIfNull(countedAlignedAlloc(size, alignment));
+}
+
+void * operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+  return countedAlignedAlloc(size, alignment);
+}
+
+void * operator new[](
+  std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+  return countedAlignedAlloc(size, alignment);
+}
+
+void operator delete(void * p, std::align_val_t) noexcept
+{
+  countedAlignedFree(p);
+}
+
+void operator delete[](void * p, std::align_val_t) noexcept
+{
+  countedAlignedFree(p);
+}
+
+void operator delete(void * p, std::size_t, std::align_val_t) noexcept
+{
+  countedAlignedFree(p);
+}
+
+void operator delete[](void * p, std::size_t, std::align_val_t) noexcept
+{
+  countedAlignedFree(p);
+}
+
+void operator delete(void * p, std::align_val_t, const std::nothrow_t &) noexcept
+{
+  countedAlignedFree(p);
+}
+
+void operator delete[](void * p, std::align_val_t, const std::nothrow_t &) noexcept
+{
+  countedAlignedFree(p);
+}
+
+namespace
+{
+
+tf2::TimePoint atMs(int64_t ms)
+{
+  return tf2::TimePoint(std::chrono::milliseconds(ms));
+}
+
+class RealtimeBuffer : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    buffer_.reserve(8, 200);
+
+    const std::vector<std::string> names = {"world", "base", "arm", "hand"};
+    buffer_.resolveFrameNumbers(names, ids_);
+    for (int64_t ms = 0; ms <= 1000; ms += 10) {
+      insert(ms);
+    }
+  }
+
+  /// Insert one transform per link of world -> base -> arm -> hand
+  void insert(int64_t ms)
+  {
+    batch_.clear();
+    for (size_t i = 1; i < ids_.size(); ++i) {
+      batch_.emplace_back(
+        atMs(ms), tf2::Quaternion(0, 0, 0, 1), tf2::Vector3(static_cast<double>(ms), 0, 1),
+        ids_[i - 1], ids_[i]);
+    }
+    buffer_.setCompactTransforms(batch_, authority_);
+  }
+
+  tf2::BufferCore buffer_{tf2::Duration(std::chrono::seconds(1))};
+  std::vector<tf2::CompactFrameID> ids_;
+  std::vector<tf2::TransformStorage> batch_;
+  const std::string authority_ = "realtime_test_authority_longer_than_sso";
+};
+
+}  // namespace
+
+TEST_F(RealtimeBuffer, Lookup_Returns_Error_Codes)
+{
+  tf2::Transform transform;
+  tf2::TimePoint time_out;
+  EXPECT_EQ(
+    tf2::TF2Error::TF2_NO_ERROR,
+    buffer_.lookupTransform("world", "hand", atMs(505), transform, time_out));
+  EXPECT_DOUBLE_EQ(3 * 505.0, transform.getOrigin().x());
+  EXPECT_EQ(atMs(505), time_out);
+
+  EXPECT_EQ(
+    tf2::TF2Error::TF2_NO_ERROR,
+    buffer_.lookupTransform("hand", "hand", tf2::TimePointZero, transform, time_out));
+  // Nothing else holds the buffer, so not waiting for it makes no difference
+  EXPECT_EQ(
+    tf2::TF2Error::TF2_NO_ERROR,
+    buffer_.lookupTransform("world", "arm", tf2::TimePointZero, transform, time_out, false));
+  EXPECT_EQ(atMs(1000), time_out);
+  EXPECT_EQ(
+    tf2::TF2Error::TF2_FORWARD_EXTRAPOLATION_ERROR,
+    buffer_.lookupTransform("world", "hand", atMs(2000), transform, time_out));
+  EXPECT_EQ(
+    tf2::TF2Error::TF2_LOOKUP_ERROR,
+    buffer_.lookupTransform("world", "missing", tf2::TimePointZero, transform, time_out));
+  EXPECT_EQ(
+    tf2::TF2Error::TF2_INVALID_ARGUMENT_ERROR,
+    buffer_.lookupTransform("/world", "hand", tf2::TimePointZero, transform, time_out));
+}
+
+TEST_F(RealtimeBuffer, No_Allocations_After_Warm_Up)
+{
+  tf2::Transform transform;
+  tf2::TimePoint time_out;
+  // Warm up the lookups of this thread
+  buffer_.lookupTransform("world", "hand", tf2::TimePointZero, transform, time_out);
+
+  // Inserting a message also stays allocation free once its frames exist
+  geometry_msgs::msg::TransformStamped message;
+  message.header.frame_id = "/hand";
+  message.child_frame_id = "gripper_link_with_a_long_name";
+  message.transform.rotation.w = 1.0;
+  message.header.stamp.sec = 1;
+  buffer_.setTransform(message, authority_);
+
+  size_t failures = 0;
+  size_t before = allocations.load();
+  for (int64_t ms = 1010; ms <= 5000; ms += 10) {
+    insert(ms);
+    message.header.stamp.sec = static_cast<int32_t>(ms / 1000);
+    message.header.stamp.nanosec = static_cast<uint32_t>(ms % 1000) * 1000000u;
+    failures += !buffer_.setTransform(message, authority_);
+    failures += buffer_.lookupTransform(
+      "world", "hand", tf2::TimePointZero, transform, time_out) != tf2::TF2Error::TF2_NO_ERROR;
+    failures += buffer_.lookupTransform(
+      "arm", "base", atMs(ms - 15), transform, time_out) != tf2::TF2Error::TF2_NO_ERROR;
+    // Failures are reported without allocating too
+    failures += buffer_.lookupTransform(
+      "world", "hand", atMs(ms + 100), transform, time_out) == tf2::TF2Error::TF2_NO_ERROR;
+  }
+  size_t after = allocations.load();
+
+  EXPECT_EQ(0u, failures);
+  EXPECT_EQ(before, after);
+}
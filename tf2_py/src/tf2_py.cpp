@@ -303,6 +303,109 @@ cleanup:
   return pinst;
 }
 
+static int setVector3(PyObject * vector, double x, double y, double z)
+{
+  const char * names[] = {"x", "y", "z"};
+  const double values[] = {x, y, z};
+  for (int i = 0; i < 3; ++i) {
+    PyObject * value = PyFloat_FromDouble(values[i]);
+    if (!value) {
+      return -1;
+    }
+    int ret = PyObject_SetAttrString(vector, names[i], value);
+    Py_DECREF(value);
+    if (-1 == ret) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static PyObject * twist_converter(const geometry_msgs::msg::TwistStamped * twist)
+{
+  PyObject * pclass = nullptr;
+  PyObject * pinst = nullptr;
+  PyObject * builtin_interfaces_time = nullptr;
+  PyObject * time_obj = nullptr;
+  PyObject * pheader = nullptr;
+  PyObject * pframe_id = nullptr;
+  PyObject * ptwist = nullptr;
+  PyObject * plinear = nullptr;
+  PyObject * pangular = nullptr;
+  pclass = PyObject_GetAttrString(pModulegeometrymsgs, "TwistStamped");
+  if (!pclass) {
+    goto cleanup;
+  }
+
+  pinst = PyObject_CallObject(pclass, nullptr);
+  if (!pinst) {
+    goto cleanup;
+  }
+
+  builtin_interfaces_time = PyObject_GetAttrString(pModulebuiltininterfacesmsgs, "Time");
+  if (!builtin_interfaces_time) {
+    goto cleanup;
+  }
+  time_obj = PyObject_CallFunction(
+    builtin_interfaces_time, "iI", twist->header.stamp.sec, twist->header.stamp.nanosec);
+  if (!time_obj) {
+    goto cleanup;
+  }
+
+  pheader = PyObject_GetAttrString(pinst, "header");
+  if (!pheader) {
+    goto cleanup;
+  }
+  if (-1 == PyObject_SetAttrString(pheader, "stamp", time_obj)) {
+    goto cleanup;
+  }
+  pframe_id = stringToPython(twist->header.frame_id);
+  if (!pframe_id) {
+    goto cleanup;
+  }
+  if (-1 == PyObject_SetAttrString(pheader, "frame_id", pframe_id)) {
+    goto cleanup;
+  }
+
+  ptwist = PyObject_GetAttrString(pinst, "twist");
+  if (!ptwist) {
+    goto cleanup;
+  }
+  plinear = PyObject_GetAttrString(ptwist, "linear");
+  if (!plinear) {
+    goto cleanup;
+  }
+  if (-1 == setVector3(plinear, twist->twist.linear.x, twist->twist.linear.y,
+    twist->twist.linear.z))
+  {
+    goto cleanup;
+  }
+  pangular = PyObject_GetAttrString(ptwist, "angular");
+  if (!pangular) {
+    goto cleanup;
+  }
+  if (-1 == setVector3(pangular, twist->twist.angular.x, twist->twist.angular.y,
+    twist->twist.angular.z))
+  {
+    goto cleanup;
+  }
+
+cleanup:
+  if (PyErr_Occurred()) {
+    Py_XDECREF(pinst);
+    pinst = nullptr;
+  }
+  Py_XDECREF(pclass);
+  Py_XDECREF(builtin_interfaces_time);
+  Py_XDECREF(time_obj);
+  Py_XDECREF(pheader);
+  Py_XDECREF(pframe_id);
+  Py_XDECREF(ptwist);
+  Py_XDECREF(plinear);
+  Py_XDECREF(pangular);
+  return pinst;
+}
+
 static builtin_interfaces::msg::Time toMsg(const tf2::TimePoint & t)
 {
   std::chrono::nanoseconds ns = t.time_since_epoch();
@@ -627,51 +730,28 @@ static PyObject * lookupTransformFullCore(PyObject * self, PyObject * args, PyOb
   // TODO(anyone): Create a converter that will actually return a python message
   return Py_BuildValue("O&", transform_converter, &transform);
 }
-/*
-static PyObject *lookupTwistCore(PyObject *self, PyObject *args, PyObject *kw)
+
+static PyObject * lookupVelocityCore(PyObject * self, PyObject * args, PyObject * kw)
 {
-  tf2::BufferCore *bc = ((buffer_core_t*)self)->bc;
-  char *tracking_frame, *observation_frame;
-  builtin_interfaces::msg::Time time;
+  tf2::BufferCore * bc = reinterpret_cast<buffer_core_t *>(self)->bc;
+  char * tracking_frame, * observation_frame;
+  tf2::TimePoint time;
   tf2::Duration averaging_interval;
-  static const char *keywords[] = { "tracking_frame", "observation_frame", "time", "averaging_interval", nullptr };
+  static const char * keywords[] =
+  {"tracking_frame", "observation_frame", "time", "averaging_interval", nullptr};
 
-  if (!PyArg_ParseTupleAndKeywords(args, kw, "ssO&O&", (char**)keywords, &tracking_frame, &observation_frame, rostime_converter, &time, rosduration_converter, &averaging_interval))
+  if (!PyArg_ParseTupleAndKeywords(
+      args, kw, "ssO&O&",
+      const_cast<char **>(reinterpret_cast<const char **>(keywords)), &tracking_frame,
+      &observation_frame, rostime_converter, &time, rosduration_converter, &averaging_interval))
+  {
     return nullptr;
-  geometry_msgs::msg::Twist twist;
-  WRAP(twist = bc->lookupTwist(tracking_frame, observation_frame, time, averaging_interval));
-
-  return Py_BuildValue("(ddd)(ddd)",
-      twist.linear.x, twist.linear.y, twist.linear.z,
-      twist.angular.x, twist.angular.y, twist.angular.z);
+  }
+  geometry_msgs::msg::TwistStamped twist;
+  WRAP(twist = bc->lookupVelocity(tracking_frame, observation_frame, time, averaging_interval));
+  return Py_BuildValue("O&", twist_converter, &twist);
 }
 
-static PyObject *lookupTwistFullCore(PyObject *self, PyObject *args)
-{
-  tf2::BufferCore *bc = ((buffer_core_t*)self)->bc;
-  char *tracking_frame, *observation_frame, *reference_frame, *reference_point_frame;
-  builtin_interfaces::msg::Time time;
-  tf2::Duration averaging_interval;
-  double px, py, pz;
-
-  if (!PyArg_ParseTuple(args, "sss(ddd)sO&O&",
-                        &tracking_frame,
-                        &observation_frame,
-                        &reference_frame,
-                        &px, &py, &pz,
-                        &reference_point_frame,
-                        rostime_converter, &time,
-                        rosduration_converter, &averaging_interval))
-    return nullptr;
-  geometry_msgs::msg::Twist twist;
-  tf::Point pt(px, py, pz);
-  WRAP(twist = bc->lookupTwist(tracking_frame, observation_frame, reference_frame, pt, reference_point_frame, time, averaging_interval));
-
-  return Py_BuildValue("(ddd)(ddd)",
-      twist.linear.x, twist.linear.y, twist.linear.z,
-      twist.angular.x, twist.angular.y, twist.angular.z);
-}
-*/
 static inline int checkTranslationType(PyObject * o)
 {
   PyTypeObject * translation_type =
@@ -1058,8 +1138,8 @@ static struct PyMethodDef buffer_core_methods[] =
     nullptr},
   {"lookup_transform_full_core", (PyCFunction)lookupTransformFullCore, METH_VARARGS | METH_KEYWORDS,
     nullptr},
-  // {"lookupTwistCore", (PyCFunction)lookupTwistCore, METH_VARARGS | METH_KEYWORDS},
-  // {"lookupTwistFullCore", lookupTwistFullCore, METH_VARARGS},
+  {"lookup_velocity_core", (PyCFunction)lookupVelocityCore, METH_VARARGS | METH_KEYWORDS,
+    nullptr},
   {nullptr, nullptr, 0, nullptr}
 };
 
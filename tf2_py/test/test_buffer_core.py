@@ -243,6 +243,27 @@ class TestBufferClient(unittest.TestCase):
 
         self.assertEqual(transform, lookup_transform)
 
+    def test_lookup_velocity_core(self):
+        buffer_core = BufferCore()
+
+        for sec in range(1, 4):
+            transform = build_transform(
+                'bar', 'foo', rclpy.time.Time(seconds=sec).to_msg())
+            transform.transform.translation.x = float(sec)
+            buffer_core.set_transform(transform, 'unittest')
+
+        twist = buffer_core.lookup_velocity_core(
+            tracking_frame='foo',
+            observation_frame='bar',
+            time=rclpy.time.Time(seconds=2),
+            averaging_interval=rclpy.duration.Duration(seconds=1)
+        )
+
+        self.assertEqual('bar', twist.header.frame_id)
+        self.assertEqual(2, twist.header.stamp.sec)
+        self.assertAlmostEqual(1.0, twist.twist.linear.x)
+        self.assertAlmostEqual(0.0, twist.twist.angular.z)
+
     def test_lookup_transform_core_fail(self):
         buffer_core = BufferCore()
 
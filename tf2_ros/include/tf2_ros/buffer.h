@@ -32,6 +32,8 @@
 #ifndef TF2_ROS__BUFFER_H_
 #define TF2_ROS__BUFFER_H_
 
+#include <atomic>
+#include <chrono>
 #include <future>
 #include <memory>
 #include <mutex>
@@ -45,13 +47,25 @@
 #include "tf2/buffer_core.h"
 #include "tf2/time.h"
 
+#include "diagnostic_msgs/msg/diagnostic_array.hpp"
 #include "geometry_msgs/msg/transform_stamped.hpp"
+#include "geometry_msgs/msg/twist_stamped.hpp"
 #include "tf2_msgs/srv/frame_graph.hpp"
+#include "tf2_msgs/srv/get_transform_history.hpp"
 #include "rclcpp/rclcpp.hpp"
 
 namespace tf2_ros
 {
 
+/** \brief What a Buffer does with its data when the clock jumps back in time. */
+enum class TimeJumpPolicy
+{
+  /// Discard all non-static data
+  Clear,
+  /// Discard only the data stamped after the time jumped to
+  Rollback,
+};
+
 /** \brief Standard implementation of the tf2_ros::BufferInterface abstract data type.
  *
  * Inherits tf2_ros::BufferInterface and tf2::BufferCore.
@@ -63,12 +77,14 @@ class Buffer : public BufferInterface, public AsyncBufferInterface, public tf2::
 public:
   using tf2::BufferCore::lookupTransform;
   using tf2::BufferCore::canTransform;
+  using tf2::BufferCore::lookupVelocity;
   using SharedPtr = std::shared_ptr<tf2_ros::Buffer>;
 
   /** \brief  Constructor for a Buffer object
    * \param clock A clock to use for time and sleeping
    * \param cache_time How long to keep a history of transforms
-   * \param node If passed advertise the view_frames service that exposes debugging information from the buffer
+   * \param node If passed advertise the view_frames service that exposes debugging information from the buffer,
+   *             and the "tf2_history" service that new listeners can backfill their buffer from
    */
   TF2_ROS_PUBLIC Buffer(
     rclcpp::Clock::SharedPtr clock,
@@ -143,6 +159,42 @@ public:
       fixed_frame, fromRclcpp(timeout));
   }
 
+  /** \brief Get the velocity of one frame relative to another, averaged over an interval.
+   * \param tracking_frame The frame whose motion is tracked
+   * \param observation_frame The frame the motion is observed from
+   * \param time The time at which to get the velocity (0 will get the latest)
+   * \param averaging_interval The length of the interval to average over, must be positive
+   * \param timeout How long to block for the end of the interval before falling back on an
+   * interval that ends at the latest data
+   * \return The linear and angular velocity of tracking_frame, expressed in observation_frame
+   * \sa tf2::BufferCore::lookupVelocity
+   *
+   * Possible exceptions tf2::LookupException, tf2::ConnectivityException,
+   * tf2::ExtrapolationException, tf2::InvalidArgumentException
+   */
+  TF2_ROS_PUBLIC
+  geometry_msgs::msg::TwistStamped
+  lookupVelocity(
+    const std::string & tracking_frame, const std::string & observation_frame,
+    const tf2::TimePoint & time, const tf2::Duration & averaging_interval,
+    const tf2::Duration timeout) const;
+
+  /** \brief Get the velocity of one frame relative to another, averaged over an interval.
+   * \sa lookupVelocity(const std::string&, const std::string&, const tf2::TimePoint&,
+   *                    const tf2::Duration&, const tf2::Duration)
+   */
+  TF2_ROS_PUBLIC
+  geometry_msgs::msg::TwistStamped
+  lookupVelocity(
+    const std::string & tracking_frame, const std::string & observation_frame,
+    const rclcpp::Time & time, const rclcpp::Duration & averaging_interval,
+    const rclcpp::Duration timeout = rclcpp::Duration::from_nanoseconds(0)) const
+  {
+    return lookupVelocity(
+      tracking_frame, observation_frame, fromRclcpp(time),
+      fromRclcpp(averaging_interval), fromRclcpp(timeout));
+  }
+
   /** \brief Test if a transform is possible
    * \param target_frame The frame into which to transform
    * \param source_frame The frame from which to transform
@@ -268,6 +320,45 @@ public:
     timer_interface_ = create_timer_interface;
   }
 
+  /** \brief Periodically publish the BufferCore statistics on the "/diagnostics" topic.
+   *
+   * Enables statistics collection and, every period, publishes a diagnostic_msgs::DiagnosticArray
+   * summarizing the statistics gathered since the previous publication.
+   * Requires the Buffer to have been constructed with a node.
+   * \param period How often to publish, which is also the window the statistics cover
+   * \throws std::runtime_error if the Buffer has no node
+   */
+  TF2_ROS_PUBLIC
+  void
+  startStatisticsPublisher(const tf2::Duration & period = std::chrono::seconds(1));
+
+  /** \brief Stop publishing statistics and disable their collection. */
+  TF2_ROS_PUBLIC
+  void
+  stopStatisticsPublisher();
+
+  /** \brief Set how long a "tf2_frames" service response may be reused.
+   *
+   * Rendering the frame graph of a large tree is expensive, so requests within this period of
+   * the last rendering are answered from a cache. Defaults to one second, zero disables caching.
+   */
+  TF2_ROS_PUBLIC
+  void
+  setFramesCachePeriod(const tf2::Duration & period);
+
+  /** \brief Choose how the buffer reacts to the clock jumping back in time.
+   *
+   * With TimeJumpPolicy::Rollback the history up to the new time is kept, which avoids
+   * extrapolation errors while the pipeline re-warms after simulation resets and bag loops.
+   * Changes of the time source always clear the buffer. Defaults to TimeJumpPolicy::Clear.
+   */
+  TF2_ROS_PUBLIC
+  void
+  setTimeJumpPolicy(TimeJumpPolicy policy)
+  {
+    time_jump_policy_ = policy;
+  }
+
 private:
   void timerCallback(
     const TimerHandle & timer_handle,
@@ -279,8 +370,15 @@ private:
     const tf2_msgs::srv::FrameGraph::Request::SharedPtr req,
     tf2_msgs::srv::FrameGraph::Response::SharedPtr res);
 
+  bool getHistory(
+    const tf2_msgs::srv::GetTransformHistory::Request::SharedPtr req,
+    tf2_msgs::srv::GetTransformHistory::Response::SharedPtr res);
+
   void onTimeJump(const rcl_time_jump_t & jump);
 
+  void publishStatistics(
+    rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray> & publisher);
+
   // conditionally error if dedicated_thread unset.
   bool checkAndErrorDedicatedThreadPresent(std::string * errstr) const;
 
@@ -290,6 +388,15 @@ private:
   // framegraph service
   rclcpp::Service<tf2_msgs::srv::FrameGraph>::SharedPtr frames_server_;
 
+  // history service, answering backfill requests of new listeners
+  rclcpp::Service<tf2_msgs::srv::GetTransformHistory>::SharedPtr history_server_;
+
+  /// \brief The last frame graph served, and when it was rendered
+  std::string frames_yaml_cache_;
+  std::chrono::steady_clock::time_point frames_yaml_rendered_;
+  tf2::Duration frames_cache_period_;
+  std::mutex frames_yaml_mutex_;
+
   /// \brief A clock to use for time and sleeping
   rclcpp::Clock::SharedPtr clock_;
 
@@ -307,6 +414,13 @@ private:
 
   /// \brief Reference to a jump handler registered to the clock
   rclcpp::JumpHandler::SharedPtr jump_handler_;
+
+  /// \brief What to do on a jump back in time
+  std::atomic<TimeJumpPolicy> time_jump_policy_{TimeJumpPolicy::Clear};
+
+  /// \brief Publisher and timer for the BufferCore statistics, when enabled
+  rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr statistics_pub_;
+  rclcpp::TimerBase::SharedPtr statistics_timer_;
 };
 
 static const char threading_error[] = "Do not call canTransform or lookupTransform with a timeout "
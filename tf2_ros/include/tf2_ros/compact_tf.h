@@ -0,0 +1,110 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TF2_ROS__COMPACT_TF_H_
+#define TF2_ROS__COMPACT_TF_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "geometry_msgs/msg/transform_stamped.hpp"
+#include "tf2/buffer_core.h"
+#include "tf2/time.h"
+#include "tf2_msgs/msg/compact_tf_message.hpp"
+#include "tf2_ros/visibility_control.h"
+
+namespace tf2_ros
+{
+
+/** \brief Writes transforms as tf2_msgs::msg::CompactTFMessage, keeping the frame dictionary.
+ *
+ * Each encoder picks a random sender id. Frame names are sent once, in the first message using
+ * them, and the whole dictionary is resent once per dictionary period.
+ */
+class CompactTFEncoder
+{
+public:
+  TF2_ROS_PUBLIC
+  explicit CompactTFEncoder(tf2::Duration dictionary_period = std::chrono::seconds(1));
+
+  /** \brief Encode transforms into a message, replacing its contents. */
+  TF2_ROS_PUBLIC
+  void encode(
+    const std::vector<geometry_msgs::msg::TransformStamped> & transforms,
+    tf2_msgs::msg::CompactTFMessage & message);
+
+  TF2_ROS_PUBLIC
+  uint64_t senderId() const
+  {
+    return sender_id_;
+  }
+
+private:
+  uint32_t intern(const std::string & frame_id);
+
+  uint64_t sender_id_;
+  tf2::Duration dictionary_period_;
+  std::unordered_map<std::string, uint32_t> frame_ids_;
+  std::vector<std::string> frame_names_;
+  /// Number of frame names already sent, and when the whole dictionary was last sent
+  size_t frames_sent_{0};
+  std::chrono::steady_clock::time_point dictionary_sent_;
+};
+
+/** \brief Reads tf2_msgs::msg::CompactTFMessage straight into a BufferCore.
+ *
+ * The ids of each sender are mapped to CompactFrameIDs of the buffer as their names arrive, so
+ * transforms are stored without any string work. Transforms using ids whose names have not been
+ * received yet are skipped until the sender resends its dictionary.
+ */
+class CompactTFDecoder
+{
+public:
+  /** \brief Constructor
+   * \param sender_timeout How long a sender may stay quiet before its ids are forgotten. Each
+   * broadcaster restart brings a new sender id, so this bounds the ids kept for old ones.
+   */
+  TF2_ROS_PUBLIC
+  explicit CompactTFDecoder(tf2::Duration sender_timeout = std::chrono::seconds(60));
+
+  /** \brief Store the transforms of a message in a buffer.
+   * Messages whose dictionary starts past the names received so far are skipped, a sender
+   * resends its whole dictionary once per dictionary period.
+   * \return The number of transforms stored
+   */
+  TF2_ROS_PUBLIC
+  size_t decode(
+    const tf2_msgs::msg::CompactTFMessage & message, tf2::BufferCore & buffer,
+    const std::string & authority);
+
+private:
+  struct Sender
+  {
+    std::vector<tf2::CompactFrameID> frames;
+    std::chrono::steady_clock::time_point last_seen;
+  };
+  std::unordered_map<uint64_t, Sender> senders_;
+  tf2::Duration sender_timeout_;
+
+  /// Scratch space reused across messages
+  std::vector<tf2::CompactFrameID> resolved_;
+  std::vector<tf2::TransformStorage> transforms_;
+};
+
+}  // namespace tf2_ros
+
+#endif  // TF2_ROS__COMPACT_TF_H_
@@ -52,6 +52,7 @@
 #include "message_filters/simple_filter.h"
 #include "tf2/buffer_core_interface.h"
 #include "tf2/time.h"
+#include "tf2/tracing.h"
 #include "tf2_ros/async_buffer_interface.h"
 #include "tf2_ros/buffer.h"
 
@@ -337,12 +338,14 @@ public:
    */
   void clear()
   {
+    // Cancelled without the lock, as cancelling waits for callbacks that may be taking it
+    std::unordered_map<uint64_t, tf2_ros::TransformStampedFuture> ts_futures;
     {
       std::unique_lock<std::mutex> lock(ts_futures_mutex_);
-      for (auto & kv : ts_futures_) {
-        buffer_.cancel(kv.second);
-      }
-      ts_futures_.clear();
+      ts_futures.swap(ts_futures_);
+    }
+    for (auto & kv : ts_futures) {
+      buffer_.cancel(kv.second);
     }
 
     std::unique_lock<std::mutex> unique_lock(messages_mutex_);
@@ -350,6 +353,7 @@ public:
     TF2_ROS_MESSAGEFILTER_DEBUG("%s", "Cleared");
 
     messages_.clear();
+    queued_frames_.clear();
 
     warned_about_empty_frame_id_ = false;
   }
@@ -369,19 +373,45 @@ public:
       messageDropped(evt, filter_failure_reasons::EmptyFrameID);
       return;
     }
+    TF2_TRACEPOINT(message_filter_add, this, frame_id.c_str(), stamp.nanoseconds());
+
+    V_string target_frames_copy;
+    rclcpp::Duration time_tolerance(0, 0);
+    // Copy target_frames_ to avoid deadlock from #79
+    {
+      std::unique_lock<std::mutex> frames_lock(target_frames_mutex_);
+      target_frames_copy = target_frames_;
+      time_tolerance = time_tolerance_;
+    }
+
+    // Messages whose transforms are all available already are passed on right away, without
+    // queueing them and waiting for each of their transforms. Messages of a frame that has some
+    // queued already wait behind them, so they are not checked twice.
+    bool frame_queued;
+    {
+      std::unique_lock<std::mutex> unique_lock(messages_mutex_);
+      frame_queued = queued_frames_.count(frame_id) != 0;
+    }
+    const tf2::TimePoint times[2] = {
+      tf2_ros::fromRclcpp(stamp), tf2_ros::fromRclcpp(stamp + time_tolerance)};
+    size_t time_count = time_tolerance.nanoseconds() ? 2 : 1;
+    if (!frame_queued &&
+      buffer_.canTransformAll(target_frames_copy, frame_id, times, time_count, nullptr))
+    {
+      ++incoming_message_count_;
+      ++successful_transform_count_;
+      TF2_ROS_MESSAGEFILTER_DEBUG(
+        "Message ready in frame %s at time %.3f, without queueing it",
+        frame_id.c_str(), stamp.seconds());
+      messageReady(evt);
+      return;
+    }
 
     std::vector<std::tuple<uint64_t, tf2::TimePoint, std::string>> wait_params;
     // iterate through the target frames and add requests for each of them
     MessageInfo info;
     info.handles.reserve(expected_success_count_);
     {
-      V_string target_frames_copy;
-      // Copy target_frames_ to avoid deadlock from #79
-      {
-        std::unique_lock<std::mutex> frames_lock(target_frames_mutex_);
-        target_frames_copy = target_frames_;
-      }
-
       V_string::iterator it = target_frames_copy.begin();
       V_string::iterator end = target_frames_copy.end();
       for (; it != end; ++it) {
@@ -390,10 +420,10 @@ public:
           next_handle_index_, tf2_ros::fromRclcpp(stamp), target_frame);
         info.handles.push_back(next_handle_index_++);
 
-        if (time_tolerance_.nanoseconds()) {
+        if (time_tolerance.nanoseconds()) {
           wait_params.emplace_back(
             next_handle_index_,
-            tf2_ros::fromRclcpp(stamp + time_tolerance_),
+            tf2_ros::fromRclcpp(stamp + time_tolerance),
             target_frame);
           info.handles.push_back(next_handle_index_++);
         }
@@ -416,11 +446,14 @@ public:
 
         messageDropped(front.event, filter_failure_reasons::QueueFull);
 
+        unqueueFrame(front.frame_id);
         messages_.pop_front();
       }
 
       // Add the message to our list
       info.event = evt;
+      info.frame_id = frame_id;
+      ++queued_frames_[frame_id];
       messages_.push_back(info);
     }
 
@@ -526,6 +559,7 @@ private:
           ++info.success_count;
           if (info.success_count >= expected_success_count_) {
             saved_event = msg_it->event;
+            unqueueFrame(msg_it->frame_id);
             messages_.erase(msg_it);
             event_found = true;
           }
@@ -670,6 +704,11 @@ private:
 
   void messageDropped(const MEvent & evt, FilterFailureReason reason)
   {
+    TF2_TRACEPOINT(
+      message_filter_release, this,
+      message_filters::message_traits::FrameId<M>::value(*evt.getMessage()).c_str(),
+      rclcpp::Time(message_filters::message_traits::TimeStamp<M>::value(*evt.getMessage()))
+      .nanoseconds(), false, static_cast<int>(reason));
     // TODO(clalancette): reenable this once we have underlying support for callback queues
 #if 0
     if (callback_queue_) {
@@ -684,6 +723,11 @@ private:
 
   void messageReady(const MEvent & evt)
   {
+    TF2_TRACEPOINT(
+      message_filter_release, this,
+      message_filters::message_traits::FrameId<M>::value(*evt.getMessage()).c_str(),
+      rclcpp::Time(message_filters::message_traits::TimeStamp<M>::value(*evt.getMessage()))
+      .nanoseconds(), true, static_cast<int>(filter_failure_reasons::Unknown));
     // TODO(clalancette): reenable this once we have underlying support for callback queues
 #if 0
     if (callback_queue_) {
@@ -741,11 +785,23 @@ private:
     : success_count(0) {}
 
     MEvent event;
+    std::string frame_id;
     std::vector<uint64_t> handles;
     uint64_t success_count;
   };
   typedef std::list<MessageInfo> L_MessageInfo;
   L_MessageInfo messages_;
+  ///< The number of queued messages of each frame, guarded by messages_mutex_
+  std::unordered_map<std::string, size_t> queued_frames_;
+
+  /// Count a message of frame_id as no longer queued, expects messages_mutex_ to be held
+  void unqueueFrame(const std::string & frame_id)
+  {
+    auto it = queued_frames_.find(frame_id);
+    if (it != queued_frames_.end() && --it->second == 0) {
+      queued_frames_.erase(it);
+    }
+  }
 
   ///< The mutex used for locking message list operations
   std::mutex messages_mutex_;
@@ -33,15 +33,21 @@
 #ifndef TF2_ROS__TRANSFORM_BROADCASTER_H_
 #define TF2_ROS__TRANSFORM_BROADCASTER_H_
 
+#include <chrono>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
+#include "tf2/time.h"
+#include "tf2_ros/compact_tf.h"
 #include "tf2_ros/visibility_control.h"
 
 #include "rclcpp/node_interfaces/get_node_parameters_interface.hpp"
 #include "rclcpp/node_interfaces/get_node_topics_interface.hpp"
 #include "rclcpp/rclcpp.hpp"
 #include "geometry_msgs/msg/transform_stamped.hpp"
+#include "tf2_msgs/msg/compact_tf_message.hpp"
 #include "tf2_msgs/msg/tf_message.hpp"
 #include "tf2_ros/qos.hpp"
 
@@ -116,8 +122,43 @@ public:
   TF2_ROS_PUBLIC
   void sendTransform(const std::vector<geometry_msgs::msg::TransformStamped> & transforms);
 
+  /** \brief Also send transforms as tf2_msgs::msg::CompactTFMessage on /tf_compact.
+   *
+   * The compact format sends each frame name once instead of in every transform, which
+   * matters for large trees published at high rates. Only listeners that enabled it themselves
+   * can read it, so by default transforms keep being sent on /tf as well.
+   *
+   * \param node The node this broadcaster was constructed with
+   * \param publish_tf Whether to keep sending transforms on /tf
+   * \param dictionary_period How often the whole frame dictionary is resent for late subscribers
+   * \param qos The QoS of the /tf_compact publisher
+   * \param tf_ns The namespace of /tf_compact
+   */
+  template<class NodeT>
+  void enableCompactFormat(
+    NodeT && node, bool publish_tf = true,
+    tf2::Duration dictionary_period = std::chrono::seconds(1),
+    const rclcpp::QoS & qos = DynamicBroadcasterQoS(),
+    const std::string & tf_ns = "")
+  {
+    std::lock_guard<std::mutex> lock(compact_mutex_);
+    compact_publisher_ = rclcpp::create_publisher<tf2_msgs::msg::CompactTFMessage>(
+      rclcpp::node_interfaces::get_node_parameters_interface(node),
+      rclcpp::node_interfaces::get_node_topics_interface(node),
+      tf_ns + "/tf_compact", qos);
+    compact_encoder_ = std::make_unique<CompactTFEncoder>(dictionary_period);
+    publish_tf_ = publish_tf;
+  }
+
 private:
   rclcpp::Publisher<tf2_msgs::msg::TFMessage>::SharedPtr publisher_;
+
+  /// The compact format publisher and its frame dictionary, when enabled
+  std::mutex compact_mutex_;
+  rclcpp::Publisher<tf2_msgs::msg::CompactTFMessage>::SharedPtr compact_publisher_;
+  std::unique_ptr<CompactTFEncoder> compact_encoder_;
+  tf2_msgs::msg::CompactTFMessage compact_message_;
+  bool publish_tf_{true};
 };
 
 }  // namespace tf2_ros
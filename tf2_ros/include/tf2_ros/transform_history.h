@@ -0,0 +1,41 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TF2_ROS__TRANSFORM_HISTORY_H_
+#define TF2_ROS__TRANSFORM_HISTORY_H_
+
+#include "tf2/buffer_core.h"
+#include "tf2_msgs/msg/transform_history.hpp"
+#include "tf2_ros/visibility_control.h"
+
+namespace tf2_ros
+{
+
+/** \brief Pack a transform history into its message, sending each frame name once. */
+TF2_ROS_PUBLIC
+tf2_msgs::msg::TransformHistory
+toMsg(const tf2::TransformHistory & history);
+
+/** \brief Unpack a transform history message.
+ *
+ * Transforms are read up to the shortest of the per-transform arrays. Frame indices are not
+ * checked here, BufferCore::setTransformHistory skips transforms with invalid indices.
+ */
+TF2_ROS_PUBLIC
+tf2::TransformHistory
+fromMsg(const tf2_msgs::msg::TransformHistory & msg);
+
+}  // namespace tf2_ros
+
+#endif  // TF2_ROS__TRANSFORM_HISTORY_H_
@@ -34,16 +34,21 @@
 
 #include <functional>
 #include <memory>
+#include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include "tf2/buffer_core.h"
 #include "tf2/time.h"
 #include "tf2_ros/visibility_control.h"
 
+#include "tf2_msgs/msg/compact_tf_message.hpp"
 #include "tf2_msgs/msg/tf_message.hpp"
+#include "tf2_msgs/srv/get_transform_history.hpp"
 #include "rclcpp/rclcpp.hpp"
 
+#include "tf2_ros/compact_tf.h"
 #include "tf2_ros/qos.hpp"
 
 namespace tf2_ros
@@ -164,6 +169,109 @@ public:
   TF2_ROS_PUBLIC
   virtual ~TransformListener();
 
+  /** \brief Backfill the buffer with the recent history of a tf2_ros::Buffer.
+   *
+   * Sends a request to the "tf2_history" service of a Buffer that was constructed with a node,
+   * and bulk-loads the non-static transforms of the last \p duration into the buffer once the
+   * response arrives. This is opt-in and asynchronous: it returns immediately, and transforms
+   * received on /tf in the meantime are kept. The response is handled by the dedicated thread
+   * if there is one, otherwise by whatever spins \p node.
+   *
+   * \param node The node this listener was constructed with
+   * \param duration How far back from the current time of the server to request
+   * \param service_name The name of the history service to call
+   */
+  template<class NodeT>
+  void requestHistory(
+    NodeT && node, tf2::Duration duration,
+    const std::string & service_name = "tf2_history")
+  {
+    using GetTransformHistory = tf2_msgs::srv::GetTransformHistory;
+    history_client_ = rclcpp::create_client<GetTransformHistory>(
+      node->get_node_base_interface(),
+      node->get_node_graph_interface(),
+      node->get_node_services_interface(),
+      service_name,
+      rclcpp::ServicesQoS(),
+      callback_group_);
+
+    auto request = std::make_shared<GetTransformHistory::Request>();
+    request->duration = rclcpp::Duration(duration).to_msg();
+    history_client_->async_send_request(
+      request,
+      [this, service_name](rclcpp::Client<GetTransformHistory>::SharedFuture future) {
+        history_callback(future.get()->history, service_name);
+      });
+  }
+
+  /** \brief Also receive transforms sent as tf2_msgs::msg::CompactTFMessage on /tf_compact.
+   *
+   * Compact messages are stored directly by CompactFrameID, without per-transform string
+   * lookups. Broadcasters that send both formats should only be listened to on one of them.
+   *
+   * \param node The node this listener was constructed with
+   * \param qos The QoS of the /tf_compact subscription
+   * \param tf_ns The namespace of /tf_compact
+   */
+  template<class NodeT>
+  void enableCompactFormat(
+    NodeT && node, const rclcpp::QoS & qos = DynamicListenerQoS(),
+    const std::string & tf_ns = "")
+  {
+    rclcpp::SubscriptionOptions options;
+    options.callback_group = callback_group_;
+    options.use_intra_process_comm = rclcpp::IntraProcessSetting::Disable;
+    message_subscription_tf_compact_ =
+      rclcpp::create_subscription<tf2_msgs::msg::CompactTFMessage>(
+      node->get_node_parameters_interface(),
+      node->get_node_topics_interface(),
+      tf_ns + "/tf_compact", qos,
+      std::bind(&TransformListener::compact_subscription_callback, this, std::placeholders::_1),
+      options);
+  }
+
+  /** \brief Also receive the transforms of another namespace, into the same buffer.
+   *
+   * Lets one listener, and its one thread, follow a whole fleet of robots that publish the same
+   * frame names on their own tf_ns/tf and tf_ns/tf_static. Their frames are stored as
+   * tf2::BufferCore::namespacedFrameId(tf_ns, frame), except for the frames added with
+   * tf2::BufferCore::addSharedFrame, through which the trees of different robots connect.
+   *
+   * \param node The node this listener was constructed with
+   * \param tf_ns The namespace of /tf and /tf_static, for example "/robot1"
+   * \param qos The QoS of the tf_ns/tf subscription
+   * \param static_qos The QoS of the tf_ns/tf_static subscription
+   */
+  template<class NodeT>
+  void addNamespace(
+    NodeT && node, const std::string & tf_ns,
+    const rclcpp::QoS & qos = DynamicListenerQoS(),
+    const rclcpp::QoS & static_qos = StaticListenerQoS())
+  {
+    rclcpp::SubscriptionOptions options = detail::get_default_transform_listener_sub_options();
+    options.callback_group = callback_group_;
+    rclcpp::SubscriptionOptions static_options =
+      detail::get_default_transform_listener_static_sub_options();
+    static_options.callback_group = callback_group_;
+
+    namespace_subscriptions_.push_back(
+      rclcpp::create_subscription<tf2_msgs::msg::TFMessage>(
+        node->get_node_parameters_interface(), node->get_node_topics_interface(),
+        tf_ns + "/tf", qos,
+        [this, tf_ns](tf2_msgs::msg::TFMessage::ConstSharedPtr msg) {
+          namespace_subscription_callback(msg, false, tf_ns);
+        },
+        options));
+    namespace_subscriptions_.push_back(
+      rclcpp::create_subscription<tf2_msgs::msg::TFMessage>(
+        node->get_node_parameters_interface(), node->get_node_topics_interface(),
+        tf_ns + "/tf_static", static_qos,
+        [this, tf_ns](tf2_msgs::msg::TFMessage::ConstSharedPtr msg) {
+          namespace_subscription_callback(msg, true, tf_ns);
+        },
+        static_options));
+  }
+
 private:
   template<class AllocatorT = std::allocator<void>>
   void init(
@@ -230,6 +338,20 @@ private:
   TF2_ROS_PUBLIC
   void subscription_callback(tf2_msgs::msg::TFMessage::ConstSharedPtr msg, bool is_static);
 
+  /// Callback function for the subscriptions of addNamespace
+  TF2_ROS_PUBLIC
+  void namespace_subscription_callback(
+    tf2_msgs::msg::TFMessage::ConstSharedPtr msg, bool is_static, const std::string & tf_ns);
+
+  /// Callback function for the /tf_compact subscription
+  TF2_ROS_PUBLIC
+  void compact_subscription_callback(tf2_msgs::msg::CompactTFMessage::ConstSharedPtr msg);
+
+  /// Callback function for the response to requestHistory
+  TF2_ROS_PUBLIC
+  void history_callback(
+    const tf2_msgs::msg::TransformHistory & history, const std::string & service_name);
+
   bool spin_thread_{false};
   std::unique_ptr<std::thread> dedicated_listener_thread_ {nullptr};
   rclcpp::Executor::SharedPtr executor_ {nullptr};
@@ -239,6 +361,11 @@ private:
     message_subscription_tf_ {nullptr};
   rclcpp::Subscription<tf2_msgs::msg::TFMessage>::SharedPtr
     message_subscription_tf_static_ {nullptr};
+  rclcpp::Subscription<tf2_msgs::msg::CompactTFMessage>::SharedPtr
+    message_subscription_tf_compact_ {nullptr};
+  std::vector<rclcpp::Subscription<tf2_msgs::msg::TFMessage>::SharedPtr> namespace_subscriptions_;
+  CompactTFDecoder compact_decoder_;
+  rclcpp::Client<tf2_msgs::srv::GetTransformHistory>::SharedPtr history_client_ {nullptr};
   tf2::BufferCore & buffer_;
   tf2::TimePoint last_update_;
   rclcpp::node_interfaces::NodeLoggingInterface::SharedPtr node_logging_interface_ {nullptr};
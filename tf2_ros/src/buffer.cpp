@@ -31,12 +31,15 @@
 
 
 #include "tf2_ros/buffer.h"
+#include "tf2_ros/transform_history.h"
 
+#include <cstdint>
 #include <exception>
 #include <limits>
 #include <memory>
 #include <mutex>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <thread>
 
@@ -46,7 +49,8 @@ namespace tf2_ros
 Buffer::Buffer(
   rclcpp::Clock::SharedPtr clock, tf2::Duration cache_time,
   rclcpp::Node::SharedPtr node)
-: BufferCore(cache_time), clock_(clock), node_(node), timer_interface_(nullptr)
+: BufferCore(cache_time), frames_cache_period_(std::chrono::seconds(1)), clock_(clock),
+  node_(node), timer_interface_(nullptr)
 {
   if (nullptr == clock_) {
     throw std::invalid_argument("clock must be a valid instance");
@@ -69,6 +73,10 @@ Buffer::Buffer(
       "tf2_frames", std::bind(
         &Buffer::getFrames, this, std::placeholders::_1,
         std::placeholders::_2));
+    history_server_ = node_->create_service<tf2_msgs::srv::GetTransformHistory>(
+      "tf2_history", std::bind(
+        &Buffer::getHistory, this, std::placeholders::_1,
+        std::placeholders::_2));
   }
 }
 
@@ -86,15 +94,66 @@ to_rclcpp(const tf2::Duration & duration)
   return rclcpp::Duration(std::chrono::nanoseconds(duration));
 }
 
+// Retry attempt until it succeeds or the timeout passes, and return whether it succeeded
+template<typename AttemptT>
+bool
+retryUntilTimeout(rclcpp::Clock & clock, const tf2::Duration & timeout, AttemptT && attempt)
+{
+  if (attempt()) {
+    return true;
+  }
+  rclcpp::Duration rclcpp_timeout(to_rclcpp(timeout));
+  rclcpp::Time start_time = clock.now();
+  while (clock.now() < start_time + rclcpp_timeout &&
+    (clock.now() + rclcpp::Duration(3, 0) >= start_time) &&  // don't wait bag loop detected
+    (rclcpp::ok()))  // Make sure we haven't been stopped (won't work for pytf)
+  {
+    // TODO(sloretz) sleep using clock_->sleep_for when implemented
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (attempt()) {
+      return true;
+    }
+  }
+  return false;
+}
+
 geometry_msgs::msg::TransformStamped
 Buffer::lookupTransform(
   const std::string & target_frame, const std::string & source_frame,
   const tf2::TimePoint & lookup_time, const tf2::Duration timeout) const
 {
+  // Poll with the non-throwing lookup, so that the walk which finds the transform also returns it
+  tf2::Transform transform;
+  tf2::TimePoint time_out;
+  auto attempt = [&]() {
+      return lookupTransform(target_frame, source_frame, lookup_time, transform, time_out) ==
+             tf2::TF2Error::TF2_NO_ERROR;
+    };
+  std::string errstr;
+  bool found = checkAndErrorDedicatedThreadPresent(&errstr) ?
+    retryUntilTimeout(*clock_, timeout, attempt) : attempt();
+  if (!found) {
+    // Throws the exception that describes the failure
+    return lookupTransform(target_frame, source_frame, lookup_time);
+  }
+  return tf2::transformToMsg(transform, time_out, target_frame, source_frame);
+}
+
+geometry_msgs::msg::TwistStamped
+Buffer::lookupVelocity(
+  const std::string & tracking_frame, const std::string & observation_frame,
+  const tf2::TimePoint & time, const tf2::Duration & averaging_interval,
+  const tf2::Duration timeout) const
+{
+  // Wait for the end of the interval, the latest data is used as is
+  tf2::TimePoint end_time = time;
+  if (time != tf2::TimePointZero) {
+    end_time += averaging_interval / 2;
+  }
   // Pass error string to suppress console spam
   std::string error;
-  canTransform(target_frame, source_frame, lookup_time, timeout, &error);
-  return lookupTransform(target_frame, source_frame, lookup_time);
+  canTransform(observation_frame, tracking_frame, end_time, timeout, &error);
+  return lookupVelocity(tracking_frame, observation_frame, time, averaging_interval);
 }
 
 void Buffer::onTimeJump(const rcl_time_jump_t & jump)
@@ -104,6 +163,10 @@ void Buffer::onTimeJump(const rcl_time_jump_t & jump)
   {
     RCLCPP_WARN(getLogger(), "Detected time source change. Clearing TF buffer.");
     clear();
+  } else if (jump.delta.nanoseconds < 0 && time_jump_policy_ == TimeJumpPolicy::Rollback) {
+    // This is called after the jump, so now() is the time jumped to
+    RCLCPP_WARN(getLogger(), "Detected jump back in time. Discarding newer TF data.");
+    rollbackTo(fromRclcpp(clock_->now()));
   } else if (jump.delta.nanoseconds < 0) {
     RCLCPP_WARN(getLogger(), "Detected jump back in time. Clearing TF buffer.");
     clear();
@@ -116,10 +179,24 @@ Buffer::lookupTransform(
   const std::string & source_frame, const tf2::TimePoint & source_time,
   const std::string & fixed_frame, const tf2::Duration timeout) const
 {
-  // Pass error string to suppress console spam
-  std::string error;
-  canTransform(target_frame, target_time, source_frame, source_time, fixed_frame, timeout, &error);
-  return lookupTransform(target_frame, target_time, source_frame, source_time, fixed_frame);
+  // Poll with the lookup itself, so that the walk which finds the transform also returns it
+  geometry_msgs::msg::TransformStamped msg;
+  auto attempt = [&]() {
+      try {
+        msg = lookupTransform(target_frame, target_time, source_frame, source_time, fixed_frame);
+        return true;
+      } catch (const tf2::TransformException &) {
+        return false;
+      }
+    };
+  std::string errstr;
+  bool found = checkAndErrorDedicatedThreadPresent(&errstr) ?
+    retryUntilTimeout(*clock_, timeout, attempt) : attempt();
+  if (!found) {
+    // Throws the exception that describes the failure
+    return lookupTransform(target_frame, target_time, source_frame, source_time, fixed_frame);
+  }
+  return msg;
 }
 
 void conditionally_append_timeout_info(
@@ -209,9 +286,10 @@ Buffer::waitForTransform(
   auto promise = std::make_shared<std::promise<geometry_msgs::msg::TransformStamped>>();
   TransformStampedFuture future(promise->get_future());
 
+  // The transform is handed over by the walk that found it, so it is not looked up again
   auto cb = [this, promise, callback, future](
-    tf2::TransformableRequestHandle request_handle, const std::string & target_frame,
-    const std::string & source_frame, tf2::TimePoint time, tf2::TransformableResult result)
+    tf2::TransformableRequestHandle request_handle,
+    const geometry_msgs::msg::TransformStamped & transform, tf2::TransformableResult result)
     {
       (void) request_handle;
 
@@ -235,25 +313,24 @@ Buffer::waitForTransform(
       }
 
       if (result == tf2::TransformAvailable) {
-        geometry_msgs::msg::TransformStamped msg_stamped = this->lookupTransform(
-          target_frame, source_frame, time);
-        promise->set_value(msg_stamped);
+        promise->set_value(transform);
       } else {
         promise->set_exception(
           std::make_exception_ptr(
             tf2::LookupException(
-              "Failed to transform from " + source_frame + " to " + target_frame)));
+              "Failed to transform from " + transform.child_frame_id + " to " +
+              transform.header.frame_id)));
       }
       callback(future);
     };
 
-  auto handle = addTransformableRequest(cb, target_frame, source_frame, time);
+  geometry_msgs::msg::TransformStamped immediate_transform;
+  auto handle = addTransformableRequest(
+    cb, target_frame, source_frame, time, immediate_transform);
   future.setHandle(handle);
   if (0 == handle) {
     // Immediately transformable
-    geometry_msgs::msg::TransformStamped msg_stamped = lookupTransform(
-      target_frame, source_frame, time);
-    promise->set_value(msg_stamped);
+    promise->set_value(immediate_transform);
     callback(future);
   } else if (0xffffffffffffffffULL == handle) {
     // Never transformable
@@ -321,10 +398,119 @@ bool Buffer::getFrames(
   tf2_msgs::srv::FrameGraph::Response::SharedPtr res)
 {
   (void)req;
-  res->frame_yaml = allFramesAsYAML();
+  std::lock_guard<std::mutex> lock(frames_yaml_mutex_);
+  auto now = std::chrono::steady_clock::now();
+  if (frames_yaml_cache_.empty() || now - frames_yaml_rendered_ >= frames_cache_period_) {
+    frames_yaml_cache_ = allFramesAsYAML();
+    frames_yaml_rendered_ = now;
+  }
+  res->frame_yaml = frames_yaml_cache_;
   return true;
 }
 
+bool Buffer::getHistory(
+  const tf2_msgs::srv::GetTransformHistory::Request::SharedPtr req,
+  tf2_msgs::srv::GetTransformHistory::Response::SharedPtr res)
+{
+  tf2::TimePoint since = fromRclcpp(clock_->now()) - fromRclcpp(rclcpp::Duration(req->duration));
+  res->history = toMsg(getTransformHistory(since));
+  return true;
+}
+
+void Buffer::setFramesCachePeriod(const tf2::Duration & period)
+{
+  std::lock_guard<std::mutex> lock(frames_yaml_mutex_);
+  frames_cache_period_ = period;
+  frames_yaml_cache_.clear();
+}
+
+void
+Buffer::startStatisticsPublisher(const tf2::Duration & period)
+{
+  if (!node_) {
+    throw std::runtime_error("Buffer must be constructed with a node to publish statistics");
+  }
+  statistics_pub_ = node_->create_publisher<diagnostic_msgs::msg::DiagnosticArray>(
+    "/diagnostics", 1);
+  resetStatistics();
+  setStatisticsEnabled(true);
+  // Owned by the callback too, so stopping cannot release it while a publication runs
+  auto publisher = statistics_pub_;
+  statistics_timer_ = node_->create_wall_timer(
+    period, [this, publisher]() {publishStatistics(*publisher);});
+}
+
+void
+Buffer::stopStatisticsPublisher()
+{
+  if (statistics_timer_) {
+    statistics_timer_->cancel();
+  }
+  statistics_timer_.reset();
+  statistics_pub_.reset();
+  setStatisticsEnabled(false);
+}
+
+namespace
+{
+
+void addValue(
+  diagnostic_msgs::msg::DiagnosticStatus & status, const std::string & key, uint64_t value)
+{
+  diagnostic_msgs::msg::KeyValue key_value;
+  key_value.key = key;
+  key_value.value = std::to_string(value);
+  status.values.push_back(key_value);
+}
+
+void addHistogram(
+  diagnostic_msgs::msg::DiagnosticStatus & status, const std::string & key,
+  const tf2::HistogramSnapshot & histogram)
+{
+  addValue(status, key + " count", histogram.count);
+  addValue(status, key + " p50", histogram.percentile(0.5));
+  addValue(status, key + " p99", histogram.percentile(0.99));
+  addValue(status, key + " max", histogram.max);
+}
+
+}  // namespace
+
+void
+Buffer::publishStatistics(rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray> & publisher)
+{
+  // Each publication covers the window since the previous one.
+  tf2::BufferCoreStatistics statistics = takeStatistics();
+
+  diagnostic_msgs::msg::DiagnosticStatus status;
+  status.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+  status.name = std::string(node_->get_fully_qualified_name()) + ": tf2 buffer";
+  status.hardware_id = node_->get_name();
+  status.message = "BufferCore statistics";
+  addValue(status, "queries", statistics.queries);
+  addValue(status, "inserts", statistics.inserts);
+  addValue(status, "old data rejections", statistics.old_data_rejections);
+  addValue(status, "late inserts", statistics.late_inserts);
+  addValue(status, "lookup failures", statistics.lookup_failures);
+  addValue(status, "connectivity failures", statistics.connectivity_failures);
+  addValue(status, "extrapolation failures", statistics.extrapolation_failures);
+  addHistogram(status, "query lock wait ns", statistics.query_lock_wait_ns);
+  addHistogram(status, "query lock hold ns", statistics.query_lock_hold_ns);
+  addHistogram(status, "insert lock wait ns", statistics.insert_lock_wait_ns);
+  addHistogram(status, "insert lock hold ns", statistics.insert_lock_hold_ns);
+  addHistogram(status, "chain depth", statistics.chain_depth);
+  addHistogram(status, "cache search steps", statistics.cache_search_steps);
+  addHistogram(status, "transformable requests ns", statistics.transformable_requests_ns);
+  addHistogram(
+    status, "transformable request queue length",
+    statistics.transformable_request_queue_length);
+  addHistogram(status, "insert lateness ns", statistics.insert_lateness_ns);
+
+  diagnostic_msgs::msg::DiagnosticArray array;
+  array.header.stamp = clock_->now();
+  array.status.push_back(status);
+  publisher.publish(array);
+}
+
 bool Buffer::checkAndErrorDedicatedThreadPresent(std::string * error_str) const
 {
   if (isUsingDedicatedThread()) {
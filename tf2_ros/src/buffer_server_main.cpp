@@ -49,7 +49,8 @@ int main(int argc, char ** argv)
   auto node = std::make_shared<rclcpp::Node>("tf_buffer");
   double buffer_size = node->declare_parameter("buffer_size", 120.0);
 
-  tf2_ros::Buffer buffer(node->get_clock(), tf2::durationFromSec(buffer_size));
+  // Passing the node also serves "tf2_history" for listeners that backfill on startup
+  tf2_ros::Buffer buffer(node->get_clock(), tf2::durationFromSec(buffer_size), node);
   tf2_ros::TransformListener listener(buffer);
   tf2_ros::BufferServer buffer_server(buffer, node, "tf2_buffer_server");
 
@@ -0,0 +1,148 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "tf2_ros/compact_tf.h"
+
+namespace tf2_ros
+{
+
+namespace
+{
+constexpr size_t VALUES_PER_TRANSFORM = 7;
+}  // namespace
+
+CompactTFEncoder::CompactTFEncoder(tf2::Duration dictionary_period)
+: dictionary_period_(dictionary_period)
+{
+  std::random_device device;
+  sender_id_ = (static_cast<uint64_t>(device()) << 32) ^ device();
+}
+
+uint32_t CompactTFEncoder::intern(const std::string & frame_id)
+{
+  auto inserted = frame_ids_.emplace(frame_id, static_cast<uint32_t>(frame_names_.size()));
+  if (inserted.second) {
+    frame_names_.push_back(frame_id);
+  }
+  return inserted.first->second;
+}
+
+void CompactTFEncoder::encode(
+  const std::vector<geometry_msgs::msg::TransformStamped> & transforms,
+  tf2_msgs::msg::CompactTFMessage & message)
+{
+  size_t count = transforms.size();
+  message.sender_id = sender_id_;
+  message.parent_ids.clear();
+  message.child_ids.clear();
+  message.stamps.clear();
+  message.values.clear();
+  message.parent_ids.reserve(count);
+  message.child_ids.reserve(count);
+  message.stamps.reserve(count);
+  message.values.reserve(count * VALUES_PER_TRANSFORM);
+
+  for (const geometry_msgs::msg::TransformStamped & transform : transforms) {
+    message.parent_ids.push_back(intern(transform.header.frame_id));
+    message.child_ids.push_back(intern(transform.child_frame_id));
+    message.stamps.push_back(
+      static_cast<int64_t>(transform.header.stamp.sec) * 1000000000LL +
+      transform.header.stamp.nanosec);
+    const auto & t = transform.transform.translation;
+    const auto & r = transform.transform.rotation;
+    message.values.insert(message.values.end(), {t.x, t.y, t.z, r.x, r.y, r.z, r.w});
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  size_t first = frames_sent_;
+  if (now - dictionary_sent_ >= dictionary_period_) {
+    first = 0;
+    dictionary_sent_ = now;
+  }
+  message.dictionary_offset = static_cast<uint32_t>(first);
+  message.dictionary.assign(frame_names_.begin() + first, frame_names_.end());
+  frames_sent_ = frame_names_.size();
+}
+
+CompactTFDecoder::CompactTFDecoder(tf2::Duration sender_timeout)
+: sender_timeout_(sender_timeout)
+{
+}
+
+size_t CompactTFDecoder::decode(
+  const tf2_msgs::msg::CompactTFMessage & message, tf2::BufferCore & buffer,
+  const std::string & authority)
+{
+  auto now = std::chrono::steady_clock::now();
+  auto inserted = senders_.try_emplace(message.sender_id);
+  if (inserted.second) {
+    // A new sender, often a restarted one, forget those that went quiet
+    for (auto it = senders_.begin(); it != senders_.end(); ) {
+      if (it != inserted.first && now - it->second.last_seen >= sender_timeout_) {
+        it = senders_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  Sender & sender = inserted.first->second;
+  sender.last_seen = now;
+  std::vector<tf2::CompactFrameID> & frames = sender.frames;
+
+  // Names are only resolved the first time they are seen, not on every dictionary refresh
+  if (!message.dictionary.empty()) {
+    size_t offset = message.dictionary_offset;
+    if (offset > frames.size()) {
+      // Names before it were missed, or the offset is bogus, wait for the whole dictionary
+      return 0;
+    }
+    size_t end = offset + message.dictionary.size();
+    if (end > frames.size()) {
+      frames.resize(end, 0);
+    }
+    if (std::find(frames.begin() + offset, frames.begin() + end, 0) != frames.begin() + end) {
+      buffer.resolveFrameNumbers(message.dictionary, resolved_);
+      std::copy(resolved_.begin(), resolved_.end(), frames.begin() + offset);
+    }
+  }
+
+  size_t count = std::min(
+    {message.parent_ids.size(), message.child_ids.size(), message.stamps.size(),
+      message.values.size() / VALUES_PER_TRANSFORM});
+  transforms_.clear();
+  transforms_.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t parent = message.parent_ids[i];
+    uint32_t child = message.child_ids[i];
+    if (parent >= frames.size() || child >= frames.size()) {
+      continue;
+    }
+    const double * v = &message.values[i * VALUES_PER_TRANSFORM];
+    transforms_.emplace_back(
+      tf2::TimePoint(std::chrono::nanoseconds(message.stamps[i])),
+      tf2::Quaternion(v[3], v[4], v[5], v[6]),
+      tf2::Vector3(v[0], v[1], v[2]),
+      frames[parent], frames[child]);
+  }
+  return buffer.setCompactTransforms(transforms_, authority);
+}
+
+}  // namespace tf2_ros
@@ -31,10 +31,20 @@
 /** \author Wim Meeussen */
 
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <iomanip>
+#include <iostream>
 #include <map>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "tf2_ros/buffer.h"
@@ -44,6 +54,264 @@
 #include "rclcpp/rclcpp.hpp"
 #include "tf2_msgs/msg/tf_message.hpp"
 
+namespace
+{
+
+/// The most recent samples of a series, with O(1) insertion, mean and max.
+class RollingWindow
+{
+public:
+  explicit RollingWindow(size_t capacity = 1000)
+  : samples_(capacity), head_(0), size_(0), pushed_(0), sum_(0.0), sum_squares_(0.0)
+  {
+  }
+
+  void push(double value)
+  {
+    if (size_ == samples_.size()) {
+      sum_ -= samples_[head_];
+      sum_squares_ -= samples_[head_] * samples_[head_];
+    } else {
+      ++size_;
+    }
+    samples_[head_] = value;
+    sum_ += value;
+    sum_squares_ += value * value;
+    head_ = (head_ + 1) % samples_.size();
+    if (head_ == 0) {
+      // Recompute the sums once per lap so that rounding errors cannot accumulate
+      sum_ = 0.0;
+      sum_squares_ = 0.0;
+      for (size_t i = 0; i < size_; ++i) {
+        sum_ += samples_[i];
+        sum_squares_ += samples_[i] * samples_[i];
+      }
+    }
+
+    // Candidates for the maximum, in decreasing order of value
+    while (!max_candidates_.empty() && max_candidates_.back().second <= value) {
+      max_candidates_.pop_back();
+    }
+    max_candidates_.emplace_back(pushed_++, value);
+    if (max_candidates_.front().first + size_ < pushed_) {
+      max_candidates_.pop_front();
+    }
+  }
+
+  size_t size() const {return size_;}
+
+  double mean() const {return size_ == 0 ? 0.0 : sum_ / static_cast<double>(size_);}
+
+  double max() const {return max_candidates_.empty() ? 0.0 : max_candidates_.front().second;}
+
+  double stddev() const
+  {
+    if (size_ < 2) {
+      return 0.0;
+    }
+    double mean_value = mean();
+    double variance = sum_squares_ / static_cast<double>(size_) - mean_value * mean_value;
+    return std::sqrt(std::max(0.0, variance));
+  }
+
+  double oldest() const {return samples_[(head_ + samples_.size() - size_) % samples_.size()];}
+
+  double newest() const {return samples_[(head_ + samples_.size() - 1) % samples_.size()];}
+
+private:
+  std::vector<double> samples_;
+  size_t head_;
+  size_t size_;
+  size_t pushed_;
+  double sum_;
+  double sum_squares_;
+  std::deque<std::pair<size_t, double>> max_candidates_;
+};
+
+/// Streaming estimate of a quantile in constant space, using the P-square algorithm of
+/// Jain and Chlamtac.
+class P2Quantile
+{
+public:
+  explicit P2Quantile(double p)
+  : p_(p), count_(0), increments_{0.0, p / 2.0, p, (1.0 + p) / 2.0, 1.0}
+  {
+  }
+
+  void add(double x)
+  {
+    if (count_ < 5) {
+      heights_[count_++] = x;
+      if (count_ == 5) {
+        std::sort(heights_.begin(), heights_.end());
+        for (size_t i = 0; i < 5; ++i) {
+          positions_[i] = static_cast<double>(i + 1);
+          desired_[i] = 1.0 + 4.0 * increments_[i];
+        }
+      }
+      return;
+    }
+    ++count_;
+
+    // Find the cell containing x, extending the extremes if needed
+    size_t cell = 0;
+    if (x < heights_[0]) {
+      heights_[0] = x;
+    } else if (x >= heights_[4]) {
+      heights_[4] = x;
+      cell = 3;
+    } else {
+      while (x >= heights_[cell + 1]) {
+        ++cell;
+      }
+    }
+    for (size_t i = cell + 1; i < 5; ++i) {
+      positions_[i] += 1.0;
+    }
+    for (size_t i = 0; i < 5; ++i) {
+      desired_[i] += increments_[i];
+    }
+
+    // Move the middle markers towards their desired positions
+    for (size_t i = 1; i < 4; ++i) {
+      double d = desired_[i] - positions_[i];
+      if ((d >= 1.0 && positions_[i + 1] - positions_[i] > 1.0) ||
+        (d <= -1.0 && positions_[i - 1] - positions_[i] < -1.0))
+      {
+        double sign = d >= 0.0 ? 1.0 : -1.0;
+        double height = parabolic(i, sign);
+        if (heights_[i - 1] < height && height < heights_[i + 1]) {
+          heights_[i] = height;
+        } else {
+          heights_[i] = linear(i, sign);
+        }
+        positions_[i] += sign;
+      }
+    }
+  }
+
+  double value() const
+  {
+    if (count_ == 0) {
+      return 0.0;
+    }
+    if (count_ < 5) {
+      std::array<double, 5> sorted = heights_;
+      std::sort(sorted.begin(), sorted.begin() + count_);
+      size_t index = std::min(count_ - 1, static_cast<size_t>(p_ * static_cast<double>(count_)));
+      return sorted[index];
+    }
+    return heights_[2];
+  }
+
+private:
+  double parabolic(size_t i, double sign) const
+  {
+    const double n_prev = positions_[i - 1];
+    const double n = positions_[i];
+    const double n_next = positions_[i + 1];
+    return heights_[i] + sign / (n_next - n_prev) * (
+      (n - n_prev + sign) * (heights_[i + 1] - heights_[i]) / (n_next - n) +
+      (n_next - n - sign) * (heights_[i] - heights_[i - 1]) / (n - n_prev));
+  }
+
+  double linear(size_t i, double sign) const
+  {
+    size_t j = sign > 0.0 ? i + 1 : i - 1;
+    return heights_[i] + sign * (heights_[j] - heights_[i]) / (positions_[j] - positions_[i]);
+  }
+
+  double p_;
+  size_t count_;
+  std::array<double, 5> heights_{};
+  std::array<double, 5> positions_{};
+  std::array<double, 5> desired_{};
+  std::array<double, 5> increments_;
+};
+
+/// Delay statistics: mean and max over the last 1000 samples, and p50 and p99 since startup.
+struct DelayStatistics
+{
+  RollingWindow window;
+  P2Quantile p50{0.5};
+  P2Quantile p99{0.99};
+
+  void add(double delay)
+  {
+    window.push(delay);
+    p50.add(delay);
+    p99.add(delay);
+  }
+};
+
+struct FrameStatistics
+{
+  explicit FrameStatistics(const std::string & frame_id)
+  : name(frame_id) {}
+
+  std::string name;
+  std::string authority;
+  DelayStatistics delay;
+
+  /// Time between consecutive messages, for the publish rate and its jitter
+  RollingWindow intervals;
+  double last_arrival = -1.0;
+  tf2::TimePoint latest_stamp;
+  uint64_t messages = 0;
+  /// Messages older than the newest stamp seen for the frame
+  uint64_t out_of_order = 0;
+  /// Messages too old for the cache, which the buffer drops with TF_OLD_DATA
+  uint64_t late = 0;
+
+  double rate() const
+  {
+    return intervals.mean() > 0.0 ? 1.0 / intervals.mean() : 0.0;
+  }
+};
+
+struct AuthorityStatistics
+{
+  DelayStatistics delay;
+  RollingWindow arrivals;
+};
+
+/// Machine readable output of the profiling mode
+enum class ProfileFormat
+{
+  None,
+  Csv,
+  Json,
+};
+
+std::string jsonString(const std::string & in)
+{
+  std::string out = "\"";
+  for (char c : in) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out += escaped;
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
+std::string jsonDelay(const DelayStatistics & delay)
+{
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(9) << "{\"avg\":" << delay.window.mean() <<
+    ",\"max\":" << delay.window.max() << ",\"p50\":" << delay.p50.value() <<
+    ",\"p99\":" << delay.p99.value() << "}";
+  return ss.str();
+}
+
+}  // namespace
+
 class TFMonitor
 {
 public:
@@ -53,10 +321,10 @@ public:
   rclcpp::Node::SharedPtr node_;
   rclcpp::Subscription<tf2_msgs::msg::TFMessage>::SharedPtr subscriber_tf_, subscriber_tf_message_;
   std::vector<std::string> chain_;
-  std::map<std::string, std::string> frame_authority_map;
-  std::map<std::string, std::vector<double>> delay_map;
-  std::map<std::string, std::vector<double>> authority_map;
-  std::map<std::string, std::vector<double>> authority_frequency_map;
+  // Frames are interned on first sight, statistics are indexed by the interned ID
+  std::unordered_map<std::string, size_t> frame_ids_;
+  std::vector<FrameStatistics> frame_statistics_;
+  std::map<std::string, AuthorityStatistics> authority_statistics_;
 
   rclcpp::Clock::SharedPtr clock_;
   tf2_ros::Buffer buffer_;
@@ -65,57 +333,62 @@ public:
   tf2_msgs::msg::TFMessage message_;
   std::mutex map_mutex_;
 
+  ProfileFormat profile_format_ = ProfileFormat::None;
+  /// Latency of lookupTransform between framea and frameb, measured in profiling mode
+  DelayStatistics lookup_latency_;
+  uint64_t lookups_ = 0;
+  uint64_t lookup_failures_ = 0;
+
+  FrameStatistics & frameStatistics(const std::string & frame_id)
+  {
+    auto inserted = frame_ids_.try_emplace(frame_id, frame_statistics_.size());
+    if (inserted.second) {
+      frame_statistics_.emplace_back(frame_id);
+    }
+    return frame_statistics_[inserted.first->second];
+  }
+
   void callback(const tf2_msgs::msg::TFMessage::ConstSharedPtr msg)
   {
     const tf2_msgs::msg::TFMessage & message = *(msg);
     // TODO(tfoote): recover authority info
-    std::string authority = "<no authority available>";
+    static const std::string authority = "<no authority available>";
 
+    const double now = clock_->now().seconds();
+    const tf2::Duration cache_time = buffer_.getCacheLength();
     double average_offset = 0;
     std::unique_lock<std::mutex> my_lock(map_mutex_);
     for (size_t i = 0; i < message.transforms.size(); i++) {
-      frame_authority_map[message.transforms[i].child_frame_id] = authority;
+      FrameStatistics & frame = frameStatistics(message.transforms[i].child_frame_id);
+      frame.authority = authority;
 
-      double offset = clock_->now().seconds() - tf2_ros::timeToSec(
-        message.transforms[i].header.stamp);
+      double offset = now - tf2_ros::timeToSec(message.transforms[i].header.stamp);
       average_offset += offset;
+      frame.delay.add(offset);
 
-      std::map<std::string, std::vector<double>>::iterator it = delay_map.find(
-        message.transforms[i].child_frame_id);
-      if (it == delay_map.end()) {
-        delay_map[message.transforms[i].child_frame_id] = std::vector<double>(1, offset);
-      } else {
-        it->second.push_back(offset);
-        if (it->second.size() > 1000) {
-          it->second.erase(it->second.begin());
+      if (frame.last_arrival >= 0.0) {
+        frame.intervals.push(now - frame.last_arrival);
+      }
+      frame.last_arrival = now;
+      tf2::TimePoint stamp = tf2_ros::fromMsg(message.transforms[i].header.stamp);
+      if (frame.messages > 0 && stamp < frame.latest_stamp) {
+        ++frame.out_of_order;
+        // Same test as TimeCache::insertData
+        if (frame.latest_stamp > stamp + cache_time) {
+          ++frame.late;
         }
+      } else {
+        frame.latest_stamp = stamp;
       }
+      ++frame.messages;
     }
 
     average_offset /= std::max(static_cast<size_t>(1), message.transforms.size());
 
     // create the authority log
-    std::map<std::string, std::vector<double>>::iterator it2 = authority_map.find(authority);
-    if (it2 == authority_map.end()) {
-      authority_map[authority] = std::vector<double>(1, average_offset);
-    } else {
-      it2->second.push_back(average_offset);
-      if (it2->second.size() > 1000) {
-        it2->second.erase(it2->second.begin());
-      }
-    }
-
-    // create the authority frequency log
-    std::map<std::string, std::vector<double>>::iterator it3 = authority_frequency_map.find(
-      authority);
-    if (it3 == authority_frequency_map.end()) {
-      authority_frequency_map[authority] = std::vector<double>(1, clock_->now().seconds());
-    } else {
-      it3->second.push_back(clock_->now().seconds());
-      if (it3->second.size() > 1000) {
-        it3->second.erase(it3->second.begin());
-      }
-    }
+    AuthorityStatistics & authority_statistics = authority_statistics_[authority];
+    authority_statistics.delay.add(average_offset);
+    authority_statistics.arrivals.push(now);
   }
 
   TFMonitor(
@@ -160,20 +433,14 @@ public:
       std::bind(&TFMonitor::callback, this, std::placeholders::_1));
   }
 
-  std::string outputFrameInfo(
-    const std::map<std::string, std::vector<double>>::iterator & it,
-    const std::string & frame_authority)
+  std::string outputFrameInfo(const FrameStatistics & frame)
   {
     std::stringstream ss;
-    double average_delay = 0;
-    double max_delay = 0;
-    for (size_t i = 0; i < it->second.size(); i++) {
-      average_delay += it->second[i];
-      max_delay = std::max(max_delay, it->second[i]);
-    }
-    average_delay /= it->second.size();
-    ss << "Frame: " << it->first << ", published by " << frame_authority << ", Average Delay: " <<
-      average_delay << ", Max Delay: " << max_delay << std::endl;
+    ss << "Frame: " << frame.name << ", published by " << frame.authority <<
+      ", Average Delay: " << frame.delay.window.mean() <<
+      ", Max Delay: " << frame.delay.window.max() <<
+      ", p50 Delay: " << frame.delay.p50.value() <<
+      ", p99 Delay: " << frame.delay.p99.value() << std::endl;
     return ss.str();
   }
 
@@ -185,16 +452,35 @@ public:
     double lowpass = 0.01;
     unsigned int counter = 0;
 
+    // The profiling mode samples the chain more often to measure the lookup latency
+    const bool profiling = profile_format_ != ProfileFormat::None;
+    const std::chrono::milliseconds period(profiling ? 10 : 500);
+    const unsigned int samples_per_report = profiling ? 1000 : 20;
+
+    std::ostream & banner = profiling ? std::cerr : std::cout;
     if (using_specific_chain_) {
-      std::cout << "Gathering data on " << framea_ << " -> " << frameb_ << " for 10 seconds...\n";
+      banner << "Gathering data on " << framea_ << " -> " << frameb_ << " for 10 seconds...\n";
     } else {
-      std::cout << "Gathering data on all frames for 10 seconds...\n";
+      banner << "Gathering data on all frames for 10 seconds...\n";
+    }
+    if (profile_format_ == ProfileFormat::Csv) {
+      std::cout << "time,kind,name,authority,count,rate_hz,jitter_s,avg_s,max_s,p50_s,p99_s,"
+        "out_of_order,late,failures" << std::endl;
     }
-
 
     while (rclcpp::ok()) {
       counter++;
-      if (using_specific_chain_) {
+      if (using_specific_chain_ && profiling) {
+        auto start = std::chrono::steady_clock::now();
+        try {
+          buffer_.lookupTransform(framea_, frameb_, tf2::TimePointZero);
+        } catch (const tf2::TransformException &) {
+          ++lookup_failures_;
+        }
+        ++lookups_;
+        lookup_latency_.add(
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+      } else if (using_specific_chain_) {
         auto tmp = buffer_.lookupTransform(framea_, frameb_, tf2::TimePointZero);
         double diff = clock_->now().seconds() - tf2_ros::timeToSec(tmp.header.stamp);
         avg_diff = lowpass * diff + (1 - lowpass) * avg_diff;
@@ -202,10 +488,15 @@ public:
           max_diff = diff;
         }
       }
-      std::this_thread::sleep_for(std::chrono::milliseconds(500));
-      if (counter > 20) {
+      std::this_thread::sleep_for(period);
+      if (counter > samples_per_report) {
         counter = 0;
 
+        if (profiling) {
+          outputProfile();
+          continue;
+        }
+
         if (using_specific_chain_) {
           std::cout << std::endl << std::endl << std::endl << "RESULTS: for " << framea_ <<
             " to " << frameb_ << std::endl;
@@ -225,39 +516,95 @@ public:
         }
         std::unique_lock<std::mutex> lock(map_mutex_);
         std::cout << std::endl << "Frames:" << std::endl;
-        std::map<std::string, std::vector<double>>::iterator it = delay_map.begin();
-        for ( ; it != delay_map.end(); ++it) {
-          if (using_specific_chain_) {
-            for (size_t i = 0; i < chain_.size(); i++) {
-              if (it->first != chain_[i]) {
-                continue;
-              }
-
-              std::cout << outputFrameInfo(it, frame_authority_map[it->first]);
-            }
-          } else {
-            std::cout << outputFrameInfo(it, frame_authority_map[it->first]);
-          }
+        for (const FrameStatistics * frame : reportedFrames()) {
+          std::cout << outputFrameInfo(*frame);
         }
         std::cerr << std::endl << "All Broadcasters:" << std::endl;
-        std::map<std::string, std::vector<double>>::iterator it1 = authority_map.begin();
-        std::map<std::string, std::vector<double>>::iterator it2 = authority_frequency_map.begin();
-        for ( ; it1 != authority_map.end(); ++it1, ++it2) {
-          double average_delay = 0;
-          double max_delay = 0;
-          for (size_t i = 0; i < it1->second.size(); i++) {
-            average_delay += it1->second[i];
-            max_delay = std::max(max_delay, it1->second[i]);
-          }
-          average_delay /= it1->second.size();
-          double frequency_out = static_cast<double>(it2->second.size()) /
-            std::max(0.00000001, (it2->second.back() - it2->second.front()));
-          std::cout << "Node: " << it1->first << " " << frequency_out << " Hz, Average Delay: " <<
-            average_delay << " Max Delay: " << max_delay << std::endl;
+        for (const auto & authority : authority_statistics_) {
+          const AuthorityStatistics & statistics = authority.second;
+          double frequency_out = static_cast<double>(statistics.arrivals.size()) /
+            std::max(0.00000001, (statistics.arrivals.newest() - statistics.arrivals.oldest()));
+          std::cout << "Node: " << authority.first << " " << frequency_out <<
+            " Hz, Average Delay: " << statistics.delay.window.mean() <<
+            " Max Delay: " << statistics.delay.window.max() << std::endl;
         }
       }
     }
   }
+
+  /// Frames to report on, in chain order or sorted by name
+  std::vector<const FrameStatistics *> reportedFrames()
+  {
+    std::vector<const FrameStatistics *> frames;
+    if (using_specific_chain_) {
+      for (const std::string & frame_id : chain_) {
+        auto it = frame_ids_.find(frame_id);
+        if (it != frame_ids_.end()) {
+          frames.push_back(&frame_statistics_[it->second]);
+        }
+      }
+    } else {
+      for (const FrameStatistics & frame : frame_statistics_) {
+        frames.push_back(&frame);
+      }
+      std::sort(
+        frames.begin(), frames.end(),
+        [](const FrameStatistics * a, const FrameStatistics * b) {return a->name < b->name;});
+    }
+    return frames;
+  }
+
+  /// Write one profiling report, as CSV rows or as a line of JSON.
+  /**
+   * For frames the avg/max/p50/p99 columns are the receive delay, for the lookup row they are
+   * the lookupTransform latency. All times are in seconds, printed to the nanosecond so that
+   * microsecond latencies do not round to zero.
+   */
+  void outputProfile()
+  {
+    std::unique_lock<std::mutex> lock(map_mutex_);
+    const double now = clock_->now().seconds();
+    const std::vector<const FrameStatistics *> frames = reportedFrames();
+    const std::string chain_name = framea_ + "->" + frameb_;
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(9);
+    if (profile_format_ == ProfileFormat::Csv) {
+      for (const FrameStatistics * frame : frames) {
+        ss << now << ",frame," << frame->name << "," << frame->authority << "," <<
+          frame->messages << "," << frame->rate() << "," << frame->intervals.stddev() << "," <<
+          frame->delay.window.mean() << "," << frame->delay.window.max() << "," <<
+          frame->delay.p50.value() << "," << frame->delay.p99.value() << "," <<
+          frame->out_of_order << "," << frame->late << "," << std::endl;
+      }
+      if (using_specific_chain_) {
+        ss << now << ",lookup," << chain_name << ",," << lookups_ << ",,," <<
+          lookup_latency_.window.mean() << "," << lookup_latency_.window.max() << "," <<
+          lookup_latency_.p50.value() << "," << lookup_latency_.p99.value() << ",,," <<
+          lookup_failures_ << std::endl;
+      }
+    } else {
+      ss << "{\"time\":" << now << ",\"frames\":[";
+      for (size_t i = 0; i < frames.size(); ++i) {
+        const FrameStatistics * frame = frames[i];
+        ss << (i == 0 ? "" : ",") << "{\"frame\":" << jsonString(frame->name) <<
+          ",\"authority\":" << jsonString(frame->authority) <<
+          ",\"messages\":" << frame->messages << ",\"rate_hz\":" << frame->rate() <<
+          ",\"jitter_s\":" << frame->intervals.stddev() <<
+          ",\"delay_s\":" << jsonDelay(frame->delay) <<
+          ",\"out_of_order\":" << frame->out_of_order << ",\"late\":" << frame->late << "}";
+      }
+      ss << "]";
+      if (using_specific_chain_) {
+        ss << ",\"lookup\":{\"target\":" << jsonString(framea_) <<
+          ",\"source\":" << jsonString(frameb_) << ",\"count\":" << lookups_ <<
+          ",\"failures\":" << lookup_failures_ <<
+          ",\"latency_s\":" << jsonDelay(lookup_latency_) << "}";
+      }
+      ss << "}" << std::endl;
+    }
+    std::cout << ss.str() << std::flush;
+  }
 };
 
 
@@ -269,15 +616,34 @@ int main(int argc, char ** argv)
   // TODO(tfoote): make anonymous
   rclcpp::Node::SharedPtr nh = rclcpp::Node::make_shared("tf2_monitor_main");
 
+  // Pull out the profiling option, the remaining arguments are the frames
+  ProfileFormat profile_format = ProfileFormat::None;
+  std::vector<std::string> frames;
+  bool valid_args = true;
+  for (size_t i = 1; i < args.size(); ++i) {
+    if (args[i] == "--profile" && i + 1 < args.size() && args[i + 1] == "csv") {
+      profile_format = ProfileFormat::Csv;
+      ++i;
+    } else if (args[i] == "--profile" && i + 1 < args.size() && args[i + 1] == "json") {
+      profile_format = ProfileFormat::Json;
+      ++i;
+    } else if (args[i] == "--profile") {
+      valid_args = false;
+    } else {
+      frames.push_back(args[i]);
+    }
+  }
+
   std::string framea, frameb;
   bool using_specific_chain = true;
-  if (args.size() == 3) {
-    framea = args[1];
-    frameb = args[2];
-  } else if (args.size() == 1) {
+  if (valid_args && frames.size() == 2) {
+    framea = frames[0];
+    frameb = frames[1];
+  } else if (valid_args && frames.empty()) {
     using_specific_chain = false;
   } else {
-    RCLCPP_INFO(nh->get_logger(), "TF_Monitor: usage: tf2_monitor framea frameb");
+    RCLCPP_INFO(
+      nh->get_logger(), "TF_Monitor: usage: tf2_monitor [--profile csv|json] [framea frameb]");
     return -1;
   }
 
@@ -302,6 +668,7 @@ int main(int argc, char ** argv)
       return rclcpp::spin(node);
     };
   TFMonitor monitor(nh, using_specific_chain, framea, frameb);
+  monitor.profile_format_ = profile_format;
   std::thread spinner(run_func, nh);
 
   monitor.spin();
@@ -32,6 +32,7 @@
 
 #include "tf2_ros/transform_broadcaster.h"
 
+#include <mutex>
 #include <vector>
 
 #include "geometry_msgs/msg/transform_stamped.hpp"
@@ -51,6 +52,19 @@ void TransformBroadcaster::sendTransform(const geometry_msgs::msg::TransformStam
 void TransformBroadcaster::sendTransform(
   const std::vector<geometry_msgs::msg::TransformStamped> & msgtf)
 {
+  bool publish_tf = true;
+  {
+    std::lock_guard<std::mutex> lock(compact_mutex_);
+    if (compact_publisher_) {
+      compact_encoder_->encode(msgtf, compact_message_);
+      compact_publisher_->publish(compact_message_);
+      publish_tf = publish_tf_;
+    }
+  }
+  if (!publish_tf) {
+    return;
+  }
+
   tf2_msgs::msg::TFMessage message;
   for (std::vector<geometry_msgs::msg::TransformStamped>::const_iterator it = msgtf.begin();
     it != msgtf.end(); ++it)
@@ -0,0 +1,78 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include "tf2_ros/transform_history.h"
+
+namespace tf2_ros
+{
+
+namespace
+{
+constexpr size_t VALUES_PER_TRANSFORM = 7;
+}  // namespace
+
+tf2_msgs::msg::TransformHistory
+toMsg(const tf2::TransformHistory & history)
+{
+  tf2_msgs::msg::TransformHistory msg;
+  msg.frame_ids = history.frame_ids;
+
+  size_t count = history.transforms.size();
+  msg.parent_indices.reserve(count);
+  msg.child_indices.reserve(count);
+  msg.stamps.reserve(count);
+  msg.values.reserve(count * VALUES_PER_TRANSFORM);
+  for (const tf2::TransformStorage & storage : history.transforms) {
+    msg.parent_indices.push_back(storage.frame_id_);
+    msg.child_indices.push_back(storage.child_frame_id_);
+    msg.stamps.push_back(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        storage.stamp_.time_since_epoch()).count());
+    msg.values.push_back(storage.translation_.x());
+    msg.values.push_back(storage.translation_.y());
+    msg.values.push_back(storage.translation_.z());
+    msg.values.push_back(storage.rotation_.x());
+    msg.values.push_back(storage.rotation_.y());
+    msg.values.push_back(storage.rotation_.z());
+    msg.values.push_back(storage.rotation_.w());
+  }
+  return msg;
+}
+
+tf2::TransformHistory
+fromMsg(const tf2_msgs::msg::TransformHistory & msg)
+{
+  tf2::TransformHistory history;
+  history.frame_ids = msg.frame_ids;
+
+  size_t count = std::min(
+    {msg.parent_indices.size(), msg.child_indices.size(), msg.stamps.size(),
+      msg.values.size() / VALUES_PER_TRANSFORM});
+  history.transforms.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    const double * v = &msg.values[i * VALUES_PER_TRANSFORM];
+    history.transforms.emplace_back(
+      tf2::TimePoint(std::chrono::nanoseconds(msg.stamps[i])),
+      tf2::Quaternion(v[3], v[4], v[5], v[6]),
+      tf2::Vector3(v[0], v[1], v[2]),
+      msg.parent_indices[i], msg.child_indices[i]);
+  }
+  return history;
+}
+
+}  // namespace tf2_ros
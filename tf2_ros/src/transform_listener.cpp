@@ -35,11 +35,23 @@
 #include <thread>
 #include <utility>
 
+#include "tf2/tracing.h"
+#include "tf2_ros/transform_history.h"
 #include "tf2_ros/transform_listener.h"
 
 namespace tf2_ros
 {
 
+namespace
+{
+// TODO(tfoote) find a way to get the authority
+const std::string & undetectableAuthority()
+{
+  static const std::string authority = "Authority undetectable";
+  return authority;
+}
+}  // namespace
+
 TransformListener::TransformListener(tf2::BufferCore & buffer, bool spin_thread)
 : buffer_(buffer)
 {
@@ -78,23 +90,51 @@ TransformListener::~TransformListener()
 void TransformListener::subscription_callback(
   const tf2_msgs::msg::TFMessage::ConstSharedPtr msg,
   bool is_static)
+{
+  namespace_subscription_callback(msg, is_static, std::string());
+}
+
+void TransformListener::namespace_subscription_callback(
+  const tf2_msgs::msg::TFMessage::ConstSharedPtr msg,
+  bool is_static, const std::string & tf_ns)
 {
   const tf2_msgs::msg::TFMessage & msg_in = *msg;
-  // TODO(tfoote) find a way to get the authority
-  std::string authority = "Authority undetectable";
+  TF2_TRACEPOINT(transform_listener_callback_entry, this, msg_in.transforms.size(), is_static);
+  const std::string & authority = undetectableAuthority();
   for (size_t i = 0u; i < msg_in.transforms.size(); i++) {
     try {
-      buffer_.setTransform(msg_in.transforms[i], authority, is_static);
+      buffer_.setTransform(msg_in.transforms[i], authority, is_static, tf_ns);
     } catch (const tf2::TransformException & ex) {
       // /\todo Use error reporting
       std::string temp = ex.what();
       RCLCPP_ERROR(
         node_logging_interface_->get_logger(),
-        "Failure to set received transform from %s to %s with error: %s\n",
+        "Failure to set received transform from %s to %s%s%s with error: %s\n",
         msg_in.transforms[i].child_frame_id.c_str(),
-        msg_in.transforms[i].header.frame_id.c_str(), temp.c_str());
+        msg_in.transforms[i].header.frame_id.c_str(), tf_ns.empty() ? "" : " in ",
+        tf_ns.c_str(), temp.c_str());
     }
   }
+  TF2_TRACEPOINT(transform_listener_callback_exit, this);
+}
+
+void TransformListener::compact_subscription_callback(
+  const tf2_msgs::msg::CompactTFMessage::ConstSharedPtr msg)
+{
+  TF2_TRACEPOINT(transform_listener_callback_entry, this, msg->stamps.size(), false);
+  compact_decoder_.decode(*msg, buffer_, undetectableAuthority());
+  TF2_TRACEPOINT(transform_listener_callback_exit, this);
+}
+
+void TransformListener::history_callback(
+  const tf2_msgs::msg::TransformHistory & history,
+  const std::string & service_name)
+{
+  size_t stored = buffer_.setTransformHistory(fromMsg(history), service_name);
+  RCLCPP_DEBUG(
+    node_logging_interface_->get_logger(),
+    "Backfilled %zu of %zu transforms from %s", stored, history.stamps.size(),
+    service_name.c_str());
 }
 
 }  // namespace tf2_ros
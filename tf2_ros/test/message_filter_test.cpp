@@ -119,6 +119,56 @@ TEST(tf2_ros_message_filter, construction_and_destruction)
   }
 }
 
+uint8_t immediate_callback_fired = 0;
+void immediate_callback(const geometry_msgs::msg::PointStamped & msg)
+{
+  (void)msg;
+  immediate_callback_fired++;
+}
+
+TEST(tf2_ros_message_filter, immediately_transformable)
+{
+  auto node = rclcpp::Node::make_shared("tf2_ros_message_filter_immediate");
+
+  auto create_timer_interface = std::make_shared<tf2_ros::CreateTimerROS>(
+    node->get_node_base_interface(),
+    node->get_node_timers_interface());
+
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  buffer.setCreateTimerInterface(create_timer_interface);
+  tf2_ros::MessageFilter<geometry_msgs::msg::PointStamped> filter(buffer, "map", 10, node);
+  filter.registerCallback(&immediate_callback);
+  filter.setTargetFrames({"map", "odom"});
+  filter.setTolerance(rclcpp::Duration(1, 0));
+
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = "map";
+  transform.child_frame_id = "odom";
+  transform.transform.rotation.w = 1.0;
+  EXPECT_TRUE(buffer.setTransform(transform, "test", true));
+  transform.header.frame_id = "odom";
+  transform.child_frame_id = "base";
+  EXPECT_TRUE(buffer.setTransform(transform, "test", true));
+
+  auto point = std::make_shared<geometry_msgs::msg::PointStamped>();
+  point->header.stamp = clock->now();
+  point->header.frame_id = "base";
+
+  // All transforms are available, so the message is passed on within add()
+  filter.add(point);
+  EXPECT_EQ(immediate_callback_fired, 1);
+
+  // Otherwise it waits for them
+  point->header.frame_id = "sensor";
+  filter.add(point);
+  EXPECT_EQ(immediate_callback_fired, 1);
+  transform.header.frame_id = "base";
+  transform.child_frame_id = "sensor";
+  EXPECT_TRUE(buffer.setTransform(transform, "test", true));
+  EXPECT_EQ(immediate_callback_fired, 2);
+}
+
 TEST(tf2_ros_message_filter, multiple_frames_and_time_tolerance)
 {
   auto node = rclcpp::Node::make_shared("tf2_ros_message_filter");
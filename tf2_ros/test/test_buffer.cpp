@@ -138,6 +138,35 @@ TEST(test_buffer, can_transform_valid_transform)
   EXPECT_DOUBLE_EQ(transform.transform.translation.z, output_rclcpp.transform.translation.z);
 }
 
+TEST(test_buffer, lookup_velocity)
+{
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  // Silence error about dedicated thread's being necessary
+  buffer.setUsingDedicatedThread(true);
+
+  rclcpp::Time rclcpp_time = clock->now();
+
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = "foo";
+  transform.child_frame_id = "bar";
+  transform.transform.rotation.w = 1.0;
+  // bar moves along y at 2 m/s
+  for (int i = 0; i <= 2; ++i) {
+    transform.header.stamp = rclcpp_time + rclcpp::Duration::from_seconds(i);
+    transform.transform.translation.y = 2.0 * i;
+    EXPECT_TRUE(buffer.setTransform(transform, "unittest"));
+  }
+
+  auto output = buffer.lookupVelocity(
+    "bar", "foo", rclcpp_time + rclcpp::Duration::from_seconds(1.0),
+    rclcpp::Duration::from_seconds(0.5), rclcpp::Duration::from_seconds(0.1));
+  EXPECT_EQ("foo", output.header.frame_id);
+  EXPECT_NEAR(0.0, output.twist.linear.x, 1e-6);
+  EXPECT_NEAR(2.0, output.twist.linear.y, 1e-6);
+  EXPECT_NEAR(0.0, output.twist.angular.z, 1e-6);
+}
+
 TEST(test_buffer, wait_for_transform_valid)
 {
   rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
@@ -0,0 +1,150 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "geometry_msgs/msg/transform_stamped.hpp"
+#include "tf2/buffer_core.h"
+#include "tf2_ros/compact_tf.h"
+
+namespace
+{
+
+geometry_msgs::msg::TransformStamped makeTransform(
+  const std::string & parent, const std::string & child, int32_t sec, double x)
+{
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = parent;
+  transform.header.stamp.sec = sec;
+  transform.child_frame_id = child;
+  transform.transform.translation.x = x;
+  transform.transform.rotation.w = 1.0;
+  return transform;
+}
+
+}  // namespace
+
+TEST(tf2_ros_compact_tf, Sends_Each_Frame_Name_Once)
+{
+  tf2_ros::CompactTFEncoder encoder(std::chrono::hours(1));
+  tf2_msgs::msg::CompactTFMessage message;
+
+  encoder.encode({makeTransform("odom", "base_link", 1, 1.0)}, message);
+  EXPECT_EQ(0u, message.dictionary_offset);
+  EXPECT_EQ((std::vector<std::string>{"odom", "base_link"}), message.dictionary);
+  EXPECT_EQ(7u, message.values.size());
+
+  encoder.encode(
+    {makeTransform("odom", "base_link", 2, 2.0), makeTransform("base_link", "arm", 2, 0.5)},
+    message);
+  EXPECT_EQ(2u, message.dictionary_offset);
+  EXPECT_EQ(std::vector<std::string>{"arm"}, message.dictionary);
+  EXPECT_EQ((std::vector<uint32_t>{0, 1}), message.parent_ids);
+  EXPECT_EQ((std::vector<uint32_t>{1, 2}), message.child_ids);
+  EXPECT_EQ(2000000000, message.stamps[0]);
+
+  encoder.encode({makeTransform("odom", "base_link", 3, 3.0)}, message);
+  EXPECT_TRUE(message.dictionary.empty());
+}
+
+TEST(tf2_ros_compact_tf, Decodes_Into_Buffer)
+{
+  tf2_ros::CompactTFEncoder encoder(std::chrono::hours(1));
+  tf2_ros::CompactTFDecoder decoder;
+  tf2::BufferCore buffer;
+  tf2_msgs::msg::CompactTFMessage message;
+
+  encoder.encode({makeTransform("odom", "base_link", 1, 1.0)}, message);
+  EXPECT_EQ(1u, decoder.decode(message, buffer, "test"));
+  encoder.encode(
+    {makeTransform("odom", "base_link", 2, 2.0), makeTransform("/base_link", "arm", 2, 0.5)},
+    message);
+  EXPECT_EQ(2u, decoder.decode(message, buffer, "test"));
+
+  // The leading slash of "/base_link" is stripped, so arm is attached to base_link
+  auto transform = buffer.lookupTransform("odom", "arm", tf2::TimePoint(std::chrono::seconds(2)));
+  EXPECT_DOUBLE_EQ(2.5, transform.transform.translation.x);
+  transform = buffer.lookupTransform(
+    "odom", "base_link", tf2::TimePoint(std::chrono::milliseconds(1500)));
+  EXPECT_DOUBLE_EQ(1.5, transform.transform.translation.x);
+}
+
+TEST(tf2_ros_compact_tf, Late_Decoder_Waits_For_Dictionary)
+{
+  tf2_ros::CompactTFEncoder encoder(std::chrono::hours(1));
+  tf2_msgs::msg::CompactTFMessage message;
+  encoder.encode({makeTransform("odom", "base_link", 1, 1.0)}, message);
+  encoder.encode({makeTransform("odom", "base_link", 2, 2.0)}, message);
+
+  // Without the names, the ids cannot be mapped to frames
+  tf2_ros::CompactTFDecoder decoder;
+  tf2::BufferCore buffer;
+  EXPECT_EQ(0u, decoder.decode(message, buffer, "test"));
+  EXPECT_FALSE(buffer._frameExists("base_link"));
+
+  // The periodic refresh resends the whole dictionary
+  tf2_ros::CompactTFEncoder refreshing_encoder(tf2::Duration(0));
+  refreshing_encoder.encode({makeTransform("odom", "base_link", 1, 1.0)}, message);
+  refreshing_encoder.encode({makeTransform("odom", "base_link", 2, 2.0)}, message);
+  EXPECT_EQ(0u, message.dictionary_offset);
+  EXPECT_EQ(2u, message.dictionary.size());
+  EXPECT_EQ(1u, decoder.decode(message, buffer, "test"));
+  EXPECT_TRUE(buffer._frameExists("base_link"));
+}
+
+TEST(tf2_ros_compact_tf, Skips_Dictionary_Past_Known_Names)
+{
+  tf2_ros::CompactTFDecoder decoder;
+  tf2::BufferCore buffer;
+  tf2_msgs::msg::CompactTFMessage message;
+  message.sender_id = 42;
+  message.dictionary_offset = 4000000000u;
+  message.dictionary = {"odom", "base_link"};
+  message.parent_ids = {4000000000u};
+  message.child_ids = {4000000001u};
+  message.stamps = {1000000000};
+  message.values = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0};
+
+  // Nothing is allocated for the ids before the offset
+  EXPECT_EQ(0u, decoder.decode(message, buffer, "test"));
+  EXPECT_FALSE(buffer._frameExists("base_link"));
+
+  message.dictionary_offset = 0;
+  message.parent_ids = {0};
+  message.child_ids = {1};
+  EXPECT_EQ(1u, decoder.decode(message, buffer, "test"));
+}
+
+TEST(tf2_ros_compact_tf, Forgets_Quiet_Senders)
+{
+  tf2_ros::CompactTFEncoder encoder(std::chrono::hours(1));
+  tf2_ros::CompactTFEncoder restarted_encoder(std::chrono::hours(1));
+  tf2_ros::CompactTFDecoder decoder(tf2::Duration(0));
+  tf2::BufferCore buffer;
+  tf2_msgs::msg::CompactTFMessage message;
+
+  encoder.encode({makeTransform("odom", "base_link", 1, 1.0)}, message);
+  EXPECT_EQ(1u, decoder.decode(message, buffer, "test"));
+  restarted_encoder.encode({makeTransform("odom", "base_link", 2, 2.0)}, message);
+  EXPECT_EQ(1u, decoder.decode(message, buffer, "test"));
+
+  // The first sender was forgotten when the new one showed up, its ids are unknown again
+  encoder.encode({makeTransform("odom", "base_link", 3, 3.0)}, message);
+  EXPECT_TRUE(message.dictionary.empty());
+  EXPECT_EQ(0u, decoder.decode(message, buffer, "test"));
+}
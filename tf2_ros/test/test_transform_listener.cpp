@@ -31,7 +31,10 @@
 #include <tf2_ros/buffer.h>
 #include <tf2_ros/transform_listener.h>
 
+#include <chrono>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "node_wrapper.hpp"
 
@@ -104,6 +107,83 @@ TEST(tf2_test_transform_listener, transform_listener_with_intraprocess)
   custom_node->init_tf_listener();
 }
 
+TEST(tf2_test_transform_listener, transform_listener_request_history)
+{
+  auto server_node = rclcpp::Node::make_shared("tf2_ros_test_history_server");
+  auto client_node = rclcpp::Node::make_shared("tf2_ros_test_history_client");
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+
+  // A stand-in for a long-running buffer, like the one of the buffer_server
+  tf2_ros::Buffer server_buffer(clock, tf2::durationFromSec(10.0), server_node);
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = "odom";
+  transform.child_frame_id = "base_link";
+  transform.transform.rotation.w = 1.0;
+  for (int i = 0; i < 5; ++i) {
+    transform.header.stamp = clock->now() - rclcpp::Duration::from_seconds(0.1 * (5 - i));
+    transform.transform.translation.x = i;
+    server_buffer.setTransform(transform, "test");
+  }
+
+  tf2_ros::Buffer buffer(clock);
+  tf2_ros::TransformListener tfl(buffer, client_node, false);
+  tfl.requestHistory(client_node, tf2::durationFromSec(5.0));
+
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(server_node);
+  executor.add_node(client_node);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!buffer._frameExists("base_link") && std::chrono::steady_clock::now() < deadline) {
+    executor.spin_some(std::chrono::milliseconds(10));
+  }
+
+  ASSERT_TRUE(buffer._frameExists("base_link"));
+  auto latest = buffer.lookupTransform("odom", "base_link", tf2::TimePointZero);
+  EXPECT_DOUBLE_EQ(4.0, latest.transform.translation.x);
+}
+
+TEST(tf2_test_transform_listener, transform_listener_namespaces)
+{
+  auto node = rclcpp::Node::make_shared("tf2_ros_test_transform_listener_namespaces");
+  rclcpp::Clock::SharedPtr clock = std::make_shared<rclcpp::Clock>(RCL_SYSTEM_TIME);
+  tf2_ros::Buffer buffer(clock);
+  buffer.addSharedFrame("world");
+  tf2_ros::TransformListener tfl(buffer, node, false);
+  tfl.addNamespace(node, "/robot1");
+  tfl.addNamespace(node, "/robot2");
+
+  std::vector<rclcpp::Publisher<tf2_msgs::msg::TFMessage>::SharedPtr> publishers;
+  tf2_msgs::msg::TFMessage message;
+  message.transforms.resize(1);
+  message.transforms[0].header.frame_id = "world";
+  message.transforms[0].child_frame_id = "base_link";
+  message.transforms[0].transform.rotation.w = 1.0;
+  for (const std::string & tf_ns : {"/robot1", "/robot2"}) {
+    publishers.push_back(
+      node->create_publisher<tf2_msgs::msg::TFMessage>(
+        tf_ns + "/tf", tf2_ros::DynamicListenerQoS()));
+  }
+
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(node);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!buffer.canTransform("robot1/base_link", "robot2/base_link", tf2::TimePointZero) &&
+    std::chrono::steady_clock::now() < deadline)
+  {
+    message.transforms[0].header.stamp = clock->now();
+    for (size_t i = 0; i < publishers.size(); ++i) {
+      message.transforms[0].transform.translation.x = static_cast<double>(i + 1);
+      publishers[i]->publish(message);
+    }
+    executor.spin_some(std::chrono::milliseconds(10));
+  }
+
+  ASSERT_TRUE(buffer.canTransform("robot1/base_link", "robot2/base_link", tf2::TimePointZero));
+  EXPECT_FALSE(buffer._frameExists("base_link"));
+  auto robot2 = buffer.lookupTransform("world", "robot2/base_link", tf2::TimePointZero);
+  EXPECT_DOUBLE_EQ(2.0, robot2.transform.translation.x);
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -65,6 +65,26 @@ class TestBuffer:
         assert transform.transform.translation.y == output.transform.translation.y
         assert transform.transform.translation.z == output.transform.translation.z
 
+    def test_lookup_velocity(self):
+        buffer = Buffer()
+        clock = rclpy.clock.Clock()
+        rclpy_time = clock.now()
+        # bar moves along x at 2 m/s
+        for i in range(3):
+            transform = self.build_transform(
+                'foo', 'bar', rclpy_time + rclpy.duration.Duration(seconds=i))
+            transform.transform.translation.x = 2.0 * i
+            buffer.set_transform(transform, 'unittest')
+
+        output = buffer.lookup_velocity(
+            'bar', 'foo', rclpy_time + rclpy.duration.Duration(seconds=1),
+            rclpy.duration.Duration(seconds=0.5))
+
+        assert 'foo' == output.header.frame_id
+        assert output.twist.linear.x == pytest.approx(2.0)
+        assert output.twist.linear.y == pytest.approx(0.0)
+        assert output.twist.angular.z == pytest.approx(0.0)
+
     def test_await_transform_immediately_available(self):
         # wait for a transform that is already available to test short-cut code
         buffer = Buffer()
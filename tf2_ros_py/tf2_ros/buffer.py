@@ -40,6 +40,7 @@ import tf2_py as tf2
 import tf2_ros
 from tf2_msgs.srv import FrameGraph
 from geometry_msgs.msg import TransformStamped
+from geometry_msgs.msg import TwistStamped
 # TODO(vinnamkim): It seems rosgraph is not ready
 # import rosgraph.masterapi
 from time import sleep
@@ -196,6 +197,32 @@ class Buffer(tf2.BufferCore, tf2_ros.BufferInterface):
         await self.wait_for_transform_full_async(target_frame, target_time, source_frame, source_time, fixed_frame)
         return self.lookup_transform_full_core(target_frame, target_time, source_frame, source_time, fixed_frame)
 
+    def lookup_velocity(
+        self,
+        tracking_frame: str,
+        observation_frame: str,
+        time: Time,
+        averaging_interval: Duration,
+        timeout: Duration = Duration()
+    ) -> TwistStamped:
+        """
+        Get the velocity of the tracking frame relative to the observation frame.
+
+        The velocity is averaged over an interval centered on time, which is shifted back if it
+        would extend past the latest data.
+
+        :param tracking_frame: Name of the frame whose motion is tracked.
+        :param observation_frame: Name of the frame the motion is observed from.
+        :param time: The time at which to get the velocity (0 will get the latest).
+        :param averaging_interval: The length of the interval to average over.
+        :param timeout: Time to wait for the end of the interval to become available.
+        :return: The linear and angular velocity, expressed in the observation frame.
+        """
+        if time.nanoseconds != 0:
+            end_time = time + Duration(nanoseconds=averaging_interval.nanoseconds // 2)
+            self.can_transform(observation_frame, tracking_frame, end_time, timeout)
+        return self.lookup_velocity_core(tracking_frame, observation_frame, time, averaging_interval)
+
     def can_transform(
         self,
         target_frame: str,